@@ -0,0 +1,445 @@
+#ifndef GPX_HELPERS_H
+#define GPX_HELPERS_H
+
+/* Internal declarations shared between the GPX*.c translation units.
+ * Nothing in here is part of the public API - include GPXParser.h for that.
+ */
+
+#include "GPXParser.h"
+#include <libxml/xmlreader.h>
+
+#define EQUAL_STRINGS 0
+#define NO_ELEMENTS 0
+#define MAX_READ_CHARS 256
+#define DOUBLE_CHARS 325
+#define GPXDATA_SIZE 1000
+#define JSON_LIST_STR_MAX_LENGTH 6000
+#define JSON_GPX_STR_MAX_LENGTH 9000
+#define MAX_NAME_LENGTH 1250
+#define HALF_CIRCLE_DEGREES 180
+#define MIN_LOOP_WPTS 4
+#define DEFAULT_DELTA 10
+#define JSON_NAME_LEN 257
+#define JSON_WPT_STR_LEN 600
+#define JSON_STR_LEN 1000
+#define FILE_JSON_STR_LEN 10000
+
+#define MAX_LATITUDE 90.000000
+#define MIN_LATITUDE -90.000000
+#define MAX_LONGITUDE 180.000000
+#define MIN_LONGITUDE -180.000000
+
+#define SENTINEL_LAT_LON -200.000000 // Base invalid value. If a lat or lon isn't properly set, then this value will indicate so.
+#define SENTINEL_VERSION -1.0 // Same purpose as the sentinel value above, but for the gpx version.
+
+#define GPX "gpx"
+#define TRK "trk"
+#define TRKSEG "trkseg"
+#define TRKPT "trkpt"
+#define RTEPT "rtept"
+#define WPT "wpt"
+#define ELE "ele"
+#define TIME "time"
+#define RTE "rte"
+#define VERSION "version"
+#define CREATOR "creator"
+#define TEXT "text"
+#define LAT "lat"
+#define LON "lon"
+#define NAME "name"
+#define DEFAULT_NAMESPACE "http://www.topografix.com/GPX/1/1"
+
+// The element names the GPXdoc model cares about. Everything else is either a GPXData child or ignored.
+typedef enum {
+  GPX_ELEMENT_OTHER = 0,
+  GPX_ELEMENT_GPX,
+  GPX_ELEMENT_WPT,
+  GPX_ELEMENT_RTE,
+  GPX_ELEMENT_RTEPT,
+  GPX_ELEMENT_TRK,
+  GPX_ELEMENT_TRKSEG,
+  GPX_ELEMENT_TRKPT,
+  GPX_ELEMENT_NAME
+} GPXElement;
+
+// Maps an element's local name onto the GPXElement it represents.
+GPXElement classifyGPXElement(const char * name);
+
+// Returns true if the element is a structural child of its parent (i.e. it is not stored as GPXData).
+bool isStructuralChild(GPXElement parent, GPXElement child);
+
+// Returns true for the elements whose simple children are stored in a name field and an otherData list.
+bool isOwnerElement(GPXElement element);
+
+/* GPXData names (see GPXNames.c) */
+// The shared names, indexed by GPXDataName.
+typedef enum {
+  GPX_NAME_AGEOFDGPSDATA = 0,
+  GPX_NAME_CMT,
+  GPX_NAME_DESC,
+  GPX_NAME_DGPSID,
+  GPX_NAME_ELE,
+  GPX_NAME_EXTENSIONS,
+  GPX_NAME_FIX,
+  GPX_NAME_GEOIDHEIGHT,
+  GPX_NAME_HDOP,
+  GPX_NAME_LINK,
+  GPX_NAME_MAGVAR,
+  GPX_NAME_NAME,
+  GPX_NAME_NUMBER,
+  GPX_NAME_PDOP,
+  GPX_NAME_SAT,
+  GPX_NAME_SRC,
+  GPX_NAME_SYM,
+  GPX_NAME_TIME,
+  GPX_NAME_TYPE,
+  GPX_NAME_VDOP,
+  NUM_GPX_DATA_NAMES
+} GPXDataName;
+
+extern const char * const gpxDataNames[NUM_GPX_DATA_NAMES];
+
+// The shared copy of a name, or NULL if it isn't one of gpxDataNames.
+const char * internGPXName(const char * name);
+
+// How to lay out a GPXData in memory that the caller allocates. sharedName is internGPXName(name): when it is NULL, the name
+// is copied in after the value.
+size_t sizeOfGPXData(const char * sharedName, const char * name, const char * value);
+GPXData * fillGPXData(GPXData * gpxData, const char * sharedName, const char * name, const char * value);
+
+// Whether a waypoint's GPXData comes before its <name> in gpx.xsd's order (ele, time, magvar and geoidheight do).
+bool precedesWaypointName(const char * name);
+
+/* Parse contexts */
+#define MAX_ERROR_MESSAGE 512
+
+struct GPXParseContext {
+  unsigned int options;
+  GPXAllocator allocator;
+  GPXParseStats stats;
+
+  GPXErrorCode error;
+  char errorMessage[MAX_ERROR_MESSAGE];
+  int errorLine;
+  bool errorIsWarning;
+
+  // While a call is running: the libxml2 error handler it replaced on this thread, and when it started.
+  xmlStructuredErrorFunc savedHandler;
+  void * savedHandlerContext;
+  double startTime;
+};
+
+// Every ...Ctx entry point brackets its work with these. They do nothing when ctx is NULL. beginGPXParse clears the error and
+// routes this thread's libxml2 errors into ctx; the finish functions put the old handler back, record the failure code if the
+// call failed without recording anything more specific, and update the statistics. They return their second argument.
+// finishGPXParse is finishGPXCall for calls that build a GPXdoc.
+void beginGPXParse(GPXParseContext * ctx);
+bool finishGPXCall(GPXParseContext * ctx, bool succeeded, GPXErrorCode failure);
+GPXdoc * finishGPXParse(GPXParseContext * ctx, GPXdoc * gpx);
+
+// Records an error in ctx (if it isn't NULL). The code always replaces the current one, but a message recorded earlier - usually
+// libxml2's own, which says more - is kept.
+void setGPXParseError(GPXParseContext * ctx, GPXErrorCode code, const char * message);
+void clearGPXParseError(GPXParseContext * ctx);
+
+// The libxml2 parse options a context asks for (0 for a NULL context).
+int contextXmlOptions(GPXParseContext * ctx);
+
+// Whether the documents parsed with a context go into arenas (GPX_PARSE_ARENA, or GPX_PARSE_CONTIGUOUS which needs one).
+bool contextUsesArena(GPXParseContext * ctx);
+
+// The allocator for a context's temporary buffers. A NULL context or allocator means malloc/realloc/free.
+const GPXAllocator * contextAllocator(GPXParseContext * ctx);
+void * allocateScratch(const GPXAllocator * allocator, size_t size);
+void * reallocateScratch(const GPXAllocator * allocator, void * ptr, size_t size);
+void releaseScratch(const GPXAllocator * allocator, void * ptr);
+
+// Adds the statistics of one context to another's (used to merge the batch workers' contexts).
+void addGPXParseStats(GPXParseStats * total, const GPXParseStats * stats);
+
+/* Number parsing */
+// Drop-in replacement for strtod, with a fast path for plain decimals that gives bit-identical results.
+double parseGPXNumber(const char * str, char ** endPtr);
+
+// Reads a whole string that is an xsd:decimal (sign, digits and at most one point - no exponent), with the whitespace the
+// schema allows around it. Returns false otherwise.
+bool parseGPXDecimal(const char * text, double * value);
+
+// Writes the shortest decimal that reads back as exactly value. buffer must have room for DOUBLE_CHARS characters.
+void formatGPXNumber(double value, char * buffer);
+
+/* Times (see GPXTime.c) */
+#define GPX_TIME_CHARS 40
+
+// Reads an xsd:dateTime with a time zone into nanoseconds since 1970-01-01T00:00:00Z. Returns false for anything else.
+bool parseGPXTime(const char * text, int64_t * time);
+
+// Writes a time from parseGPXTime back out in UTC, e.g. "2021-03-04T05:06:07.5Z". buffer must have room for GPX_TIME_CHARS characters.
+void formatGPXTime(int64_t time, char * buffer);
+
+// The xsd:dateTime checks of the structural validator, shared with parseGPXTime.
+bool isSchemaDateTime(const char * text);
+
+// Skips the whitespace the schema ignores around a value that isn't a string, and sets len to the length of what's left.
+const char * trimSchemaValue(const char * text, size_t * len);
+bool readSchemaDigits(const char ** p, const char * end, int count, long * value);
+
+/* Distances */
+// The haversine distance in metres between two points, for single distances like isLoopRoute's.
+float computeDistanceBetweenWaypoints(float srcLat, float srcLon, float destLat, float destLon);
+
+// The batched distances behind the length functions (see GPXDistance.c). sumHopDistances adds the distances in metres between
+// consecutive points of the arrays to sum, in order, with Kahan summation.
+#define DISTANCE_BATCH 256
+#define SUM_LANES 4
+
+typedef struct {
+  double total[SUM_LANES];
+  double compensation[SUM_LANES];
+  int lane; // The lane the next distance goes to
+} DistanceSum;
+
+void initDistanceSum(DistanceSum * sum);
+double distanceSumTotal(const DistanceSum * sum);
+
+bool isGPXDistanceModel(GPXDistanceModel model);
+void sumHopDistances(const double * latitude, const double * longitude, int length, GPXDistanceModel model, DistanceSum * sum);
+
+// Sets cumulative[i] to the haversine length of the path from point 0 to point i.
+void cumulativeHopDistances(const double * latitude, const double * longitude, int length, double * cumulative);
+
+// For points that come from a list: they are gathered into batches as they are added.
+typedef struct {
+  double latitude[DISTANCE_BATCH];
+  double longitude[DISTANCE_BATCH];
+  int count;
+  GPXDistanceModel model;
+  DistanceSum sum;
+} PathLength;
+
+void initPathLength(PathLength * path, GPXDistanceModel model);
+void addPathPoint(PathLength * path, double latitude, double longitude);
+double finishPathLength(PathLength * path);
+
+/* Counting - the GPXData a waypoint or route adds to its document's numGPXData. */
+int countWaypointGPXData(const Waypoint * waypoint);
+int countRouteGPXData(const Route * route);
+
+/* Summaries (see GPXSummary.c) - read from the route or track, or worked out if it doesn't have a current one. */
+GPXPathSummary routeSummary(const Route * route);
+GPXPathSummary trackSummary(const Track * track);
+
+/* Name index (see GPXIndex.c) */
+void deleteGPXNameIndex(GPXNameIndex * index);
+
+// The document's index, built if it doesn't have one yet. NULL if there isn't memory for it.
+GPXNameIndex * gpxNameIndex(const GPXdoc * doc);
+void dropGPXNameIndex(GPXdoc * doc);
+
+// The first entity with a name, or NULL if there is none.
+Waypoint * findIndexedWaypoint(const GPXNameIndex * index, const char * name);
+Route * findIndexedRoute(const GPXNameIndex * index, const char * name);
+Track * findIndexedTrack(const GPXNameIndex * index, const char * name);
+
+// Called by addRoute and addWaypoint after they have added to a document's lists.
+void indexAddedRoute(GPXdoc * doc, Route * route);
+void indexAddedWaypoint(GPXdoc * doc, Route * route, Waypoint * waypoint);
+
+/* Constructors - the lists are created with the given allocator (NULL for plain malloc'd lists). */
+GPXdoc * buildGPXdoc(GPXdoc * gpx, char * schemaLocation, char * version, char * creator, ListAllocator * allocator);
+Track * buildTrack(Track * track, char * name, ListAllocator * allocator);
+Route * buildRoute(Route * route, char * name, ListAllocator * allocator);
+Waypoint * buildWaypoint(Waypoint * waypoint, char * name, char * longitude, char * latitude, ListAllocator * allocator);
+GPXData * buildGPXData(GPXData * gpxData, const char * name, const char * value);
+TrackSegment * buildTrackSegment(TrackSegment * trackSegment, ListAllocator * allocator);
+
+/* Document arenas - with GPX_PARSE_ARENA, a document and everything in it is allocated from a few large blocks that
+ * deleteGPXdoc frees all at once (see GPXArena.c).
+ */
+typedef struct GPXArenaBlock GPXArenaBlock;
+typedef struct GPXArenaCleanup GPXArenaCleanup;
+
+typedef struct {
+  ListAllocator lists; // Must come first - the arena is found from any of its lists through their allocator
+
+  GPXArenaBlock * blocks;
+  char * next;  // The free space left in the block being allocated from
+  char * limit;
+  size_t nextBlockSize;
+
+  Node * freeNodes;           // Nodes released by the lists, for reuse
+  GPXArenaCleanup * cleanups; // Malloc'd objects the arena has taken over
+} GPXArena;
+
+GPXArena * createGPXArena(void);
+void deleteGPXArena(GPXArena * arena);
+void * arenaAllocate(GPXArena * arena, size_t size);
+char * arenaString(GPXArena * arena, const char * str);
+
+// Makes the arena responsible for a malloc'd object, which deleteObject is called on when the arena is deleted.
+bool adoptArenaObject(GPXArena * arena, void * object, void (*deleteObject)(void * object));
+
+// Undoes adoptArenaObject, for an object that couldn't be added to the document after all. It is the caller's again.
+void disownArenaObject(GPXArena * arena, void * object);
+
+// Moves everything src owns into dest, for when objects from one document's arena are spliced into another's. src is left
+// empty, and can be deleted or go on being used.
+void mergeGPXArena(GPXArena * dest, GPXArena * src);
+
+// The arena a list was allocated from, or NULL if it is an ordinary list.
+GPXArena * listArena(const List * list);
+
+// Arena counterparts of the constructors above. buildArenaGPXdoc creates the arena; deleteGPXdoc deletes it again.
+GPXdoc * buildArenaGPXdoc(char * schemaLocation, char * version, char * creator);
+Track * buildArenaTrack(GPXArena * arena);
+TrackSegment * buildArenaTrackSegment(GPXArena * arena);
+Route * buildArenaRoute(GPXArena * arena);
+Waypoint * buildArenaWaypoint(GPXArena * arena, char * longitude, char * latitude);
+
+// Moves the points of an arena document into contiguous memory for GPX_PARSE_CONTIGUOUS. Does nothing to other documents.
+void packGPXdocPoints(GPXdoc * gpx);
+
+// Starts the GPXdoc for a parse: in an arena of its own if ctx asks for GPX_PARSE_ARENA, and otherwise with malloc and a
+// Node pool shared by all of the document's lists.
+GPXdoc * newGPXdoc(GPXParseContext * ctx, char * schemaLocation, char * version, char * creator);
+
+/* Incremental document building - shared by every parse path so they all agree on where things go.
+ * Each of these appends the new object to the right list of the GPXdoc and returns it, or NULL on failure.
+ */
+Track * openTrack(GPXdoc * gpx);
+TrackSegment * openTrackSegment(GPXdoc * gpx);
+Route * openRoute(GPXdoc * gpx);
+Waypoint * openWaypoint(GPXdoc * gpx, GPXElement element, char * longitude, char * latitude);
+
+// Stores a simple child element of a waypoint, route or track: <name> goes to the name field, a readable <ele> or <time> of a
+// waypoint (waypoint is NULL for routes and tracks) to its typed fields, and anything else to otherData.
+bool addChildData(char ** nameField, Waypoint * waypoint, List * otherData, const char * childName, const char * value);
+
+/* DOM path */
+char * findAttribute(xmlNode * node, char * attrName);
+GPXdoc * buildObjects(xmlNode * a_node, GPXdoc * gpx, bool * failed);
+GPXdoc * buildGPXdocFromXml(GPXParseContext * ctx, xmlNode * root);
+
+/* Input buffers */
+// Maps a whole file read-only, returning NULL if it can't be opened, is empty or can't be mapped.
+char * mapGPXFile(GPXParseContext * ctx, char * fileName, size_t * length);
+void unmapGPXFile(char * data, size_t length);
+
+// Builds a GPXdoc from a buffer with the libxml2 streaming reader, whatever its size. url may be NULL.
+GPXdoc * buildGPXdocFromBuffer(GPXParseContext * ctx, const char * data, size_t length, const char * url);
+
+/* Validation */
+struct GPXSchema {
+  xmlSchemaPtr schema;
+};
+
+// gpxSchemaLoad without the begin/finish bracketing, for use inside other calls. Records the error in ctx on failure.
+GPXSchema * loadGPXSchema(GPXParseContext * ctx, char * gpxSchemaFile);
+
+// Validates a tree against a compiled schema, using a validation context of its own so the schema can be shared.
+bool validateXmlDocWithSchema(GPXParseContext * ctx, xmlDoc * doc, const GPXSchema * schema);
+
+// Loads the schema, validates against it and frees it again - for the functions that take a schema file name.
+bool validateXmlDoc(GPXParseContext * ctx, xmlDoc * doc, char * gpxSchemaFile);
+
+/* Streaming builder - fills a GPXdoc from a sequence of start tag, end tag and text events. It doesn't care where the
+ * events come from, so the xmlTextReader loop and the hand-written tokenizer both drive it.
+ */
+#define MAX_OWNER_DEPTH 8
+#define NO_CHILD -1
+
+// A reusable, growable buffer for the text content of the element being read.
+typedef struct {
+  char * text;
+  size_t len;
+  size_t size;
+  const GPXAllocator * allocator;
+} StreamText;
+
+// An element (waypoint, route or track) whose simple children are being collected into its name and otherData.
+typedef struct {
+  GPXElement element;
+  int depth;
+  char ** nameField;
+  Waypoint * waypoint; // NULL for a route or track
+  List * otherData;
+} StreamOwner;
+
+typedef struct {
+  GPXdoc * gpx;
+
+  StreamOwner owners[MAX_OWNER_DEPTH];
+  int numOwners;
+
+  // The simple child currently being read. childDepth is NO_CHILD when we aren't inside one.
+  StreamText childName;
+  int childDepth;
+  StreamText text;
+
+  bool failed;
+
+  // The context the document is being parsed with, which decides how it is allocated.
+  GPXParseContext * ctx;
+} StreamState;
+
+// The attributes of an element that the builder looks at. Each one is NULL when the element doesn't have it.
+typedef struct {
+  const char * namespace;
+  const char * version;
+  const char * creator;
+  const char * latitude;
+  const char * longitude;
+} StreamAttributes;
+
+void initStreamText(StreamText * buffer, const GPXAllocator * allocator);
+void freeStreamText(StreamText * buffer);
+bool appendStreamTextLength(StreamText * buffer, const char * text, size_t len);
+bool appendStreamText(StreamText * buffer, const char * text);
+const char * streamTextValue(StreamText * buffer);
+
+void initStreamState(StreamState * state, GPXParseContext * ctx);
+
+// Returns true if startStreamElement is going to read the attributes of this element, so callers can skip fetching them otherwise.
+bool streamElementNeedsAttributes(StreamState * state, int depth, GPXElement element);
+
+bool startStreamElement(StreamState * state, int depth, const char * name, GPXElement element, bool isEmpty,
+                        const StreamAttributes * attributes);
+bool endStreamElement(StreamState * state, int depth);
+bool appendStreamElementText(StreamState * state, const char * text, size_t len);
+
+// Frees the builder's scratch space and hands over the finished GPXdoc, or deletes it and returns NULL if anything failed.
+GPXdoc * finishStreamState(StreamState * state, bool succeeded);
+
+/* Streaming path */
+GPXdoc * buildObjectsFromReader(GPXParseContext * ctx, xmlTextReaderPtr reader);
+bool streamEventsFromReader(GPXParseContext * ctx, xmlTextReaderPtr reader, const GPXStreamCallbacks * callbacks, void * userData);
+
+/* Tokenizer fast path */
+// Builds a GPXdoc straight from the bytes without libxml2. Returns NULL if the input is anything but plain, well-formed GPX
+// (see GPXTokenizer.c), in which case the caller should fall back to a libxml2 path for the authoritative answer.
+GPXdoc * tokenizeGPXdoc(GPXParseContext * ctx, const char * data, size_t length);
+
+// Checks that every byte is one XML allows and that the input is valid UTF-8. isAscii reports whether it is plain 7-bit ASCII.
+bool isTokenizableInput(const char * data, size_t length, bool * isAscii);
+
+// Falls back to libxml2 (buildGPXdocFromBuffer) when the tokenizer gives up, counting the fallback in ctx.
+GPXdoc * buildGPXdocWithFallback(GPXParseContext * ctx, const char * data, size_t length, const char * url);
+
+/* Parallel track parsing - a long run of <trkpt> elements is cut into chunks that are tokenized on separate threads, and a
+ * serial pass over the rest of the document splices their points in (see GPXParallel.c).
+ */
+typedef struct {
+  const char * start; // The '<' of the <trkpt the chunk starts at
+  const char * stop;  // The '<' of the markup its tokenizer stopped at, after its last point
+  GPXdoc * points;    // A scratch document whose only segment holds the chunk's points, or NULL if the chunk couldn't be read or has been spliced
+} GPXChunk;
+
+// Tokenizes chunks[index] as a run of points inside a <trkseg>, stopping at the start of a later chunk or at the first markup that
+// isn't a point. Input validation is left to the caller.
+void tokenizeGPXChunk(GPXParseContext * ctx, const char * end, GPXChunk * chunks, int numChunks, int index);
+
+// tokenizeGPXdoc for input the caller has already checked with isTokenizableInput. Chunks (which may be NULL) are spliced in
+// where the document's own structure puts them; any that don't line up are re-read in the serial pass.
+GPXdoc * tokenizeCheckedGPXdoc(GPXParseContext * ctx, const char * data, size_t length, bool isAscii, GPXChunk * chunks, int numChunks);
+
+#endif
@@ -4,6 +4,7 @@
 #include <stdio.h>
 #include <string.h>
 #include <math.h>
+#include <stdint.h>
 #include <libxml/parser.h>
 #include <libxml/tree.h>
 #include <libxml/encoding.h>
@@ -17,11 +18,16 @@
     #define M_PI 3.14159265358979323846
 #endif
 
+//The time of a Waypoint (or of a point in a GPXPointColumns) that has no <time>
+#define GPX_NO_TIME INT64_MIN
+
 //Represents a generic GPX element/XML node - i.e. some sort of an additinal piece of data, 
 // e.g. comment, elevation, desciption, etc..
 typedef struct  {
-    //GPXData name.  Must not be an empty string.
-	char 	name[256];
+    //GPXData name.  Must not be NULL or an empty string.  The names GPX itself defines (ele, time, sym, desc, ...) are
+    //shared by every GPXData that has them, and any other name is stored with the value, so it must never be written to
+    //or freed.
+	const char * name;
 
     //GPXData value.  We use a C99 flexible array member, which we will discuss in class.
 	//Must not be an empty string
@@ -38,14 +44,68 @@ typedef struct {
     //Waypoint latitude.  Must be initialized.
     double latitude;
 
+    //Waypoint elevation (<ele>) in metres, or NAN if it has none.  Must be initialized.
+    //Only the value is kept, not how it was written: writeGPXdoc writes the shortest decimal that reads back as the same
+    //value, so "336.0", "+336" and " 336 " all become "336".
+    double elevation;
+
+    //Waypoint time (<time>) in nanoseconds since 1970-01-01T00:00:00Z, or GPX_NO_TIME if it has none.  Must be initialized.
+    //Only a time with a zone (Z or an offset) is an instant that can be stored here; one without stays in otherData.
+    //The offset itself isn't kept: writeGPXdoc writes the same instant back out in UTC, so "12:00:00+02:00" becomes "10:00:00Z".
+    int64_t time;
+
     //Additional waypoint data - i.e. children of the GPX waypoint other than <name>.  
     //We will assume that all waypoint children have no children of their own
-    //This can be elevation, time, etc.. Note that while the element <name> can be a child of the waypoint node,
+    //This can be a comment, symbol, etc.. Note that while the element <name> can be a child of the waypoint node,
     //the name already has its own dedicated filed in the Waypoint sruct - so do not place the name in this list
+    //The same goes for <ele> and <time>, which go in elevation and time - unless their text can't be read as a plain
+    //decimal and a date and time with a zone, in which case they are kept here as they are.
     //All objects in the list will be of type GPXData.  It must not be NULL.  It may be empty.
     List* otherData;
 } Waypoint;
 
+typedef struct GPXdoc GPXdoc;
+typedef struct GPXNameIndex GPXNameIndex;
+
+//Bounding box of a set of points, in degrees.  It doesn't wrap around the antimeridian.
+typedef struct {
+    double minLatitude;
+    double minLongitude;
+    double maxLatitude;
+    double maxLongitude;
+} GPXBounds;
+
+//What getRouteSummary and getTrackSummary report about the points of a route or track, taken in order across segments.
+//bounds and the endpoints are only meaningful when numPoints isn't 0.
+typedef struct {
+    int numPoints;
+
+    //The length in metres, as getRouteLen or getTrackLen would give it but in double precision
+    double length;
+
+    GPXBounds bounds;
+
+    double firstLatitude;
+    double firstLongitude;
+    double lastLatitude;
+    double lastLongitude;
+} GPXPathSummary;
+
+//The summary a route or track keeps of its points, worked out the first time it is asked for.  It is current while
+//isCurrent is set and the change counts of the lists it was worked out from (see List) haven't moved, so adding or removing
+//points through the list functions is noticed without anything else being called.  A zeroed one holds nothing.
+typedef struct {
+    GPXPathSummary summary;
+    bool isCurrent;
+
+    //The segments list's changes for a track, and the changes of the waypoints lists - summed over the segments for a track
+    unsigned long segmentChanges;
+    unsigned long pointChanges;
+
+    //The number of threads reading the summary, or -1 while one is writing it
+    int users;
+} GPXSummaryCache;
+
 typedef struct {
     //Route name.  Must not be NULL.  May be an empty string.
     char* name;
@@ -60,6 +120,13 @@ typedef struct {
     //the name already has its own dedicated filed in the Waypoint sruct - so do not place the name in this list
     //All objects in the list will be of type GPXData.  It must not be NULL.  It may be empty.
     List* otherData;
+
+    //The GPXdoc the route is in, so that addWaypoint can keep the document's counts up to date.  NULL if it isn't in one.
+    GPXdoc* doc;
+
+    //The summary that getRouteLen, isLoopRoute and getRouteSummary read.  Zeroed when the route is made; a route made other
+    //than with the library's functions must zero it too.
+    GPXSummaryCache summary;
 } Route;
 
 typedef struct {
@@ -82,10 +149,13 @@ typedef struct {
     //the name already has its own dedicated filed in the Waypoint sruct - so do not place the name in this list
     //All objects in the list will be of type GPXData.  It must not be NULL.  It may be empty.
     List* otherData;
+
+    //The summary that getTrackLen, isLoopTrack and getTrackSummary read, kept as for a Route.
+    GPXSummaryCache summary;
 } Track;
 
 
-typedef struct {
+struct GPXdoc {
     
     //Namespace associated with our GPX doc.  Must not be an empty string. While a real GPX doc might have
     //multiple namespaces associated with it, we will assume there is only one
@@ -108,7 +178,16 @@ typedef struct {
     //Tracks in the GPX file
     //All objects in the list will be of type Track.  It must not be NULL.  It may be empty.
     List* tracks;
-} GPXdoc;
+
+    //The results of getNumSegments and getNumGPXData, kept up to date by the parser, addRoute and addWaypoint so that
+    //neither has to walk the document.  Code that changes the document in any other way must call updateGPXdocCounts.
+    int numSegments;
+    int numGPXData;
+
+    //The index that getWaypoint, getRoute and getTrack build the first time one of them is called.  NULL until then.
+    //It keeps its own copies of the names, so a name changed in place is only found once updateGPXdocCounts is called.
+    GPXNameIndex* nameIndex;
+};
 
 
 
@@ -169,6 +248,15 @@ int getNumSegments(const GPXdoc* doc);
 //Total number of GPXData elements in the document
 int getNumGPXData(const GPXdoc* doc);
 
+/** Function to recount the segments and GPXData of a document, after its lists or names have been changed directly rather
+ * than with addRoute and addWaypoint.  It also sets the doc of each of its routes, drops the name index so that the next
+ * getWaypoint, getRoute or getTrack builds it again, and marks every route and track's summary stale.
+ *@pre doc is not NULL
+ *@post numSegments and numGPXData are correct again
+ *@param doc - a pointer to a GPXdoc struct
+**/
+void updateGPXdocCounts(GPXdoc* doc);
+
 // Function that returns a waypoint with the given name.  If more than one exists, return the first one.  
 // Return NULL if the waypoint does not exist
 Waypoint* getWaypoint(const GPXdoc* doc, char* name);
@@ -370,7 +458,8 @@ char* GPXtoJSON(const GPXdoc* gpx);
 
 /** Function to adding an Waypont struct to an existing Route struct
  *@pre arguments are not NULL
- *@post The new waypoint has been added to the Route's waypoint list
+ *@post The new waypoint has been added to the Route's waypoint list, unless memory ran out, in which case the
+ *      Route is unchanged and the Waypoint is still the caller's
  *@return N/A
  *@param rt - a Route struct
  *@param pr - a Waypoint struct
@@ -379,7 +468,8 @@ void addWaypoint(Route *rt, Waypoint *pt);
 
 /** Function to adding an Route struct to an existing GPXdoc struct
  *@pre arguments are not NULL
- *@post The new route has been added to the GPXdoc's routes list
+ *@post The new route has been added to the GPXdoc's routes list, unless memory ran out, in which case the
+ *      GPXdoc is unchanged and the Route is still the caller's
  *@return N/A
  *@param doc - a GPXdoc struct
  *@param rt - a Route struct
@@ -450,4 +540,630 @@ bool isValidGPXFile(char * filename, char * gpxSchemaFile);
 
 char * getJSONRouteList(char * validGPXFile);
 
+
+// Streaming parse
+
+/** Function to create an GPX object based on the contents of an GPX file, without building a libxml2 tree first.
+ * The file is read through an xmlTextReader and the GPXdoc is filled in as the elements are encountered, so peak memory
+ * is proportional to the resulting GPXdoc rather than to the GPXdoc plus the DOM. The result is the same as createGPXdoc.
+ *@pre File name cannot be an empty string or NULL.
+       File represented by this name must exist and must be readable.
+ *@post Either:
+        A valid GPXdoc has been created and its address was returned
+		or 
+		An error occurred, and NULL was returned
+ *@return the pinter to the new struct or NULL
+ *@param fileName - a string containing the name of the GPX file
+**/
+GPXdoc* createGPXdocStreaming(char* fileName);
+
+//Event callbacks for gpxStreamFile.  Any of them may be NULL.  Strings passed to a callback are only valid for the
+//duration of that call.  Missing coordinates and elevations are reported as NAN, a missing time as NULL.
+typedef struct {
+    //A <trk> has started.  Fired once its <name> (if any) has been read, i.e. just before its first segment.
+    void (*onTrackBegin)(const char* name, void* userData);
+    void (*onTrackEnd)(void* userData);
+
+    //A <trkseg> has started/ended
+    void (*onSegmentBegin)(void* userData);
+    void (*onSegmentEnd)(void* userData);
+
+    //A <trkpt> has been read
+    void (*onPoint)(double lat, double lon, double ele, const char* time, void* userData);
+
+    //A <rte> has started.  Fired once its <name> (if any) has been read, i.e. just before its first point.
+    void (*onRouteBegin)(const char* name, void* userData);
+    void (*onRouteEnd)(void* userData);
+
+    //A <rtept> has been read
+    void (*onRoutePoint)(const char* name, double lat, double lon, double ele, const char* time, void* userData);
+
+    //A top-level <wpt> has been read
+    void (*onWaypoint)(const char* name, double lat, double lon, double ele, const char* time, void* userData);
+} GPXStreamCallbacks;
+
+/** Function that reads a GPX file and reports its tracks, segments, points, routes and waypoints through callbacks,
+ * without ever building a GPXdoc.  Memory use is constant regardless of the size of the file.
+ *@pre File name cannot be an empty string or NULL.  callbacks is not NULL.
+ *@post The callbacks have been fired in document order for everything read before the end of the file or the first error
+ *@return true if the whole file was read, false on a parse error
+ *@param fileName - a string containing the name of the GPX file
+ *@param callbacks - the event callbacks to fire
+ *@param userData - passed through unchanged to every callback
+**/
+bool gpxStreamFile(char* fileName, const GPXStreamCallbacks* callbacks, void* userData);
+
+
+// In-memory input
+
+/** Function to create an GPX object from GPX content that is already in memory, e.g. an upload.
+ * Behaves exactly like createGPXdoc, but reads the (buffer, length) pair instead of a file.
+ *@pre buffer is not NULL and holds length bytes of GPX content.  It does not need to be NUL-terminated.
+ *@post Either:
+        A valid GPXdoc has been created and its address was returned
+		or 
+		An error occurred, and NULL was returned
+ *@return the pinter to the new struct or NULL
+ *@param buffer - the GPX content
+ *@param length - the number of bytes in buffer
+**/
+GPXdoc* createGPXdocFromMemory(const char* buffer, size_t length);
+
+/** Function to create an GPX object from GPX content that is already in memory, validating it against a GPX schema file
+ * first.  Behaves exactly like createValidGPXdoc, but reads the (buffer, length) pair instead of a file.
+ *@pre buffer is not NULL and holds length bytes of GPX content.  It does not need to be NUL-terminated.
+       schema file name is not NULL/empty, and represents a valid schema file
+ *@post Either:
+        A valid GPXdoc has been created and its address was returned
+		or 
+		The content was invalid or an error occurred, and NULL was returned
+ *@return the pinter to the new struct or NULL
+ *@param buffer - the GPX content
+ *@param length - the number of bytes in buffer
+ *@param gpxSchemaFile - the name of a schema file
+**/
+GPXdoc* createValidGPXdocFromMemory(const char* buffer, size_t length, char* gpxSchemaFile);
+
+/** Zero-copy variant of createGPXdocFromMemory.  The caller's buffer is borrowed and read in place by the streaming
+ * parser (see createGPXdocStreaming): it is never copied and no libxml2 tree is built from it.
+ *@pre buffer is not NULL and holds length bytes of GPX content.  It does not need to be NUL-terminated.
+       buffer must stay allocated and unmodified until the function returns.  The returned GPXdoc does not
+       reference it, so it may be released afterwards.
+ *@post Either:
+        A valid GPXdoc has been created and its address was returned
+		or 
+		An error occurred, and NULL was returned
+ *@return the pinter to the new struct or NULL
+ *@param buffer - the GPX content
+ *@param length - the number of bytes in buffer
+**/
+GPXdoc* createGPXdocFromBorrowedMemory(const char* buffer, size_t length);
+
+/** Function to create an GPX object from a local GPX file by memory-mapping it.  The mapping is parsed in place by the
+ * streaming parser with a sequential-access hint, so the file is never copied into a heap buffer.  Meant for very large
+ * local files; the result is the same as createGPXdoc.
+ *@pre File name cannot be an empty string or NULL.
+       File represented by this name must exist, must be readable and must be a regular file that can be mapped.
+ *@post Either:
+        A valid GPXdoc has been created and its address was returned
+		or 
+		An error occurred, and NULL was returned
+ *@return the pinter to the new struct or NULL
+ *@param fileName - a string containing the name of the GPX file
+**/
+GPXdoc* createGPXdocMapped(char* fileName);
+
+// Fast path
+
+/** Function to create an GPX object from a GPX file without going through libxml2.  A hand-written tokenizer reads the
+ * (memory-mapped) file once and builds the GPXdoc directly.  It only accepts plain, well-formed GPX - UTF-8, no DOCTYPE,
+ * no CDATA sections and no entities beyond the five predefined ones - and re-parses anything else with libxml2, so the
+ * result is always the same as createGPXdoc.  Invalid files are read twice before NULL is returned.
+ *@pre File name cannot be an empty string or NULL.
+       File represented by this name must exist and must be readable.
+ *@post Either:
+        A valid GPXdoc has been created and its address was returned
+		or 
+		An error occurred, and NULL was returned
+ *@return the pinter to the new struct or NULL
+ *@param fileName - a string containing the name of the GPX file
+**/
+GPXdoc* createGPXdocFast(char* fileName);
+
+/** In-memory variant of createGPXdocFast.  Behaves exactly like createGPXdocFromMemory, but tries the tokenizer first.
+ *@pre buffer is not NULL and holds length bytes of GPX content.  It does not need to be NUL-terminated.
+ *@post Either:
+        A valid GPXdoc has been created and its address was returned
+		or 
+		An error occurred, and NULL was returned
+ *@return the pinter to the new struct or NULL
+ *@param buffer - the GPX content
+ *@param length - the number of bytes in buffer
+**/
+GPXdoc* createGPXdocFastFromMemory(const char* buffer, size_t length);
+
+// Batch loading
+
+/** Function to create GPX objects for many GPX files at once, spreading the parsing across a pool of threads.
+ * Each file is loaded exactly like createGPXdocFast, so the results are the same as calling createGPXdoc on each one.
+ * Idle threads take work from busy ones, so a single very large file doesn't hold up the rest of the batch.
+ *@pre files and out are not NULL, and both have room for n entries.
+ *@post out[i] holds the GPXdoc for files[i], or NULL if that file couldn't be loaded.  The caller owns every
+        GPXdoc in out and must delete each one with deleteGPXdoc.
+ *@return the number of files that could not be loaded (0 if they all loaded), or -1 if the arguments were invalid
+          or the pool couldn't be set up
+ *@param files - the names of the GPX files
+ *@param n - the number of files
+ *@param threads - the number of threads to use, counting the calling thread.  0 or less uses one per online CPU.
+ *@param out - receives one GPXdoc pointer per file
+**/
+int createGPXdocBatch(const char** files, size_t n, int threads, GPXdoc** out);
+
+// Parallel parsing
+
+/** Function to create an GPX object from one large GPX file using several threads.  The file is read like createGPXdocFast,
+ * except that long runs of track points are cut into chunks that are tokenized on separate threads and then joined back
+ * together in their original order.  The result is always the same as createGPXdoc.  Files under a few megabytes, and
+ * files whose points aren't in long runs, gain nothing and are simply parsed on the calling thread.
+ *@pre File name cannot be an empty string or NULL.
+       File represented by this name must exist and must be readable.
+ *@post Either:
+        A valid GPXdoc has been created and its address was returned
+		or 
+		An error occurred, and NULL was returned
+ *@return the pinter to the new struct or NULL
+ *@param fileName - a string containing the name of the GPX file
+ *@param threads - the number of threads to use, counting the calling thread.  0 or less uses one per online CPU.
+**/
+GPXdoc* createGPXdocParallel(char* fileName, int threads);
+
+/** In-memory variant of createGPXdocParallel.
+ *@pre buffer is not NULL and holds length bytes of GPX content.  It does not need to be NUL-terminated.
+ *@post Either:
+        A valid GPXdoc has been created and its address was returned
+		or 
+		An error occurred, and NULL was returned
+ *@return the pinter to the new struct or NULL
+ *@param buffer - the GPX content
+ *@param length - the number of bytes in buffer
+ *@param threads - the number of threads to use, counting the calling thread.  0 or less uses one per online CPU.
+**/
+GPXdoc* createGPXdocParallelFromMemory(const char* buffer, size_t length, int threads);
+
+// Parse contexts
+
+//What went wrong in the last call made with a GPXParseContext
+typedef enum {
+    GPX_OK = 0,
+    GPX_ERROR_ARGUMENT, //A required argument was NULL or empty
+    GPX_ERROR_IO,       //The file could not be opened, read or mapped
+    GPX_ERROR_XML,      //The content is not well-formed XML
+    GPX_ERROR_GPX,      //Well-formed XML, but not a GPX document that a GPXdoc can hold
+    GPX_ERROR_SCHEMA,   //The schema file could not be loaded
+    GPX_ERROR_INVALID,  //The document does not conform to the schema
+    GPX_ERROR_MEMORY    //An allocation failed
+} GPXErrorCode;
+
+//Option flags for createGPXParseContext.  Combine them with |.
+#define GPX_PARSE_DEFAULT 0x0
+#define GPX_PARSE_QUIET 0x1      //Don't print libxml2's messages to stderr.  They are still recorded in the context.
+#define GPX_PARSE_NO_NETWORK 0x2 //Never fetch DTDs or external entities over the network
+#define GPX_PARSE_ARENA 0x4      //Allocate each GPXdoc from a few large blocks of its own (see below)
+#define GPX_PARSE_CONTIGUOUS 0x8 //Lay each list of points out in one contiguous run of memory.  Implies GPX_PARSE_ARENA.
+
+//With GPX_PARSE_ARENA, a GPXdoc and everything in it - waypoints, names, lists, list nodes and GPXData - is carved out of
+//a handful of large blocks instead of being malloc'd piece by piece, and deleteGPXdoc frees the blocks without walking the
+//document.  Such a document is read and written like any other, with these differences:
+//  - Waypoints and routes given to addWaypoint and addRoute (which must be malloc'd, as usual) are taken over by the
+//    document and deleted along with it.
+//  - Nothing in the document may be freed on its own, or with deleteWaypoint, deleteRoute, freeList and the like.  Objects
+//    taken out of its lists, and names that have been replaced, stay valid until deleteGPXdoc.
+//With GPX_PARSE_CONTIGUOUS as well, the Nodes and Waypoints of each list of points (the document's waypoints, and the points
+//of each route and track segment) are moved into one array per list once the document has been built, in list order, so
+//that a scan like getTrackLen walks memory in order.  The lists are still ordinary Lists and can be changed as usual.
+
+//Where the parser gets its temporary buffers (text being collected, attribute values, the batch loader's work queues).
+//The GPXdoc itself (or its arena, with GPX_PARSE_ARENA) is always allocated with malloc, so that deleteGPXdoc can free it.
+typedef struct {
+    void* (*allocate)(size_t size, void* userData);
+    void* (*reallocate)(void* ptr, size_t size, void* userData);
+    void (*release)(void* ptr, void* userData);
+    void* userData;
+} GPXAllocator;
+
+//Running totals over every call made with a GPXParseContext
+typedef struct {
+    //Parse and validate calls, and how many of them returned NULL or false
+    size_t numCalls;
+    size_t numFailures;
+
+    //Fast path parses that the tokenizer had to hand over to libxml2
+    size_t numFallbacks;
+
+    //What the successfully created GPXdocs held
+    size_t numWaypoints;
+    size_t numRoutes;
+    size_t numRoutePoints;
+    size_t numTracks;
+    size_t numTrackPoints;
+
+    //Wall-clock time spent inside the calls
+    double seconds;
+} GPXParseStats;
+
+//Per-caller parser state.  Every parse and validate function has a ...Ctx variant that takes one of these and records
+//its outcome in it instead of just returning NULL or false.  A context must only be used by one thread at a time, but
+//any number of threads can each parse with their own context at once.  Passing NULL as the context is allowed and
+//behaves exactly like the plain function.
+typedef struct GPXParseContext GPXParseContext;
+
+/** Function to create a parse context.
+ *@pre allocator is NULL or has all three functions set.  If the context is used with createGPXdocBatchCtx or
+       createGPXdocParallelCtx, the allocator functions must be thread-safe.
+ *@post A context with no error and zeroed statistics has been created, or NULL was returned if memory ran out
+ *@return the pointer to the new context or NULL
+ *@param options - GPX_PARSE_* flags
+ *@param allocator - the allocator for temporary buffers, or NULL for malloc/realloc/free.  It is copied.
+**/
+GPXParseContext* createGPXParseContext(unsigned int options, const GPXAllocator* allocator);
+
+/** Function to delete a parse context.
+ *@pre ctx is NULL or was created by createGPXParseContext and is not in use
+ *@post ctx has been freed
+ *@param ctx - the context
+**/
+void deleteGPXParseContext(GPXParseContext* ctx);
+
+//Accessors for the outcome of the last call made with ctx.  The message is empty when there is no error, and the line
+//is 0 when the error isn't tied to a line of the input.  The message belongs to the context and is overwritten by its next call.
+GPXErrorCode getGPXParseError(const GPXParseContext* ctx);
+const char* getGPXParseErrorMessage(const GPXParseContext* ctx);
+int getGPXParseErrorLine(const GPXParseContext* ctx);
+
+//Accessors for the statistics and options of ctx
+GPXParseStats getGPXParseStats(const GPXParseContext* ctx);
+void resetGPXParseStats(GPXParseContext* ctx);
+unsigned int getGPXParseOptions(const GPXParseContext* ctx);
+void setGPXParseOptions(GPXParseContext* ctx, unsigned int options);
+
+//Context-aware variants of the parse and validate functions above.  Each one behaves exactly like the function it is
+//named after, and also records its error and statistics in ctx.
+GPXdoc* createGPXdocCtx(GPXParseContext* ctx, char* fileName);
+GPXdoc* createValidGPXdocCtx(GPXParseContext* ctx, char* fileName, char* gpxSchemaFile);
+bool validateGPXDocCtx(GPXParseContext* ctx, GPXdoc* doc, char* gpxSchemaFile);
+GPXdoc* createGPXdocStreamingCtx(GPXParseContext* ctx, char* fileName);
+bool gpxStreamFileCtx(GPXParseContext* ctx, char* fileName, const GPXStreamCallbacks* callbacks, void* userData);
+GPXdoc* createGPXdocFromMemoryCtx(GPXParseContext* ctx, const char* buffer, size_t length);
+GPXdoc* createValidGPXdocFromMemoryCtx(GPXParseContext* ctx, const char* buffer, size_t length, char* gpxSchemaFile);
+GPXdoc* createGPXdocFromBorrowedMemoryCtx(GPXParseContext* ctx, const char* buffer, size_t length);
+GPXdoc* createGPXdocMappedCtx(GPXParseContext* ctx, char* fileName);
+GPXdoc* createGPXdocFastCtx(GPXParseContext* ctx, char* fileName);
+GPXdoc* createGPXdocFastFromMemoryCtx(GPXParseContext* ctx, const char* buffer, size_t length);
+GPXdoc* createGPXdocParallelCtx(GPXParseContext* ctx, char* fileName, int threads);
+GPXdoc* createGPXdocParallelFromMemoryCtx(GPXParseContext* ctx, const char* buffer, size_t length, int threads);
+
+/** Context-aware variant of createGPXdocBatch.  Each worker thread parses with a context of its own that has ctx's
+ * options and allocator, and their statistics are added to ctx once the batch is done.
+ *@pre files and out are not NULL, and both have room for n entries.  errors is NULL or has room for n entries.
+ *@post As for createGPXdocBatch.  errors[i] (if errors is not NULL) holds the error for files[i], GPX_OK if it loaded.
+        The error recorded in ctx is that of the first file that failed.
+ *@return as for createGPXdocBatch
+ *@param ctx - the context, or NULL
+ *@param files - the names of the GPX files
+ *@param n - the number of files
+ *@param threads - the number of threads to use, counting the calling thread.  0 or less uses one per online CPU.
+ *@param out - receives one GPXdoc pointer per file
+ *@param errors - receives one error code per file, or NULL
+**/
+int createGPXdocBatchCtx(GPXParseContext* ctx, const char** files, size_t n, int threads, GPXdoc** out, GPXErrorCode* errors);
+
+// Compiled schemas
+
+//A schema that has been parsed once and can be validated against any number of times.  Validating against it doesn't
+//change it, so one GPXSchema can be shared by any number of threads at once - each call makes its own validation context.
+typedef struct GPXSchema GPXSchema;
+
+/** Function to parse an XSD schema file into a GPXSchema.
+ *@pre gpxSchemaFile is not NULL/empty, and represents a valid schema file
+ *@post Either a GPXSchema has been created and its address was returned, or the schema couldn't be parsed and NULL was returned.
+        The caller must free it with gpxSchemaFree once no other thread is using it.
+ *@return the pointer to the new schema or NULL
+ *@param gpxSchemaFile - the name of a schema file
+**/
+GPXSchema* gpxSchemaLoad(char* gpxSchemaFile);
+
+/** Function to free a GPXSchema.
+ *@pre schema is NULL or was returned by gpxSchemaLoad, and no call is using it
+ *@post schema has been freed
+ *@param schema - the schema
+**/
+void gpxSchemaFree(GPXSchema* schema);
+
+//Variants of the validating functions that take an already compiled schema instead of a schema file name.  Each one
+//behaves exactly like the function it is named after, without parsing the schema again.  schema must not be NULL.
+GPXdoc* createValidGPXdocWithSchema(char* fileName, GPXSchema* schema);
+bool validateGPXDocWithSchema(GPXdoc* doc, GPXSchema* schema);
+GPXdoc* createValidGPXdocFromMemoryWithSchema(const char* buffer, size_t length, GPXSchema* schema);
+bool isValidGPXFileWithSchema(char* filename, GPXSchema* schema);
+bool createGPXFileFromJSONWithSchema(char* filename, char* creator, char* version, GPXSchema* schema);
+
+//Context-aware variants of the above
+GPXSchema* gpxSchemaLoadCtx(GPXParseContext* ctx, char* gpxSchemaFile);
+GPXdoc* createValidGPXdocWithSchemaCtx(GPXParseContext* ctx, char* fileName, GPXSchema* schema);
+bool validateGPXDocWithSchemaCtx(GPXParseContext* ctx, GPXdoc* doc, GPXSchema* schema);
+GPXdoc* createValidGPXdocFromMemoryWithSchemaCtx(GPXParseContext* ctx, const char* buffer, size_t length, GPXSchema* schema);
+
+// Structural validation
+
+/** Function to validate a GPXdoc against the GPX 1.1 rules without going through libxml2.  It checks the same things as
+ * validateGPXDoc with gpx.xsd - the namespace and version, coordinate ranges, required fields, which GPXData names are
+ * allowed where and in what order, and the format of their values (decimals, dates, fix types, ...) - directly on the
+ * structs, in one pass and without allocating.  The checks are made on the document as writeGPXdoc would write it.
+ *@pre GPXdoc object exists and is not NULL
+ *@post GPXdoc has not been modified in any way
+ *@return the boolean aud indicating whether the GPXdoc is valid
+ *@param doc - a pointer to a GPXdoc struct
+**/
+bool validateGPXDocStructure(const GPXdoc* doc);
+
+//Context-aware variant of validateGPXDocStructure.  When the document is invalid, the error message says which element
+//was at fault and why, e.g. "trk 1, segment 2, point 7: longitude 180.000000 is out of range".
+bool validateGPXDocStructureCtx(GPXParseContext* ctx, const GPXdoc* doc);
+
+// Point columns
+
+//The name and other data of one point in a GPXPointColumns
+typedef struct {
+    //Index of the point
+    int index;
+
+    //Point name.  Must not be NULL.  May be an empty string.
+    char* name;
+
+    //The point's otherData.  It must not be NULL.  It may be empty.
+    List* otherData;
+} GPXPointExtra;
+
+//A structure-of-arrays copy of the points of a route or track: point i is latitude[i], longitude[i], elevation[i] and
+//time[i].  Scans over a single column read dense memory instead of following list nodes, which is what the functions
+//below (and any vectorised analytics) are built on.  A GPXPointColumns is a copy: changing it doesn't change the route
+//or track it came from, or the other way round.
+typedef struct {
+    //Number of points
+    int length;
+
+    //Coordinates in degrees
+    double* latitude;
+    double* longitude;
+
+    //The Waypoints' elevation and time
+    double* elevation;
+    int64_t* time;
+
+    //The index of the first point of each track segment.  A route counts as one segment.
+    int numSegments;
+    int* segmentStarts;
+
+    //The points that have a name or other data, in order of index.  Most track points have neither.
+    int numExtras;
+    GPXPointExtra* extras;
+} GPXPointColumns;
+
+/** Functions to copy the points of a route, a track segment or a whole track into columns.
+ *@pre The route, segment or track is not NULL
+ *@post The route, segment or track has not been modified in any way
+ *@return the pointer to the new GPXPointColumns, or NULL if memory ran out.  Free it with deletePointColumns.
+**/
+GPXPointColumns* routeToPointColumns(const Route* rt);
+GPXPointColumns* segmentToPointColumns(const TrackSegment* seg);
+GPXPointColumns* trackToPointColumns(const Track* tr);
+
+//Frees a GPXPointColumns and everything in it.  columns may be NULL.
+void deletePointColumns(GPXPointColumns* columns);
+
+//Returns the name and other data of a point, or NULL if it has neither (or index is out of range).
+const GPXPointExtra* getPointColumnsExtra(const GPXPointColumns* columns, int index);
+
+/** Function to rebuild a point as a Waypoint, for code that works on Waypoints.
+ *@pre columns is not NULL
+ *@return a new Waypoint, to be freed with deleteWaypoint, or NULL if index is out of range or memory ran out
+ *@param columns - a pointer to a GPXPointColumns struct
+ *@param index - the index of the point
+**/
+Waypoint* getPointColumnsWaypoint(const GPXPointColumns* columns, int index);
+
+//The length in metres of the points taken in order, across segments - the same as getRouteLen or getTrackLen on the
+//route or track the columns came from.  0 if columns is NULL.
+float getPointColumnsLen(const GPXPointColumns* columns);
+
+//Sets bounds to the bounding box of the points.  Returns false, leaving bounds alone, if there are none.
+bool getPointColumnsBounds(const GPXPointColumns* columns, GPXBounds* bounds);
+
+//The same test as isLoopRoute and isLoopTrack: at least 4 points, with the first and last within delta metres.
+bool isLoopPointColumns(const GPXPointColumns* columns, float delta);
+
+/** Function to simplify the points with the Douglas-Peucker algorithm.  Each segment is simplified on its own and keeps
+ * its first and last point; every point that is dropped is within tolerance metres of the line between the points
+ * kept on either side of it.  The points that are kept keep their names and other data.
+ *@pre columns is not NULL and tolerance is not negative
+ *@return a new GPXPointColumns with the points that were kept, or NULL if memory ran out
+ *@param columns - a pointer to a GPXPointColumns struct
+ *@param tolerance - the largest distance in metres a dropped point may be from the simplified line
+**/
+GPXPointColumns* simplifyPointColumns(const GPXPointColumns* columns, float tolerance);
+
+// Compact points
+
+//Fixed-point coordinates are whole multiples of 1e-7 degrees, so any latitude or longitude fits in an int32_t
+#define GPX_FIXED_POINT_SCALE 10000000
+
+//A copy of just the coordinates of a route or track, in fixed point: point i is latitude[i] and longitude[i], in
+//1e-7 degrees.  It takes 8 bytes a point, a fraction of what its Waypoints do, and rounds each coordinate by at most
+//0.5e-7 degrees (about a centimetre).  Like a GPXPointColumns, it is a copy.
+typedef struct {
+    //Number of points
+    int length;
+
+    //Coordinates in 1e-7 degrees
+    int32_t* latitude;
+    int32_t* longitude;
+
+    //The index of the first point of each track segment.  A route counts as one segment.
+    int numSegments;
+    int* segmentStarts;
+} GPXCompactPoints;
+
+/** Functions to convert between degrees and fixed point.
+ *@return degreesToFixedPoint returns false, leaving *fixed alone, if degrees is NaN or outside -180 to 180
+**/
+bool degreesToFixedPoint(double degrees, int32_t* fixed);
+double fixedPointToDegrees(int32_t fixed);
+
+/** Functions to copy the coordinates of a route, a track segment or a whole track into compact points.
+ *@pre The route, segment or track is not NULL
+ *@post The route, segment or track has not been modified in any way
+ *@return the pointer to the new GPXCompactPoints, or NULL if a coordinate is outside -180 to 180 degrees or memory ran
+ *        out.  Free it with deleteCompactPoints.
+**/
+GPXCompactPoints* routeToCompactPoints(const Route* rt);
+GPXCompactPoints* segmentToCompactPoints(const TrackSegment* seg);
+GPXCompactPoints* trackToCompactPoints(const Track* tr);
+
+//Frees a GPXCompactPoints and everything in it.  points may be NULL.
+void deleteCompactPoints(GPXCompactPoints* points);
+
+//Sets latitude and longitude to the coordinates of a point, in degrees.  Returns false if index is out of range.
+bool getCompactPoint(const GPXCompactPoints* points, int index, double* latitude, double* longitude);
+
+//The haversine distance in metres between two fixed-point coordinates, on the same sphere as getRouteLen and getTrackLen
+double getFixedPointDistance(int32_t latitude1, int32_t longitude1, int32_t latitude2, int32_t longitude2);
+
+//The length in metres of the points taken in order, across segments.  It agrees with getPointColumnsLen to within the
+//rounding of the coordinates.  0 if points is NULL.
+float getCompactPointsLen(const GPXCompactPoints* points);
+
+//Sets bounds to the bounding box of the points.  Returns false, leaving bounds alone, if there are none.
+bool getCompactPointsBounds(const GPXCompactPoints* points, GPXBounds* bounds);
+
+/** Function to find the point nearest to a location.
+ *@pre points is not NULL
+ *@return the index of the nearest point (the first of them, on a tie), or -1 if there are no points or the location
+ *        is outside -180 to 180 degrees
+ *@param latitude, longitude - the location, in degrees
+ *@param distance - if it is not NULL, set to the distance in metres to the nearest point
+**/
+int findNearestCompactPoint(const GPXCompactPoints* points, double latitude, double longitude, float* distance);
+
+// Distance models
+
+//How the distance between two points is measured.  getRouteLen, getTrackLen and getPointColumnsLen always use
+//GPX_DISTANCE_HAVERSINE; the ...WithModel functions below take the model per call.
+//  - GPX_DISTANCE_HAVERSINE: a great circle on a sphere of radius 6371 km.  About 0.5% off the ellipsoid at worst.
+//  - GPX_DISTANCE_EQUIRECTANGULAR: a flat projection around each hop, for the short hops of a recorded track.  About
+//    twice as fast as the haversine, and within a part in 1e7 of it for hops under 10 km, but 0.2% off at 1000 km.
+//  - GPX_DISTANCE_VINCENTY: a geodesic on the WGS-84 ellipsoid, to well under a millimetre, for survey work.  20 to 40
+//    times slower than the haversine.  Nearly antipodal points, where Vincenty's formula doesn't converge, get the
+//    haversine distance.
+//bin/distanceBenchmark (make distanceBenchmark) measures all three on your machine.
+//Lengths are summed in double precision with Kahan summation, so a length over any number of hops carries no
+//more rounding than its largest hop.
+typedef enum {
+  GPX_DISTANCE_HAVERSINE = 0,
+  GPX_DISTANCE_EQUIRECTANGULAR,
+  GPX_DISTANCE_VINCENTY
+} GPXDistanceModel;
+
+//The distance in metres between two points given in degrees.  0 if model isn't one of the above.
+double getGPXDistance(double latitude1, double longitude1, double latitude2, double longitude2, GPXDistanceModel model);
+
+/** Function that returns the length of a path given as arrays of coordinates
+ *@pre latitude and longitude each hold length coordinates, in degrees
+ *@return the length in metres of the points taken in order, or 0 if an array is NULL or model isn't one of the above
+ *@param latitude, longitude - the coordinates
+ *@param length - the number of points
+ *@param model - how to measure each hop
+**/
+double getPathLen(const double* latitude, const double* longitude, int length, GPXDistanceModel model);
+
+//getRouteLen, getTrackLen and getPointColumnsLen with a choice of model, in double precision.  0 if the first argument
+//is NULL or model isn't one of the above.
+double getRouteLenWithModel(const Route* rt, GPXDistanceModel model);
+double getTrackLenWithModel(const Track* tr, GPXDistanceModel model);
+double getPointColumnsLenWithModel(const GPXPointColumns* columns, GPXDistanceModel model);
+
+// Route and track summaries
+
+/** Functions to get the number of points, length, bounding box and endpoints of a route or track.  They are worked out
+ * the first time they are asked for and kept in the route or track, so asking again - as getRouteLen, getTrackLen,
+ * isLoopRoute, isLoopTrack, numRoutesWithLength and numTracksWithLength do - is O(1) for a route, and O(segments) for a
+ * track, until the points change.  Points added or removed through the list functions are noticed by themselves; a point
+ * whose coordinates are changed in place is only noticed once updateGPXdocCounts is called.  Any number of threads can
+ * ask about the same route or track at once.
+ *@pre The route or track is not NULL, and is not being changed by another thread
+ *@return false, leaving summary alone, if an argument is NULL
+ *@param summary - set to the summary
+**/
+bool getRouteSummary(const Route* rt, GPXPathSummary* summary);
+bool getTrackSummary(const Track* tr, GPXPathSummary* summary);
+
+
+// Cumulative distances
+
+//The points of a route, a track segment or a whole track, each with the distance along the path to it, so that distances
+//between points and positions along the path can be found without walking the waypoint lists.  Like a GPXPointColumns,
+//it is a copy: changing the route or track doesn't change it.
+typedef struct {
+    //Number of points
+    int length;
+
+    //Coordinates in degrees
+    double* latitude;
+    double* longitude;
+
+    //distance[i] is the length in metres of the path from the first point to point i, measured with the same haversine as
+    //getTrackLen.  distance[0] is 0, and distance[length - 1] is the length of the whole path, to within rounding.  A
+    //track's distances run on across its segments, including the hops from the end of each to the start of the next.
+    double* distance;
+
+    //The index of the first point of each track segment.  A route counts as one segment.
+    int numSegments;
+    int* segmentStarts;
+} GPXCumulativeDistances;
+
+/** Functions to build the cumulative distances of a route, a track segment or a whole track, in one pass over its points.
+ *@pre The route, segment or track is not NULL
+ *@post The route, segment or track has not been modified in any way
+ *@return the pointer to the new GPXCumulativeDistances, or NULL if memory ran out.  Free it with deleteCumulativeDistances.
+**/
+GPXCumulativeDistances* routeToCumulativeDistances(const Route* rt);
+GPXCumulativeDistances* segmentToCumulativeDistances(const TrackSegment* seg);
+GPXCumulativeDistances* trackToCumulativeDistances(const Track* tr);
+
+//Frees a GPXCumulativeDistances and everything in it.  distances may be NULL.
+void deleteCumulativeDistances(GPXCumulativeDistances* distances);
+
+//The distance in metres along the path between points from and to, in either order, or -1 if either is out of range.  O(1).
+double getDistanceBetweenPoints(const GPXCumulativeDistances* distances, int from, int to);
+
+/** Function to find the position a given distance along the path.  The binary search makes it O(log n).
+ *@pre distances is not NULL
+ *@return the index of the last point at or before the position, or -1 if distance is negative, longer than the path or NAN
+ *@param distance - metres from the first point
+ *@param latitude, longitude - if they are not NULL, set to the position, in degrees.  A position between two points is
+ *        interpolated along the straight line between them in degrees, which for the hops of a recorded track is within
+ *        centimetres of the great circle.
+**/
+int getPositionAtDistance(const GPXCumulativeDistances* distances, double distance, double* latitude, double* longitude);
+
+/** Function to split a path at a given distance along it.
+ *@pre distances, before and after are not NULL
+ *@post before and after have been set to two new GPXCumulativeDistances: the points up to the split and the points from
+ *      it on, with the position of the split (interpolated, if it falls between points) ending one and starting the other.
+ *      The distances in after are measured from the split.  Both keep their share of the segments.
+ *@return false, leaving before and after alone, if distance is out of range as for getPositionAtDistance or memory ran out
+ *@param distance - metres from the first point
+**/
+bool splitCumulativeDistances(const GPXCumulativeDistances* distances, double distance, GPXCumulativeDistances** before,
+                              GPXCumulativeDistances** after);
+
 #endif
\ No newline at end of file
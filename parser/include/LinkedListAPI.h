@@ -24,6 +24,26 @@ typedef struct listNode{
     struct listNode* next;
 } Node;
 
+/**
+ * Where a list gets the memory for its List struct and its Nodes, for lists that shouldn't use malloc and free.
+ * The List struct and the Nodes have entry points of their own, so an allocator can keep freed Nodes for reuse.
+ * The data stored in the list is not allocated through it - that is still up to deleteData.
+ **/
+typedef struct listAllocator{
+    struct listHead* (*allocateList)(struct listAllocator* allocator);
+    void (*releaseList)(struct listAllocator* allocator, struct listHead* list);
+    Node* (*allocateNode)(struct listAllocator* allocator);
+    void (*releaseNode)(struct listAllocator* allocator, Node* node);
+} ListAllocator;
+
+/**
+ * A slab allocator for Nodes that any number of lists can share - for example all the lists of one document.  Nodes are
+ * carved out of large slabs instead of being malloc'd one at a time, and Nodes released by the lists are reused.
+ * The pool stays alive as long as any list that uses it does, so it is safe to free the lists in any order.
+ * A pool is not thread-safe: the lists sharing it must only be used by one thread at a time.
+ **/
+typedef struct listNodePool ListNodePool;
+
 /**
  * Metadata head of the list. 
  * Contains no actual data but contains
@@ -34,9 +54,17 @@ typedef struct listHead{
     Node* head;
     Node* tail;
     int length;
+
+    //Bumped by every function that adds data to or removes data from the list, so that something worked out from the
+    //list can tell whether the list has changed since.
+    unsigned long changes;
+
     void (*deleteData)(void* toBeDeleted);
     int (*compare)(const void* first,const void* second);
     char* (*printData)(void* toBePrinted);
+
+    //The allocator for the List struct and its Nodes, or NULL for malloc and free
+    ListAllocator* allocator;
 } List;
 
 
@@ -62,6 +90,18 @@ typedef struct iter{
 **/
 List* initializeList(char* (*printFunction)(void* toBePrinted),void (*deleteFunction)(void* toBeDeleted),int (*compareFunction)(const void* first,const void* second));
 
+/** Function to initialize a list whose List struct and Nodes come from an allocator instead of malloc.
+* Otherwise the same as initializeList.
+*@pre function pointer arguments must not be NULL.  allocator must outlive the list.
+*@post List structure has been allocated from allocator and initialized
+*@return On success returns the new List struct. Returns NULL if any of the arguments are invalid or the allocation fails
+*@param printFunction - function pointer to print a single node of the list
+*@param deleteFunction - function pointer to delete a single piece of data from the list
+*@param compareFunction - function pointer to compare two nodes of the list in order to test for equality or order
+*@param allocator - the allocator, or NULL for malloc and free
+**/
+List* initializeListWithAllocator(char* (*printFunction)(void* toBePrinted),void (*deleteFunction)(void* toBeDeleted),int (*compareFunction)(const void* first,const void* second),ListAllocator* allocator);
+
 
 
 /**Function for creating a node for the linked list. 
@@ -82,8 +122,10 @@ Node* initializeNode(void* data);
 *@pre 'List' type must exist and be used in order to keep track of the linked list.
 *@param list pointer to the List struct
 *@param toBeAdded - a pointer to data that is to be added to the linked list
+*@return true if the data was added, false if list or toBeAdded is NULL or a Node couldn't be allocated.  The data
+*        is still the caller's when it wasn't added.
 **/
-void insertFront(List* list, void* toBeAdded);
+bool insertFront(List* list, void* toBeAdded);
 
 
 
@@ -92,8 +134,10 @@ void insertFront(List* list, void* toBeAdded);
 *@pre 'List' type must exist and be used in order to keep track of the linked list.
 *@param list pointer to the List struct
 *@param toBeAdded - a pointer to data that is to be added to the linked list
+*@return true if the data was added, false if list or toBeAdded is NULL or a Node couldn't be allocated.  The data
+*        is still the caller's when it wasn't added.
 **/
-void insertBack(List* list, void* toBeAdded);
+bool insertBack(List* list, void* toBeAdded);
 
 
 
@@ -122,8 +166,9 @@ void clearList(List* list);
 *@post The node to be added will be placed immediately before or after the first occurrence of a related node
 *@param list - a pointer to the List struct
 *@param toBeAdded - a pointer to data that is to be added to the linked list
+*@return true if the data was added, false otherwise, as for insertBack
 **/
-void insertSorted(List* list, void* toBeAdded);
+bool insertSorted(List* list, void* toBeAdded);
 
 
 
@@ -214,4 +259,124 @@ int getLength(List* list);
  **/
 void* findElement(List * list, bool (*customCompare)(const void* first,const void* second), const void* searchRecord);
 
+/** Moves every node of one list onto the end of another, in order, without copying or reallocating anything.
+ *@pre Both lists exist and hold the same type of data.  dest's allocator must be able to release src's Nodes.
+ *@post dest holds its old contents followed by those of src.  src is empty but still exists.
+ *@param dest - a pointer to the List struct to append to
+ *@param src - a pointer to the List struct whose nodes are moved
+ **/
+void appendList(List* dest, List* src);
+
+/**
+ * A growable array - an alternative to the List for data that is mostly appended to and read in order.  The elements
+ * are kept in one contiguous block of cells, so walking them walks memory in order instead of chasing pointers.  Each
+ * cell is a Node linked to its neighbours, which lets the cells be walked with an ordinary ListIterator as well
+ * (see createVectorListIterator).
+ **/
+typedef struct vector{
+    Node* cells;
+    int length;
+    int capacity;
+    void (*deleteData)(void* toBeDeleted);
+    int (*compare)(const void* first,const void* second);
+    char* (*printData)(void* toBePrinted);
+} Vector;
+
+/**
+ * Vector iterator structure.
+ **/
+typedef struct vectorIter{
+    Vector* vector;
+    int index;
+} VectorIterator;
+
+/** Function to initialize a vector with the appropriate function pointers.
+*@pre function pointer arguments must not be NULL
+*@post An empty Vector has been allocated and initialized
+*@return On success returns the new Vector. Returns NULL if malloc fails
+*@param printFunction - function pointer to print a single element of the vector
+*@param deleteFunction - function pointer to delete a single element of the vector
+*@param compareFunction - function pointer to compare two elements of the vector
+**/
+Vector* initializeVector(char* (*printFunction)(void* toBePrinted),void (*deleteFunction)(void* toBeDeleted),int (*compareFunction)(const void* first,const void* second));
+
+/** Adds an element to the end of a vector, growing its block of cells if it is full.  Growing moves the cells, so any
+ * iterator or Node pointer into the vector is invalid afterwards.
+*@pre vector exists
+*@return true on success, false if the vector couldn't grow
+*@param vector - a pointer to the Vector struct
+*@param toBeAdded - a pointer to data that is to be added to the vector
+**/
+bool pushBack(Vector* vector, void* toBeAdded);
+
+/** Returns the element at an index, or NULL if the index is out of range.  Does not alter the vector.
+ *@param vector - a pointer to the Vector struct
+ *@param index - the index, from 0
+ **/
+void* getVectorElement(Vector* vector, int index);
+
+/**Returns the number of elements in the vector, or -1 if vector is NULL.
+ *@param vector - a pointer to the Vector struct
+ **/
+int getVectorLength(Vector* vector);
+
+/** Deletes every element with deleteData and empties the vector.  The block of cells is kept for reuse.
+ *@param vector - a pointer to the Vector struct
+ **/
+void clearVector(Vector* vector);
+
+/** Deletes every element with deleteData and frees the vector.
+ *@param vector - a pointer to the Vector struct, or NULL
+ **/
+void freeVector(Vector* vector);
+
+/** Function for creating an iterator for a vector, pointing at its first element.
+ *@param vector - pointer to the Vector struct to iterate over
+ **/
+VectorIterator createVectorIterator(Vector* vector);
+
+/** Returns the element the iterator points at and moves it on, or NULL once the end of the vector has been reached.
+ *@param iter - a pointer to an iterator for a Vector struct
+ **/
+void* nextVectorElement(VectorIterator* iter);
+
+/** Creates a ListIterator over the cells of a vector, so that nextElement - and any code written for Lists that only
+ * iterates - walks the vector in order.
+ *@pre The vector is not pushed to while the iterator is in use
+ *@param vector - pointer to the Vector struct to iterate over
+ **/
+ListIterator createVectorListIterator(Vector* vector);
+
+/** Function to create a Node pool.
+ *@post A pool with no slabs has been created.  The caller holds a reference to it.
+ *@return the new pool, or NULL if malloc fails
+ **/
+ListNodePool* createNodePool(void);
+
+/** Returns the allocator to give initializeListWithAllocator for lists that should use the pool.  Each such list holds
+ * a reference to the pool until it is freed.
+ *@pre pool exists and the caller still holds a reference to it, or a list using it exists
+ *@param pool - the pool
+ **/
+ListAllocator* nodePoolAllocator(ListNodePool* pool);
+
+/** Gives up the reference that createNodePool returned.  The pool is freed once no list uses it any more.
+ *@param pool - the pool, or NULL
+ **/
+void releaseNodePool(ListNodePool* pool);
+
+/** Returns the pool a list gets its Nodes from, or NULL if it doesn't use one.
+ *@param list - a pointer to the List struct, or NULL
+ **/
+ListNodePool* listNodePool(List* list);
+
+/** Moves all of src's slabs into dest, so that Nodes from src can be moved into dest's lists (see appendList) and
+ * outlive every list that uses src.  Does nothing if either pool is NULL.
+ *@pre Neither pool is being used by another thread
+ *@post src owns no slabs, and carries on allocating from new ones
+ *@param dest - the pool to move the slabs to
+ *@param src - the pool to move them from
+ **/
+void mergeNodePools(ListNodePool* dest, ListNodePool* src);
+
 #endif
\ No newline at end of file
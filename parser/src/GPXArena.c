@@ -0,0 +1,435 @@
+/* Filename: GPXArena.c
+ * Description: Document arenas. A parsed GPXdoc normally costs several mallocs per point - the Waypoint, its name, its otherData
+ *              List, a Node for every list entry and a GPXData for every child element - and deleteGPXdoc then walks the whole
+ *              tree to free them again one by one. With GPX_PARSE_ARENA, everything a parse builds for a document is instead
+ *              carved out of a few large blocks that belong to it, and deleteGPXdoc frees the blocks without looking inside them.
+ *
+ *              An arena document is recognized by its lists: their ListAllocator is the arena's own (see listArena), so any List
+ *              in the document leads back to the arena that owns it. Objects the caller adds afterwards with addWaypoint or addRoute
+ *              are ordinary malloc'd ones; the arena takes them over and deletes them when the document goes.
+ */
+
+#include "GPXHelpers.h"
+#include <stddef.h>
+
+#define ARENA_ALIGNMENT _Alignof(max_align_t)
+#define ARENA_ROUND_UP(size) (((size) + ARENA_ALIGNMENT - 1) & ~((size_t) ARENA_ALIGNMENT - 1))
+
+// Blocks start small, so that a tiny document doesn't cost much, and double up to the maximum.
+#define MIN_ARENA_BLOCK (4 * 1024)
+#define MAX_ARENA_BLOCK (4 * 1024 * 1024)
+
+struct GPXArenaBlock {
+  GPXArenaBlock * next;
+};
+
+struct GPXArenaCleanup {
+  void * object;
+  void (*deleteObject)(void * object);
+  GPXArenaCleanup * next;
+};
+
+// The space at the start of a block that its header takes up, rounded up so the first allocation is aligned.
+#define ARENA_HEADER ARENA_ROUND_UP(sizeof(GPXArenaBlock))
+
+GPXArenaBlock * addArenaBlock(GPXArena * arena, size_t size){
+  GPXArenaBlock * block = (GPXArenaBlock *) malloc(ARENA_HEADER + size);
+
+  if(block == NULL){
+    return NULL;
+  }
+
+  block->next = arena->blocks;
+  arena->blocks = block;
+
+  return block;
+}
+
+void * arenaAllocate(GPXArena * arena, size_t size){
+  size = ARENA_ROUND_UP(size);
+
+  if(size <= (size_t) (arena->limit - arena->next)){
+    void * ptr = arena->next;
+    arena->next += size;
+
+    return ptr;
+  }
+
+  // Something too big to be worth starting a new block for gets a block of its own, and the current block carries on.
+  if(size > arena->nextBlockSize / 4){
+    GPXArenaBlock * block = addArenaBlock(arena, size);
+
+    return (block == NULL) ? NULL : (char *) block + ARENA_HEADER;
+  }
+
+  GPXArenaBlock * block = addArenaBlock(arena, arena->nextBlockSize);
+
+  if(block == NULL){
+    return NULL;
+  }
+
+  arena->next = (char *) block + ARENA_HEADER + size;
+  arena->limit = (char *) block + ARENA_HEADER + arena->nextBlockSize;
+
+  if(arena->nextBlockSize < MAX_ARENA_BLOCK){
+    arena->nextBlockSize *= 2;
+  }
+
+  return (char *) block + ARENA_HEADER;
+}
+
+char * arenaString(GPXArena * arena, const char * str){
+  size_t len = strlen(str);
+  char * copy = (char *) arenaAllocate(arena, len + 1);
+
+  if(copy != NULL){
+    memcpy(copy, str, len + 1);
+  }
+
+  return copy;
+}
+
+/* The ListAllocator for the arena's lists. Nodes given back by clearList or deleteDataFromList are kept for reuse; a List struct
+ * just stays in its block until the arena goes.
+ */
+List * allocateArenaList(ListAllocator * allocator){
+  return (List *) arenaAllocate((GPXArena *) allocator, sizeof(List));
+}
+
+void releaseArenaList(ListAllocator * allocator, List * list){
+}
+
+Node * allocateArenaNode(ListAllocator * allocator){
+  GPXArena * arena = (GPXArena *) allocator;
+
+  if(arena->freeNodes != NULL){
+    Node * node = arena->freeNodes;
+    arena->freeNodes = node->next;
+
+    return node;
+  }
+
+  return (Node *) arenaAllocate(arena, sizeof(Node));
+}
+
+void releaseArenaNode(ListAllocator * allocator, Node * node){
+  GPXArena * arena = (GPXArena *) allocator;
+
+  node->next = arena->freeNodes;
+  arena->freeNodes = node;
+}
+
+GPXArena * createGPXArena(void){
+  GPXArena * arena = (GPXArena *) malloc(sizeof(GPXArena));
+
+  if(arena == NULL){
+    return NULL;
+  }
+
+  arena->lists.allocateList = allocateArenaList;
+  arena->lists.releaseList = releaseArenaList;
+  arena->lists.allocateNode = allocateArenaNode;
+  arena->lists.releaseNode = releaseArenaNode;
+  arena->blocks = NULL;
+  arena->next = NULL;
+  arena->limit = NULL;
+  arena->nextBlockSize = MIN_ARENA_BLOCK;
+  arena->freeNodes = NULL;
+  arena->cleanups = NULL;
+
+  return arena;
+}
+
+void deleteGPXArena(GPXArena * arena){
+  if(arena == NULL){
+    return;
+  }
+
+  // The adopted objects go first - they were added to lists in the blocks, and their delete functions don't look at those,
+  // but the cleanup records themselves live in the blocks.
+  for(GPXArenaCleanup * cleanup = arena->cleanups; cleanup != NULL; cleanup = cleanup->next){
+    cleanup->deleteObject(cleanup->object);
+  }
+
+  GPXArenaBlock * block = arena->blocks;
+
+  while(block != NULL){
+    GPXArenaBlock * next = block->next;
+    free(block);
+    block = next;
+  }
+
+  free(arena);
+}
+
+bool adoptArenaObject(GPXArena * arena, void * object, void (*deleteObject)(void * object)){
+  GPXArenaCleanup * cleanup = (GPXArenaCleanup *) arenaAllocate(arena, sizeof(GPXArenaCleanup));
+
+  if(cleanup == NULL){
+    return false;
+  }
+
+  cleanup->object = object;
+  cleanup->deleteObject = deleteObject;
+  cleanup->next = arena->cleanups;
+  arena->cleanups = cleanup;
+
+  return true;
+}
+
+void disownArenaObject(GPXArena * arena, void * object){
+  for(GPXArenaCleanup ** link = &arena->cleanups; *link != NULL; link = &(*link)->next){
+    if((*link)->object == object){
+      *link = (*link)->next; // The cleanup itself stays in its block until the arena goes.
+      return;
+    }
+  }
+}
+
+void mergeGPXArena(GPXArena * dest, GPXArena * src){
+  if(dest == NULL || src == NULL || dest == src){
+    return;
+  }
+
+  if(src->blocks != NULL){
+    GPXArenaBlock * last = src->blocks;
+
+    while(last->next != NULL){
+      last = last->next;
+    }
+
+    last->next = dest->blocks;
+    dest->blocks = src->blocks;
+  }
+
+  if(src->cleanups != NULL){
+    GPXArenaCleanup * last = src->cleanups;
+
+    while(last->next != NULL){
+      last = last->next;
+    }
+
+    last->next = dest->cleanups;
+    dest->cleanups = src->cleanups;
+  }
+
+  // Whatever src still had free in its current block is given up rather than tracked.
+  src->blocks = NULL;
+  src->next = NULL;
+  src->limit = NULL;
+  src->freeNodes = NULL;
+  src->cleanups = NULL;
+}
+
+GPXArena * listArena(const List * list){
+  if(list == NULL || list->allocator == NULL || list->allocator->allocateNode != allocateArenaNode){
+    return NULL;
+  }
+
+  return (GPXArena *) list->allocator;
+}
+
+/* ***************************************************************************CONSTRUCTORS************************************************************************************* */
+
+// The deleteData of every arena list. The objects in the list are either in the arena's blocks or adopted by the arena, so
+// clearing a list never frees anything - the arena does, all at once.
+void deleteArenaObject(void * data){
+}
+
+List * buildArenaList(GPXArena * arena, char * (*printFunction)(void * toBePrinted), int (*compareFunction)(const void * first, const void * second)){
+  return initializeListWithAllocator(printFunction, deleteArenaObject, compareFunction, &arena->lists);
+}
+
+// Same as buildGPXdoc, except that the document gets an arena of its own and is allocated from it.
+GPXdoc * buildArenaGPXdoc(char * schemaLocation, char * version, char * creator){
+  if(schemaLocation == NULL || version == NULL || creator == NULL || strlen(schemaLocation) >= sizeof(((GPXdoc *) NULL)->namespace)){
+    return NULL;
+  }
+
+  GPXArena * arena = createGPXArena();
+
+  if(arena == NULL){
+    return NULL;
+  }
+
+  GPXdoc * gpx = (GPXdoc *) arenaAllocate(arena, sizeof(GPXdoc));
+
+  if(gpx == NULL){
+    deleteGPXArena(arena);
+    return NULL;
+  }
+
+  gpx->version = (strcmp(version, "\0") == EQUAL_STRINGS) ? SENTINEL_VERSION : strtod(version, NULL);
+  gpx->creator = arenaString(arena, creator);
+  strcpy(gpx->namespace, schemaLocation);
+  gpx->numSegments = 0;
+  gpx->numGPXData = 0;
+  gpx->nameIndex = NULL;
+
+  gpx->waypoints = buildArenaList(arena, waypointToString, compareWaypoints);
+  gpx->routes = buildArenaList(arena, routeToString, compareRoutes);
+  gpx->tracks = buildArenaList(arena, trackToString, compareTracks);
+
+  if(gpx->creator == NULL || gpx->waypoints == NULL || gpx->routes == NULL || gpx->tracks == NULL){
+    deleteGPXArena(arena);
+    return NULL;
+  }
+
+  return gpx;
+}
+
+Track * buildArenaTrack(GPXArena * arena){
+  Track * track = (Track *) arenaAllocate(arena, sizeof(Track));
+
+  if(track == NULL){
+    return NULL;
+  }
+
+  track->name = arenaString(arena, "\0");
+  memset(&track->summary, 0, sizeof(GPXSummaryCache));
+  track->segments = buildArenaList(arena, trackSegmentToString, compareTrackSegments);
+  track->otherData = buildArenaList(arena, gpxDataToString, compareGpxData);
+
+  if(track->name == NULL || track->segments == NULL || track->otherData == NULL){
+    return NULL;
+  }
+
+  return track;
+}
+
+TrackSegment * buildArenaTrackSegment(GPXArena * arena){
+  TrackSegment * trackSegment = (TrackSegment *) arenaAllocate(arena, sizeof(TrackSegment));
+
+  if(trackSegment == NULL){
+    return NULL;
+  }
+
+  trackSegment->waypoints = buildArenaList(arena, waypointToString, compareWaypoints);
+
+  return (trackSegment->waypoints == NULL) ? NULL : trackSegment;
+}
+
+Route * buildArenaRoute(GPXArena * arena){
+  Route * route = (Route *) arenaAllocate(arena, sizeof(Route));
+
+  if(route == NULL){
+    return NULL;
+  }
+
+  route->name = arenaString(arena, "\0");
+  route->doc = NULL;
+  memset(&route->summary, 0, sizeof(GPXSummaryCache));
+  route->waypoints = buildArenaList(arena, waypointToString, compareWaypoints);
+  route->otherData = buildArenaList(arena, gpxDataToString, compareGpxData);
+
+  if(route->name == NULL || route->waypoints == NULL || route->otherData == NULL){
+    return NULL;
+  }
+
+  return route;
+}
+
+// Same as buildWaypoint with an empty name - including reading the latitude only when there is a longitude.
+Waypoint * buildArenaWaypoint(GPXArena * arena, char * longitude, char * latitude){
+  if(longitude == NULL || latitude == NULL){
+    return NULL;
+  }
+
+  Waypoint * waypoint = (Waypoint *) arenaAllocate(arena, sizeof(Waypoint));
+
+  if(waypoint == NULL){
+    return NULL;
+  }
+
+  waypoint->name = arenaString(arena, "\0");
+  waypoint->longitude = SENTINEL_LAT_LON;
+  waypoint->latitude = SENTINEL_LAT_LON;
+  waypoint->elevation = NAN;
+  waypoint->time = GPX_NO_TIME;
+  waypoint->otherData = buildArenaList(arena, gpxDataToString, compareGpxData);
+
+  if(waypoint->name == NULL || waypoint->otherData == NULL){
+    return NULL;
+  }
+
+  if(strcmp(longitude, "\0") != EQUAL_STRINGS){
+    waypoint->longitude = parseGPXNumber(longitude, NULL);
+    waypoint->latitude = parseGPXNumber(latitude, NULL);
+  }
+
+  return waypoint;
+}
+
+/* ***************************************************************************CONTIGUOUS POINTS************************************************************************************* */
+
+// A point of a packed list: the Node and the Waypoint it holds, side by side, so that a scan reads one array from start to end.
+typedef struct {
+  Node node;
+  Waypoint waypoint;
+} PackedPoint;
+
+// Moves the points of a list into one array of PackedPoints, in list order. The Waypoints are copied as they are - their names
+// and otherData lists don't refer back to them - and the old copies stay behind in the arena, unused.
+bool packArenaPoints(GPXArena * arena, List * points){
+  int numPoints = points->length;
+
+  if(numPoints < 2){
+    return true;
+  }
+
+  PackedPoint * packed = (PackedPoint *) arenaAllocate(arena, sizeof(PackedPoint) * numPoints);
+
+  if(packed == NULL){
+    return false;
+  }
+
+  Node * node = points->head;
+
+  for(int i = 0; i < numPoints; i++){
+    Node * next = node->next;
+
+    packed[i].waypoint = *((Waypoint *) node->data);
+    packed[i].node.data = &packed[i].waypoint;
+    packed[i].node.previous = (i == 0) ? NULL : &packed[i - 1].node;
+    packed[i].node.next = (i == numPoints - 1) ? NULL : &packed[i + 1].node;
+
+    releaseArenaNode(&arena->lists, node);
+    node = next;
+  }
+
+  points->head = &packed[0].node;
+  points->tail = &packed[numPoints - 1].node;
+
+  return true;
+}
+
+void packGPXdocPoints(GPXdoc * gpx){
+  GPXArena * arena = listArena(gpx->waypoints);
+
+  if(arena == NULL || packArenaPoints(arena, gpx->waypoints) == false){
+    return;
+  }
+
+  ListIterator routes = createIterator(gpx->routes);
+  Route * route;
+
+  while((route = (Route *) nextElement(&routes)) != NULL){
+    if(packArenaPoints(arena, route->waypoints) == false){
+      return;
+    }
+  }
+
+  ListIterator tracks = createIterator(gpx->tracks);
+  Track * track;
+
+  while((track = (Track *) nextElement(&tracks)) != NULL){
+    ListIterator segments = createIterator(track->segments);
+    TrackSegment * segment;
+
+    while((segment = (TrackSegment *) nextElement(&segments)) != NULL){
+      if(packArenaPoints(arena, segment->waypoints) == false){
+        return;
+      }
+    }
+  }
+}
@@ -0,0 +1,246 @@
+/* Filename: GPXBatch.c
+ * Description: Loads many GPX files at once on a pool of threads. Each worker starts with an even, contiguous share of the
+ *              files and works through it from the front. A worker that runs dry steals the back half of whatever share has
+ *              the most left, so one huge file only holds up the worker that happens to be parsing it - the rest of that
+ *              worker's share gets picked up by the others. Every worker parses with a GPXParseContext of its own, so nothing
+ *              but the queues is shared.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "GPXHelpers.h"
+#include <pthread.h>
+#include <unistd.h>
+
+// A worker's share of the files: the indexes from next up to (not including) end.
+typedef struct {
+  pthread_mutex_t lock;
+  size_t next;
+  size_t end;
+} BatchQueue;
+
+typedef struct {
+  const char ** files;
+  GPXdoc ** out;
+  GPXErrorCode * errors;
+  BatchQueue * queues;
+  int numWorkers;
+} BatchPool;
+
+typedef struct {
+  BatchPool * pool;
+  GPXParseContext * ctx;
+  int id;
+} BatchWorker;
+
+// Takes the next file from the front of a worker's own share.
+bool takeBatchWork(BatchQueue * queue, size_t * index){
+  bool found = false;
+
+  pthread_mutex_lock(&queue->lock);
+
+  if(queue->next < queue->end){
+    *index = queue->next++;
+    found = true;
+  }
+
+  pthread_mutex_unlock(&queue->lock);
+
+  return found;
+}
+
+size_t remainingBatchWork(BatchQueue * queue){
+  pthread_mutex_lock(&queue->lock);
+  size_t remaining = queue->end - queue->next;
+  pthread_mutex_unlock(&queue->lock);
+
+  return remaining;
+}
+
+// Moves the back half of the fullest other share into the worker's own (empty) share. Returns false once there's nothing left anywhere.
+bool stealBatchWork(BatchPool * pool, int id){
+  int victim = -1;
+  size_t most = 0;
+
+  for(int i = 1; i < pool->numWorkers; i++){
+    int candidate = (id + i) % pool->numWorkers;
+    size_t remaining = remainingBatchWork(&pool->queues[candidate]);
+
+    if(remaining > most){
+      most = remaining;
+      victim = candidate;
+    }
+  }
+
+  if(victim == -1){
+    return false;
+  }
+
+  BatchQueue * queue = &pool->queues[victim];
+  size_t start = 0;
+  size_t end = 0;
+
+  pthread_mutex_lock(&queue->lock);
+
+  if(queue->next < queue->end){
+    start = queue->next + (queue->end - queue->next) / 2;
+    end = queue->end;
+    queue->end = start;
+  }
+
+  pthread_mutex_unlock(&queue->lock);
+
+  // The victim may have emptied its share since we looked. That's fine - looking again will find other work or nothing.
+  BatchQueue * own = &pool->queues[id];
+
+  pthread_mutex_lock(&own->lock);
+  own->next = start;
+  own->end = end;
+  pthread_mutex_unlock(&own->lock);
+
+  return true;
+}
+
+void * runBatchWorker(void * arg){
+  BatchWorker * worker = (BatchWorker *) arg;
+  BatchPool * pool = worker->pool;
+  size_t index;
+
+  do{
+    while(takeBatchWork(&pool->queues[worker->id], &index) == true){
+      pool->out[index] = createGPXdocFastCtx(worker->ctx, (char *) pool->files[index]);
+      pool->errors[index] = getGPXParseError(worker->ctx);
+    }
+  }while(stealBatchWork(pool, worker->id) == true);
+
+  return NULL;
+}
+
+void freeBatchPool(const GPXAllocator * allocator, BatchPool * pool, BatchWorker * workers, pthread_t * threadIds, bool * started){
+  if(workers != NULL){
+    for(int i = 0; i < pool->numWorkers; i++){
+      deleteGPXParseContext(workers[i].ctx);
+    }
+  }
+
+  releaseScratch(allocator, pool->queues);
+  releaseScratch(allocator, pool->errors);
+  releaseScratch(allocator, workers);
+  releaseScratch(allocator, threadIds);
+  releaseScratch(allocator, started);
+}
+
+int createGPXdocBatchCtx(GPXParseContext * ctx, const char ** files, size_t n, int threads, GPXdoc ** out, GPXErrorCode * errors){
+  const GPXAllocator * allocator = contextAllocator(ctx);
+
+  // Nothing is parsed with ctx itself - the workers' contexts count the files, and their totals are added to ctx at the end.
+  clearGPXParseError(ctx);
+
+  if(files == NULL || out == NULL){
+    setGPXParseError(ctx, GPX_ERROR_ARGUMENT, NULL);
+    return -1;
+  }
+
+  if(threads <= 0){
+    long online = sysconf(_SC_NPROCESSORS_ONLN);
+    threads = (online > 0) ? (int) online : 1;
+  }
+
+  if((size_t) threads > n){
+    threads = (n == 0) ? 1 : (int) n;
+  }
+
+  for(size_t i = 0; i < n; i++){
+    out[i] = NULL;
+  }
+
+  // Get libxml2's global setup done before any worker might need it.
+  LIBXML_TEST_VERSION
+
+  BatchPool pool = { files, out, NULL, NULL, threads };
+  BatchWorker * workers = (BatchWorker *) allocateScratch(allocator, sizeof(BatchWorker) * threads);
+  pthread_t * threadIds = (pthread_t *) allocateScratch(allocator, sizeof(pthread_t) * threads);
+  bool * started = (bool *) allocateScratch(allocator, sizeof(bool) * threads);
+
+  pool.queues = (BatchQueue *) allocateScratch(allocator, sizeof(BatchQueue) * threads);
+  pool.errors = (GPXErrorCode *) allocateScratch(allocator, sizeof(GPXErrorCode) * (n + 1));
+
+  if(workers != NULL){
+    for(int i = 0; i < threads; i++){
+      workers[i].ctx = NULL;
+    }
+  }
+
+  bool ready = (pool.queues != NULL && pool.errors != NULL && workers != NULL && threadIds != NULL && started != NULL);
+
+  for(int i = 0; ready == true && i < threads; i++){
+    workers[i].ctx = createGPXParseContext(getGPXParseOptions(ctx), allocator);
+    ready = (workers[i].ctx != NULL);
+  }
+
+  if(ready == false){
+    freeBatchPool(allocator, &pool, workers, threadIds, started);
+    setGPXParseError(ctx, GPX_ERROR_MEMORY, NULL);
+    return -1;
+  }
+
+  for(int i = 0; i < threads; i++){
+    pthread_mutex_init(&pool.queues[i].lock, NULL);
+    pool.queues[i].next = n * i / threads;
+    pool.queues[i].end = n * (i + 1) / threads;
+    workers[i].pool = &pool;
+    workers[i].id = i;
+    started[i] = false;
+  }
+
+  // The calling thread is worker 0. If a thread can't be started, its share is simply stolen by the workers that are running.
+  for(int i = 1; i < threads; i++){
+    started[i] = (pthread_create(&threadIds[i], NULL, runBatchWorker, &workers[i]) == 0);
+  }
+
+  runBatchWorker(&workers[0]);
+
+  for(int i = 1; i < threads; i++){
+    if(started[i] == true){
+      pthread_join(threadIds[i], NULL);
+    }
+  }
+
+  for(int i = 0; i < threads; i++){
+    pthread_mutex_destroy(&pool.queues[i].lock);
+
+    if(ctx != NULL){
+      GPXParseStats stats = getGPXParseStats(workers[i].ctx);
+      addGPXParseStats(&ctx->stats, &stats);
+    }
+  }
+
+  int numFailed = 0;
+  size_t firstFailed = n;
+
+  for(size_t i = 0; i < n; i++){
+    if(out[i] == NULL){
+      firstFailed = (numFailed == 0) ? i : firstFailed;
+      numFailed++;
+    }
+
+    if(errors != NULL){
+      errors[i] = pool.errors[i];
+    }
+  }
+
+  if(ctx != NULL && numFailed > 0){
+    char message[MAX_ERROR_MESSAGE];
+
+    snprintf(message, sizeof(message), "%d of %zu files could not be loaded, the first being %s", numFailed, n, files[firstFailed]);
+    setGPXParseError(ctx, pool.errors[firstFailed], message);
+  }
+
+  freeBatchPool(allocator, &pool, workers, threadIds, started);
+
+  return numFailed;
+}
+
+int createGPXdocBatch(const char ** files, size_t n, int threads, GPXdoc ** out){
+  return createGPXdocBatchCtx(NULL, files, n, threads, out, NULL);
+}
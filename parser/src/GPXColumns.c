@@ -0,0 +1,465 @@
+/* Filename: GPXColumns.c
+ * Description: Structure-of-arrays copies of routes and tracks. A GPXPointColumns keeps the coordinates, elevations and times
+ *              of a run of points in parallel arrays, so length, bounds, loop and simplification work reads each value from
+ *              dense memory. Following Nodes to Waypoints is not needed. Only the few points that carry anything else have
+ *              an entry in the side table of extras. That covers a name or a non-empty otherData list, such as a <sym>.
+ *              getPointColumnsWaypoint rebuilds a point's Waypoint from the columns and its extra.
+ */
+
+#include "GPXHelpers.h"
+
+#define MIN_EXTRAS_CAPACITY 16
+#define METRES_PER_DEGREE (6371e3 * M_PI / HALF_CIRCLE_DEGREES)
+
+GPXPointColumns * createPointColumns(int numPoints, int numSegments){
+  GPXPointColumns * columns = (GPXPointColumns *) calloc(1, sizeof(GPXPointColumns));
+
+  if(columns == NULL){
+    return NULL;
+  }
+
+  // One extra element each, so that nothing asks malloc for 0 bytes.
+  columns->latitude = (double *) malloc(sizeof(double) * (numPoints + 1));
+  columns->longitude = (double *) malloc(sizeof(double) * (numPoints + 1));
+  columns->elevation = (double *) malloc(sizeof(double) * (numPoints + 1));
+  columns->time = (int64_t *) malloc(sizeof(int64_t) * (numPoints + 1));
+  columns->segmentStarts = (int *) malloc(sizeof(int) * (numSegments + 1));
+
+  if(columns->latitude == NULL || columns->longitude == NULL || columns->elevation == NULL || columns->time == NULL ||
+     columns->segmentStarts == NULL){
+    deletePointColumns(columns);
+    return NULL;
+  }
+
+  return columns;
+}
+
+// Adds an entry for the point at index, which must come after every point that already has one.
+GPXPointExtra * addPointColumnsExtra(GPXPointColumns * columns, int index, const char * name){
+  int numExtras = columns->numExtras;
+
+  // The table starts with room for MIN_EXTRAS_CAPACITY and doubles each time it fills, which is when numExtras reaches a
+  // power of two.
+  if(numExtras == 0 || (numExtras >= MIN_EXTRAS_CAPACITY && (numExtras & (numExtras - 1)) == 0)){
+    int capacity = (numExtras == 0) ? MIN_EXTRAS_CAPACITY : numExtras * 2;
+    GPXPointExtra * extras = (GPXPointExtra *) realloc(columns->extras, sizeof(GPXPointExtra) * capacity);
+
+    if(extras == NULL){
+      return NULL;
+    }
+
+    columns->extras = extras;
+  }
+
+  GPXPointExtra * extra = &columns->extras[columns->numExtras];
+
+  extra->index = index;
+  extra->name = (char *) malloc(strlen(name) + 1);
+  extra->otherData = initializeList(gpxDataToString, deleteGpxData, compareGpxData);
+
+  if(extra->name == NULL || extra->otherData == NULL){
+    free(extra->name);
+    freeList(extra->otherData);
+    return NULL;
+  }
+
+  strcpy(extra->name, name);
+  columns->numExtras++;
+
+  return extra;
+}
+
+bool addPointColumnsData(GPXPointExtra * extra, const GPXData * gpxData){
+  GPXData * copy = buildGPXData(NULL, gpxData->name, gpxData->value);
+
+  if(copy == NULL){
+    return false;
+  }
+
+  if(insertBack(extra->otherData, copy) == false){
+    deleteGpxData(copy);
+    return false;
+  }
+
+  return true;
+}
+
+// Copies a list of Waypoints to the end of the columns, as a new segment.
+bool addPointColumnsSegment(GPXPointColumns * columns, List * waypoints){
+  columns->segmentStarts[columns->numSegments++] = columns->length;
+
+  ListIterator iterator = createIterator(waypoints);
+  Waypoint * waypoint;
+
+  while((waypoint = (Waypoint *) nextElement(&iterator)) != NULL){
+    int index = columns->length++;
+
+    columns->latitude[index] = waypoint->latitude;
+    columns->longitude[index] = waypoint->longitude;
+    columns->elevation[index] = waypoint->elevation;
+    columns->time[index] = waypoint->time;
+
+    if(strcmp(waypoint->name, "\0") == EQUAL_STRINGS && getLength(waypoint->otherData) == 0){
+      continue;
+    }
+
+    GPXPointExtra * extra = addPointColumnsExtra(columns, index, waypoint->name);
+    ListIterator dataIterator = createIterator(waypoint->otherData);
+    GPXData * gpxData;
+
+    if(extra == NULL){
+      return false;
+    }
+
+    while((gpxData = (GPXData *) nextElement(&dataIterator)) != NULL){
+      if(addPointColumnsData(extra, gpxData) == false){
+        return false;
+      }
+    }
+  }
+
+  return true;
+}
+
+// Distance in metres from point i to the line between points first and last, on a flat projection around first.
+// cosLatitude is the cosine of first's latitude, which scales longitudes to the same metres as latitudes.
+double chordDistance(const GPXPointColumns * columns, int first, int last, int i, double cosLatitude){
+  const double chordX = (columns->longitude[last] - columns->longitude[first]) * cosLatitude * METRES_PER_DEGREE;
+  const double chordY = (columns->latitude[last] - columns->latitude[first]) * METRES_PER_DEGREE;
+  const double pointX = (columns->longitude[i] - columns->longitude[first]) * cosLatitude * METRES_PER_DEGREE;
+  const double pointY = (columns->latitude[i] - columns->latitude[first]) * METRES_PER_DEGREE;
+  const double chordLenSquared = chordX * chordX + chordY * chordY;
+
+  // Past either end of the line, the distance is to that end.
+  double along = (chordLenSquared > 0) ? (pointX * chordX + pointY * chordY) / chordLenSquared : 0;
+
+  along = (along < 0) ? 0 : ((along > 1) ? 1 : along);
+
+  return hypot(pointX - along * chordX, pointY - along * chordY);
+}
+
+/* ***************************************************************************PUBLIC API************************************************************************************* */
+
+GPXPointColumns * routeToPointColumns(const Route * rt){
+  if(rt == NULL){
+    return NULL;
+  }
+
+  GPXPointColumns * columns = createPointColumns(getLength(rt->waypoints), 1);
+
+  if(columns == NULL || addPointColumnsSegment(columns, rt->waypoints) == false){
+    deletePointColumns(columns);
+    return NULL;
+  }
+
+  return columns;
+}
+
+GPXPointColumns * segmentToPointColumns(const TrackSegment * seg){
+  if(seg == NULL){
+    return NULL;
+  }
+
+  GPXPointColumns * columns = createPointColumns(getLength(seg->waypoints), 1);
+
+  if(columns == NULL || addPointColumnsSegment(columns, seg->waypoints) == false){
+    deletePointColumns(columns);
+    return NULL;
+  }
+
+  return columns;
+}
+
+GPXPointColumns * trackToPointColumns(const Track * tr){
+  if(tr == NULL){
+    return NULL;
+  }
+
+  int numPoints = 0;
+  ListIterator iterator = createIterator(tr->segments);
+  TrackSegment * segment;
+
+  while((segment = (TrackSegment *) nextElement(&iterator)) != NULL){
+    numPoints += getLength(segment->waypoints);
+  }
+
+  GPXPointColumns * columns = createPointColumns(numPoints, getLength(tr->segments));
+
+  if(columns == NULL){
+    return NULL;
+  }
+
+  iterator = createIterator(tr->segments);
+
+  while((segment = (TrackSegment *) nextElement(&iterator)) != NULL){
+    if(addPointColumnsSegment(columns, segment->waypoints) == false){
+      deletePointColumns(columns);
+      return NULL;
+    }
+  }
+
+  return columns;
+}
+
+void deletePointColumns(GPXPointColumns * columns){
+  if(columns == NULL){
+    return;
+  }
+
+  for(int i = 0; i < columns->numExtras; i++){
+    free(columns->extras[i].name);
+    freeList(columns->extras[i].otherData);
+  }
+
+  free(columns->extras);
+  free(columns->segmentStarts);
+  free(columns->latitude);
+  free(columns->longitude);
+  free(columns->elevation);
+  free(columns->time);
+  free(columns);
+}
+
+const GPXPointExtra * getPointColumnsExtra(const GPXPointColumns * columns, int index){
+  if(columns == NULL){
+    return NULL;
+  }
+
+  int low = 0;
+  int high = columns->numExtras - 1;
+
+  while(low <= high){
+    int middle = low + (high - low) / 2;
+
+    if(columns->extras[middle].index == index){
+      return &columns->extras[middle];
+    }
+    else if(columns->extras[middle].index < index){
+      low = middle + 1;
+    }
+    else{
+      high = middle - 1;
+    }
+  }
+
+  return NULL;
+}
+
+Waypoint * getPointColumnsWaypoint(const GPXPointColumns * columns, int index){
+  if(columns == NULL || index < 0 || index >= columns->length){
+    return NULL;
+  }
+
+  const GPXPointExtra * extra = getPointColumnsExtra(columns, index);
+  const char * name = (extra == NULL) ? "" : extra->name;
+  Waypoint * waypoint = (Waypoint *) malloc(sizeof(Waypoint));
+
+  if(waypoint == NULL){
+    return NULL;
+  }
+
+  waypoint->name = (char *) malloc(strlen(name) + 1);
+  waypoint->otherData = initializeList(gpxDataToString, deleteGpxData, compareGpxData);
+  waypoint->longitude = columns->longitude[index];
+  waypoint->latitude = columns->latitude[index];
+  waypoint->elevation = columns->elevation[index];
+  waypoint->time = columns->time[index];
+
+  if(waypoint->name == NULL || waypoint->otherData == NULL){
+    deleteWaypoint(waypoint);
+    return NULL;
+  }
+
+  strcpy(waypoint->name, name);
+
+  if(extra != NULL){
+    ListIterator iterator = createIterator(extra->otherData);
+    GPXData * other;
+
+    while((other = (GPXData *) nextElement(&iterator)) != NULL){
+      GPXData * gpxData = buildGPXData(NULL, other->name, other->value);
+
+      if(gpxData == NULL){
+        deleteWaypoint(waypoint);
+        return NULL;
+      }
+
+      if(insertBack(waypoint->otherData, gpxData) == false){
+        deleteGpxData(gpxData);
+        deleteWaypoint(waypoint);
+        return NULL;
+      }
+    }
+  }
+
+  return waypoint;
+}
+
+float getPointColumnsLen(const GPXPointColumns * columns){
+  return (float) getPointColumnsLenWithModel(columns, GPX_DISTANCE_HAVERSINE);
+}
+
+double getPointColumnsLenWithModel(const GPXPointColumns * columns, GPXDistanceModel model){
+  if(columns == NULL){
+    return 0;
+  }
+
+  return getPathLen(columns->latitude, columns->longitude, columns->length, model);
+}
+
+bool getPointColumnsBounds(const GPXPointColumns * columns, GPXBounds * bounds){
+  if(columns == NULL || bounds == NULL || columns->length == 0){
+    return false;
+  }
+
+  GPXBounds box = { columns->latitude[0], columns->longitude[0], columns->latitude[0], columns->longitude[0] };
+
+  // One column at a time, so that each loop is a plain min/max reduction over an array.
+  for(int i = 1; i < columns->length; i++){
+    box.minLatitude = (columns->latitude[i] < box.minLatitude) ? columns->latitude[i] : box.minLatitude;
+    box.maxLatitude = (columns->latitude[i] > box.maxLatitude) ? columns->latitude[i] : box.maxLatitude;
+  }
+
+  for(int i = 1; i < columns->length; i++){
+    box.minLongitude = (columns->longitude[i] < box.minLongitude) ? columns->longitude[i] : box.minLongitude;
+    box.maxLongitude = (columns->longitude[i] > box.maxLongitude) ? columns->longitude[i] : box.maxLongitude;
+  }
+
+  *bounds = box;
+
+  return true;
+}
+
+bool isLoopPointColumns(const GPXPointColumns * columns, float delta){
+  if(columns == NULL || delta < 0 || columns->length < MIN_LOOP_WPTS){
+    return false;
+  }
+
+  int last = columns->length - 1;
+  float distance = computeDistanceBetweenWaypoints(columns->latitude[0], columns->longitude[0], columns->latitude[last],
+                                                   columns->longitude[last]);
+
+  return distance <= delta;
+}
+
+GPXPointColumns * simplifyPointColumns(const GPXPointColumns * columns, float tolerance){
+  if(columns == NULL || tolerance < 0){
+    return NULL;
+  }
+
+  // The stack holds the (first, last) pairs still to be looked at. They never overlap by more than an end point, so there
+  // can't be more of them than there are points.
+  bool * keep = (bool *) calloc(columns->length + 1, sizeof(bool));
+  int * stack = (int *) malloc(sizeof(int) * 2 * (columns->length + 1));
+  int top = 0;
+
+  if(keep == NULL || stack == NULL){
+    free(keep);
+    free(stack);
+    return NULL;
+  }
+
+  for(int segment = 0; segment < columns->numSegments; segment++){
+    int first = columns->segmentStarts[segment];
+    int last = ((segment + 1 < columns->numSegments) ? columns->segmentStarts[segment + 1] : columns->length) - 1;
+
+    if(last < first){ // An empty segment
+      continue;
+    }
+
+    keep[first] = true;
+    keep[last] = true;
+    stack[top++] = first;
+    stack[top++] = last;
+
+    while(top > 0){
+      int end = stack[--top];
+      int start = stack[--top];
+      double cosLatitude = cos(columns->latitude[start] * M_PI / HALF_CIRCLE_DEGREES);
+      double farthest = -1;
+      int farthestIndex = start;
+
+      for(int i = start + 1; i < end; i++){
+        double distance = chordDistance(columns, start, end, i, cosLatitude);
+
+        if(distance > farthest){
+          farthest = distance;
+          farthestIndex = i;
+        }
+      }
+
+      if(farthest > tolerance){
+        keep[farthestIndex] = true;
+        stack[top++] = start;
+        stack[top++] = farthestIndex;
+        stack[top++] = farthestIndex;
+        stack[top++] = end;
+      }
+    }
+  }
+
+  free(stack);
+
+  int numKept = 0;
+
+  for(int i = 0; i < columns->length; i++){
+    numKept += (keep[i] == true) ? 1 : 0;
+  }
+
+  GPXPointColumns * simplified = createPointColumns(numKept, columns->numSegments);
+
+  if(simplified == NULL){
+    free(keep);
+    return NULL;
+  }
+
+  int segment = 0;
+  int extra = 0;
+
+  for(int i = 0; i <= columns->length; i++){
+    // Every segment that starts here (empty ones included) starts at the next point kept.
+    while(segment < columns->numSegments && columns->segmentStarts[segment] == i){
+      simplified->segmentStarts[simplified->numSegments++] = simplified->length;
+      segment++;
+    }
+
+    if(i == columns->length || keep[i] == false){
+      continue;
+    }
+
+    int index = simplified->length++;
+
+    simplified->latitude[index] = columns->latitude[i];
+    simplified->longitude[index] = columns->longitude[i];
+    simplified->elevation[index] = columns->elevation[i];
+    simplified->time[index] = columns->time[i];
+
+    while(extra < columns->numExtras && columns->extras[extra].index < i){
+      extra++;
+    }
+
+    if(extra < columns->numExtras && columns->extras[extra].index == i){
+      GPXPointExtra * copy = addPointColumnsExtra(simplified, index, columns->extras[extra].name);
+      ListIterator iterator = createIterator(columns->extras[extra].otherData);
+      GPXData * gpxData;
+
+      if(copy == NULL){
+        free(keep);
+        deletePointColumns(simplified);
+        return NULL;
+      }
+
+      while((gpxData = (GPXData *) nextElement(&iterator)) != NULL){
+        if(addPointColumnsData(copy, gpxData) == false){
+          free(keep);
+          deletePointColumns(simplified);
+          return NULL;
+        }
+      }
+    }
+  }
+
+  free(keep);
+
+  return simplified;
+}
@@ -0,0 +1,258 @@
+/* Filename: GPXCompact.c
+ * Description: Compact copies of routes and tracks that keep only the coordinates, as 32-bit fixed-point numbers of 1e-7
+ *              degrees - the resolution GPS receivers report. A point takes 8 bytes, against a Waypoint's 40 plus its
+ *              list node, name and otherData, so long histories can stay in memory. The distance functions work on the
+ *              integers directly: a difference between two coordinates is an exact integer subtraction, so short hops
+ *              don't lose precision to cancellation the way differences of nearby doubles do.
+ */
+
+#include "GPXHelpers.h"
+
+#define MAX_FIXED_DEGREES 180.0
+#define RADIANS_PER_UNIT (M_PI / HALF_CIRCLE_DEGREES / GPX_FIXED_POINT_SCALE)
+#define EARTH_MEAN_RADIUS 6371e3
+
+GPXCompactPoints * createCompactPoints(int numPoints, int numSegments){
+  GPXCompactPoints * points = (GPXCompactPoints *) calloc(1, sizeof(GPXCompactPoints));
+
+  if(points == NULL){
+    return NULL;
+  }
+
+  // One extra element each, so that nothing asks malloc for 0 bytes.
+  points->latitude = (int32_t *) malloc(sizeof(int32_t) * (numPoints + 1));
+  points->longitude = (int32_t *) malloc(sizeof(int32_t) * (numPoints + 1));
+  points->segmentStarts = (int *) malloc(sizeof(int) * (numSegments + 1));
+
+  if(points->latitude == NULL || points->longitude == NULL || points->segmentStarts == NULL){
+    deleteCompactPoints(points);
+    return NULL;
+  }
+
+  return points;
+}
+
+// Appends the waypoints of a list as one segment. Fails if a coordinate is out of range.
+bool addCompactPointsSegment(GPXCompactPoints * points, List * waypoints){
+  points->segmentStarts[points->numSegments++] = points->length;
+
+  ListIterator iterator = createIterator(waypoints);
+  Waypoint * waypoint;
+
+  while((waypoint = (Waypoint *) nextElement(&iterator)) != NULL){
+    int index = points->length++;
+
+    if(degreesToFixedPoint(waypoint->latitude, &points->latitude[index]) == false ||
+       degreesToFixedPoint(waypoint->longitude, &points->longitude[index]) == false){
+      return false;
+    }
+  }
+
+  return true;
+}
+
+// The haversine term of two points, given the cosines of their latitudes: it grows with the distance between them, and
+// compactHaversineDistance turns it into metres. sin^2 has a period of 180 degrees, so a longitude difference across the
+// antimeridian needs no wrapping.
+double compactHaversine(int32_t latitude1, int32_t longitude1, double cosLatitude1, int32_t latitude2, int32_t longitude2,
+                        double cosLatitude2){
+  const double halfLatitude = sin((double) ((int64_t) latitude2 - latitude1) * RADIANS_PER_UNIT / 2);
+  const double halfLongitude = sin((double) ((int64_t) longitude2 - longitude1) * RADIANS_PER_UNIT / 2);
+  const double a = halfLatitude * halfLatitude + cosLatitude1 * cosLatitude2 * halfLongitude * halfLongitude;
+
+  return (a > 1) ? 1 : a;
+}
+
+double compactHaversineDistance(double a){
+  return EARTH_MEAN_RADIUS * 2 * atan2(sqrt(a), sqrt(1 - a));
+}
+
+double compactCosLatitude(int32_t latitude){
+  return cos(latitude * RADIANS_PER_UNIT);
+}
+
+/* ***************************************************************************PUBLIC API************************************************************************************* */
+
+bool degreesToFixedPoint(double degrees, int32_t * fixed){
+  // Also false for NAN, which fails both comparisons.
+  if(fixed == NULL || !(degrees >= -MAX_FIXED_DEGREES && degrees <= MAX_FIXED_DEGREES)){
+    return false;
+  }
+
+  *fixed = (int32_t) lround(degrees * GPX_FIXED_POINT_SCALE);
+
+  return true;
+}
+
+double fixedPointToDegrees(int32_t fixed){
+  return (double) fixed / GPX_FIXED_POINT_SCALE;
+}
+
+GPXCompactPoints * routeToCompactPoints(const Route * rt){
+  if(rt == NULL){
+    return NULL;
+  }
+
+  GPXCompactPoints * points = createCompactPoints(getLength(rt->waypoints), 1);
+
+  if(points == NULL || addCompactPointsSegment(points, rt->waypoints) == false){
+    deleteCompactPoints(points);
+    return NULL;
+  }
+
+  return points;
+}
+
+GPXCompactPoints * segmentToCompactPoints(const TrackSegment * seg){
+  if(seg == NULL){
+    return NULL;
+  }
+
+  GPXCompactPoints * points = createCompactPoints(getLength(seg->waypoints), 1);
+
+  if(points == NULL || addCompactPointsSegment(points, seg->waypoints) == false){
+    deleteCompactPoints(points);
+    return NULL;
+  }
+
+  return points;
+}
+
+GPXCompactPoints * trackToCompactPoints(const Track * tr){
+  if(tr == NULL){
+    return NULL;
+  }
+
+  int numPoints = 0;
+  ListIterator iterator = createIterator(tr->segments);
+  TrackSegment * segment;
+
+  while((segment = (TrackSegment *) nextElement(&iterator)) != NULL){
+    numPoints += getLength(segment->waypoints);
+  }
+
+  GPXCompactPoints * points = createCompactPoints(numPoints, getLength(tr->segments));
+
+  if(points == NULL){
+    return NULL;
+  }
+
+  iterator = createIterator(tr->segments);
+
+  while((segment = (TrackSegment *) nextElement(&iterator)) != NULL){
+    if(addCompactPointsSegment(points, segment->waypoints) == false){
+      deleteCompactPoints(points);
+      return NULL;
+    }
+  }
+
+  return points;
+}
+
+void deleteCompactPoints(GPXCompactPoints * points){
+  if(points == NULL){
+    return;
+  }
+
+  free(points->segmentStarts);
+  free(points->latitude);
+  free(points->longitude);
+  free(points);
+}
+
+bool getCompactPoint(const GPXCompactPoints * points, int index, double * latitude, double * longitude){
+  if(points == NULL || latitude == NULL || longitude == NULL || index < 0 || index >= points->length){
+    return false;
+  }
+
+  *latitude = fixedPointToDegrees(points->latitude[index]);
+  *longitude = fixedPointToDegrees(points->longitude[index]);
+
+  return true;
+}
+
+double getFixedPointDistance(int32_t latitude1, int32_t longitude1, int32_t latitude2, int32_t longitude2){
+  double a = compactHaversine(latitude1, longitude1, compactCosLatitude(latitude1), latitude2, longitude2,
+                              compactCosLatitude(latitude2));
+
+  return compactHaversineDistance(a);
+}
+
+float getCompactPointsLen(const GPXCompactPoints * points){
+  if(points == NULL || points->length == 0){
+    return 0;
+  }
+
+  double length = 0.0;
+  double cosPrevious = compactCosLatitude(points->latitude[0]);
+
+  // Each point's cosine is worked out once and used for both of the hops it is on.
+  for(int i = 1; i < points->length; i++){
+    double cosCurrent = compactCosLatitude(points->latitude[i]);
+    double a = compactHaversine(points->latitude[i - 1], points->longitude[i - 1], cosPrevious, points->latitude[i],
+                                points->longitude[i], cosCurrent);
+
+    length += compactHaversineDistance(a);
+    cosPrevious = cosCurrent;
+  }
+
+  return (float) length;
+}
+
+bool getCompactPointsBounds(const GPXCompactPoints * points, GPXBounds * bounds){
+  if(points == NULL || bounds == NULL || points->length == 0){
+    return false;
+  }
+
+  int32_t minLatitude = points->latitude[0];
+  int32_t maxLatitude = points->latitude[0];
+  int32_t minLongitude = points->longitude[0];
+  int32_t maxLongitude = points->longitude[0];
+
+  for(int i = 1; i < points->length; i++){
+    minLatitude = (points->latitude[i] < minLatitude) ? points->latitude[i] : minLatitude;
+    maxLatitude = (points->latitude[i] > maxLatitude) ? points->latitude[i] : maxLatitude;
+  }
+
+  for(int i = 1; i < points->length; i++){
+    minLongitude = (points->longitude[i] < minLongitude) ? points->longitude[i] : minLongitude;
+    maxLongitude = (points->longitude[i] > maxLongitude) ? points->longitude[i] : maxLongitude;
+  }
+
+  bounds->minLatitude = fixedPointToDegrees(minLatitude);
+  bounds->minLongitude = fixedPointToDegrees(minLongitude);
+  bounds->maxLatitude = fixedPointToDegrees(maxLatitude);
+  bounds->maxLongitude = fixedPointToDegrees(maxLongitude);
+
+  return true;
+}
+
+int findNearestCompactPoint(const GPXCompactPoints * points, double latitude, double longitude, float * distance){
+  int32_t targetLatitude, targetLongitude;
+
+  if(points == NULL || points->length == 0 || degreesToFixedPoint(latitude, &targetLatitude) == false ||
+     degreesToFixedPoint(longitude, &targetLongitude) == false){
+    return -1;
+  }
+
+  // The haversine term grows with the distance, so the search compares terms and only the winner is turned into metres.
+  const double cosTarget = compactCosLatitude(targetLatitude);
+  int nearest = 0;
+  double nearestA = 2;
+
+  for(int i = 0; i < points->length; i++){
+    double a = compactHaversine(targetLatitude, targetLongitude, cosTarget, points->latitude[i], points->longitude[i],
+                                compactCosLatitude(points->latitude[i]));
+
+    if(a < nearestA){
+      nearest = i;
+      nearestA = a;
+    }
+  }
+
+  if(distance != NULL){
+    *distance = (float) compactHaversineDistance(nearestA);
+  }
+
+  return nearest;
+}
@@ -0,0 +1,354 @@
+/* Filename: GPXContext.c
+ * Description: GPXParseContext - the per-caller state behind the ...Ctx entry points. A context holds the options and allocator a
+ *              caller parses with, the error from its last call and running statistics. libxml2 reports errors through a handler
+ *              that is kept per thread, so for the length of each call the context installs its own handler on the calling thread
+ *              and puts the previous one back afterwards. Nothing here is shared between threads.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "GPXHelpers.h"
+#include <time.h>
+
+void * allocateWithMalloc(size_t size, void * userData){
+  return malloc(size);
+}
+
+void * reallocateWithRealloc(void * ptr, size_t size, void * userData){
+  return realloc(ptr, size);
+}
+
+void releaseWithFree(void * ptr, void * userData){
+  free(ptr);
+}
+
+const GPXAllocator defaultAllocator = { allocateWithMalloc, reallocateWithRealloc, releaseWithFree, NULL };
+
+const GPXAllocator * contextAllocator(GPXParseContext * ctx){
+  return (ctx == NULL) ? &defaultAllocator : &ctx->allocator;
+}
+
+void * allocateScratch(const GPXAllocator * allocator, size_t size){
+  if(allocator == NULL){
+    allocator = &defaultAllocator;
+  }
+
+  return allocator->allocate(size, allocator->userData);
+}
+
+void * reallocateScratch(const GPXAllocator * allocator, void * ptr, size_t size){
+  if(allocator == NULL){
+    allocator = &defaultAllocator;
+  }
+
+  return allocator->reallocate(ptr, size, allocator->userData);
+}
+
+void releaseScratch(const GPXAllocator * allocator, void * ptr){
+  if(allocator == NULL){
+    allocator = &defaultAllocator;
+  }
+
+  if(ptr != NULL){
+    allocator->release(ptr, allocator->userData);
+  }
+}
+
+int contextXmlOptions(GPXParseContext * ctx){
+  if(ctx != NULL && (ctx->options & GPX_PARSE_NO_NETWORK) != 0){
+    return XML_PARSE_NONET;
+  }
+
+  return 0;
+}
+
+bool contextUsesArena(GPXParseContext * ctx){
+  return ctx != NULL && (ctx->options & (GPX_PARSE_ARENA | GPX_PARSE_CONTIGUOUS)) != 0;
+}
+
+void clearGPXParseError(GPXParseContext * ctx){
+  if(ctx == NULL){
+    return;
+  }
+
+  ctx->error = GPX_OK;
+  ctx->errorMessage[0] = '\0';
+  ctx->errorLine = 0;
+  ctx->errorIsWarning = false;
+}
+
+// Copies a message into the context, dropping the newline libxml2 ends its messages with.
+void storeGPXParseMessage(GPXParseContext * ctx, const char * message){
+  size_t len = strlen(message);
+
+  if(len >= MAX_ERROR_MESSAGE){
+    len = MAX_ERROR_MESSAGE - 1;
+  }
+
+  while(len > 0 && (message[len - 1] == '\n' || message[len - 1] == '\r')){
+    len--;
+  }
+
+  memcpy(ctx->errorMessage, message, len);
+  ctx->errorMessage[len] = '\0';
+}
+
+// The message used when a call fails without anything more specific having been recorded.
+const char * describeGPXError(GPXErrorCode code){
+  switch(code){
+    case GPX_ERROR_ARGUMENT:
+      return "a required argument is NULL or empty";
+    case GPX_ERROR_IO:
+      return "the file could not be read";
+    case GPX_ERROR_XML:
+      return "the content is not well-formed XML";
+    case GPX_ERROR_GPX:
+      return "the content is not a GPX document";
+    case GPX_ERROR_SCHEMA:
+      return "the schema could not be loaded";
+    case GPX_ERROR_INVALID:
+      return "the document is not valid";
+    case GPX_ERROR_MEMORY:
+      return "out of memory";
+    default:
+      return "";
+  }
+}
+
+void setGPXParseError(GPXParseContext * ctx, GPXErrorCode code, const char * message){
+  if(ctx == NULL){
+    return;
+  }
+
+  ctx->error = code;
+  ctx->errorIsWarning = false;
+
+  if(ctx->errorMessage[0] == '\0'){
+    storeGPXParseMessage(ctx, (message != NULL) ? message : describeGPXError(code));
+  }
+}
+
+GPXErrorCode classifyXmlError(xmlErrorPtr error){
+  if(error->code == XML_ERR_NO_MEMORY){
+    return GPX_ERROR_MEMORY;
+  }
+
+  switch(error->domain){
+    case XML_FROM_IO:
+      return GPX_ERROR_IO;
+    case XML_FROM_SCHEMASP:
+      return GPX_ERROR_SCHEMA;
+    case XML_FROM_SCHEMASV:
+      return GPX_ERROR_INVALID;
+    default:
+      return GPX_ERROR_XML;
+  }
+}
+
+// Passes a libxml2 message on to whoever would have seen it without the context: the handler we replaced, or stderr.
+void printXmlError(GPXParseContext * ctx, xmlErrorPtr error){
+  if(ctx->savedHandler != NULL){
+    ctx->savedHandler(ctx->savedHandlerContext, error);
+  }
+  else if(error->file != NULL){
+    fprintf(stderr, "%s:%d: %s", error->file, error->line, (error->message != NULL) ? error->message : "\n");
+  }
+  else if(error->message != NULL){
+    fprintf(stderr, "%s", error->message);
+  }
+}
+
+// libxml2's structured error handler while a call is running. The first error is kept, since the ones after it are usually
+// consequences of it. A warning is only kept until an error comes along - a missing file, for one, is only reported as a warning.
+void recordXmlError(void * userData, xmlErrorPtr error){
+  GPXParseContext * ctx = (GPXParseContext *) userData;
+
+  if(error == NULL){
+    return;
+  }
+
+  if((ctx->options & GPX_PARSE_QUIET) == 0){
+    printXmlError(ctx, error);
+  }
+
+  bool isWarning = (error->level == XML_ERR_WARNING);
+
+  if(ctx->error != GPX_OK && (ctx->errorIsWarning == false || isWarning == true)){
+    return;
+  }
+
+  ctx->error = classifyXmlError(error);
+  ctx->errorLine = error->line;
+  ctx->errorIsWarning = isWarning;
+  storeGPXParseMessage(ctx, (error->message != NULL) ? error->message : describeGPXError(ctx->error));
+}
+
+double currentSeconds(){
+  struct timespec now;
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+
+  return (double) now.tv_sec + (double) now.tv_nsec / 1e9;
+}
+
+void beginGPXParse(GPXParseContext * ctx){
+  if(ctx == NULL){
+    return;
+  }
+
+  LIBXML_TEST_VERSION
+
+  clearGPXParseError(ctx);
+  ctx->savedHandler = xmlStructuredError;
+  ctx->savedHandlerContext = xmlStructuredErrorContext;
+  xmlSetStructuredErrorFunc(ctx, recordXmlError);
+  ctx->startTime = currentSeconds();
+}
+
+bool finishGPXCall(GPXParseContext * ctx, bool succeeded, GPXErrorCode failure){
+  if(ctx == NULL){
+    return succeeded;
+  }
+
+  xmlSetStructuredErrorFunc(ctx->savedHandlerContext, ctx->savedHandler);
+  ctx->savedHandler = NULL;
+  ctx->savedHandlerContext = NULL;
+
+  ctx->stats.seconds += currentSeconds() - ctx->startTime;
+  ctx->stats.numCalls++;
+
+  if(succeeded == true){
+    clearGPXParseError(ctx); // Warnings along the way don't count against a call that worked.
+  }
+  else{
+    ctx->stats.numFailures++;
+
+    if(ctx->error == GPX_OK){
+      setGPXParseError(ctx, failure, NULL);
+    }
+  }
+
+  return succeeded;
+}
+
+void countGPXdoc(GPXParseStats * stats, GPXdoc * gpx){
+  ListIterator routes = createIterator(gpx->routes);
+  ListIterator tracks = createIterator(gpx->tracks);
+  void * element;
+
+  stats->numWaypoints += getLength(gpx->waypoints);
+  stats->numRoutes += getLength(gpx->routes);
+  stats->numTracks += getLength(gpx->tracks);
+
+  while((element = nextElement(&routes)) != NULL){
+    stats->numRoutePoints += getLength(((Route *) element)->waypoints);
+  }
+
+  while((element = nextElement(&tracks)) != NULL){
+    ListIterator segments = createIterator(((Track *) element)->segments);
+    void * segment;
+
+    while((segment = nextElement(&segments)) != NULL){
+      stats->numTrackPoints += getLength(((TrackSegment *) segment)->waypoints);
+    }
+  }
+}
+
+GPXdoc * finishGPXParse(GPXParseContext * ctx, GPXdoc * gpx){
+  // Counting once here is simpler than keeping count in each of the ways a document can be built.
+  updateGPXdocCounts(gpx);
+
+  if(gpx != NULL && ctx != NULL && (ctx->options & GPX_PARSE_CONTIGUOUS) != 0){
+    packGPXdocPoints(gpx); // If memory runs out, the points just stay where they are.
+  }
+
+  if(finishGPXCall(ctx, gpx != NULL, GPX_ERROR_GPX) == true && ctx != NULL){
+    countGPXdoc(&ctx->stats, gpx);
+  }
+
+  return gpx;
+}
+
+void addGPXParseStats(GPXParseStats * total, const GPXParseStats * stats){
+  total->numCalls += stats->numCalls;
+  total->numFailures += stats->numFailures;
+  total->numFallbacks += stats->numFallbacks;
+  total->numWaypoints += stats->numWaypoints;
+  total->numRoutes += stats->numRoutes;
+  total->numRoutePoints += stats->numRoutePoints;
+  total->numTracks += stats->numTracks;
+  total->numTrackPoints += stats->numTrackPoints;
+  total->seconds += stats->seconds;
+}
+
+/* *****************************************************************************PUBLIC API****************************************************************************** */
+
+GPXParseContext * createGPXParseContext(unsigned int options, const GPXAllocator * allocator){
+  if(allocator == NULL){
+    allocator = &defaultAllocator;
+  }
+
+  if(allocator->allocate == NULL || allocator->reallocate == NULL || allocator->release == NULL){
+    return NULL;
+  }
+
+  GPXParseContext * ctx = (GPXParseContext *) allocator->allocate(sizeof(GPXParseContext), allocator->userData);
+
+  if(ctx == NULL){
+    return NULL;
+  }
+
+  memset(ctx, 0, sizeof(GPXParseContext));
+  ctx->options = options;
+  ctx->allocator = *allocator;
+  clearGPXParseError(ctx);
+
+  return ctx;
+}
+
+void deleteGPXParseContext(GPXParseContext * ctx){
+  if(ctx != NULL){
+    GPXAllocator allocator = ctx->allocator;
+
+    allocator.release(ctx, allocator.userData);
+  }
+}
+
+GPXErrorCode getGPXParseError(const GPXParseContext * ctx){
+  return (ctx == NULL) ? GPX_OK : ctx->error;
+}
+
+const char * getGPXParseErrorMessage(const GPXParseContext * ctx){
+  return (ctx == NULL) ? "" : ctx->errorMessage;
+}
+
+int getGPXParseErrorLine(const GPXParseContext * ctx){
+  return (ctx == NULL) ? 0 : ctx->errorLine;
+}
+
+GPXParseStats getGPXParseStats(const GPXParseContext * ctx){
+  GPXParseStats stats;
+
+  if(ctx == NULL){
+    memset(&stats, 0, sizeof(GPXParseStats));
+    return stats;
+  }
+
+  return ctx->stats;
+}
+
+void resetGPXParseStats(GPXParseContext * ctx){
+  if(ctx != NULL){
+    memset(&ctx->stats, 0, sizeof(GPXParseStats));
+  }
+}
+
+unsigned int getGPXParseOptions(const GPXParseContext * ctx){
+  return (ctx == NULL) ? GPX_PARSE_DEFAULT : ctx->options;
+}
+
+void setGPXParseOptions(GPXParseContext * ctx, unsigned int options){
+  if(ctx != NULL){
+    ctx->options = options;
+  }
+}
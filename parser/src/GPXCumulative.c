@@ -0,0 +1,243 @@
+/* Filename: GPXCumulative.c
+ * Description: Cumulative distances along a route, a track segment or a whole track. Building one walks the waypoint lists
+ *              once, copying the coordinates into arrays, and runs the batched haversine over them (see GPXDistance.c), keeping
+ *              every running total rather than just the last one. After that the distance between two points is a
+ *              subtraction, and the position at a distance is a binary search over the totals and an interpolation within
+ *              one hop.
+ */
+
+#include "GPXHelpers.h"
+
+#define FULL_CIRCLE_DEGREES (2 * HALF_CIRCLE_DEGREES)
+
+GPXCumulativeDistances * createCumulativeDistances(int numPoints, int numSegments){
+  GPXCumulativeDistances * distances = (GPXCumulativeDistances *) calloc(1, sizeof(GPXCumulativeDistances));
+
+  if(distances == NULL){
+    return NULL;
+  }
+
+  // One extra element each, so that nothing asks malloc for 0 bytes.
+  distances->latitude = (double *) malloc(sizeof(double) * (numPoints + 1));
+  distances->longitude = (double *) malloc(sizeof(double) * (numPoints + 1));
+  distances->distance = (double *) malloc(sizeof(double) * (numPoints + 1));
+  distances->segmentStarts = (int *) malloc(sizeof(int) * (numSegments + 1));
+
+  if(distances->latitude == NULL || distances->longitude == NULL || distances->distance == NULL ||
+     distances->segmentStarts == NULL){
+    deleteCumulativeDistances(distances);
+    return NULL;
+  }
+
+  return distances;
+}
+
+// Appends the coordinates of a list of waypoints as one segment. The distances are filled in afterwards, all at once.
+void addCumulativeSegment(GPXCumulativeDistances * distances, List * waypoints){
+  ListIterator iterator = createIterator(waypoints);
+  Waypoint * waypoint;
+
+  distances->segmentStarts[distances->numSegments++] = distances->length;
+
+  while((waypoint = (Waypoint *) nextElement(&iterator)) != NULL){
+    distances->latitude[distances->length] = waypoint->latitude;
+    distances->longitude[distances->length] = waypoint->longitude;
+    distances->length++;
+  }
+}
+
+GPXCumulativeDistances * waypointsToCumulativeDistances(List * waypoints){
+  GPXCumulativeDistances * distances = createCumulativeDistances(getLength(waypoints), 1);
+
+  if(distances == NULL){
+    return NULL;
+  }
+
+  addCumulativeSegment(distances, waypoints);
+  cumulativeHopDistances(distances->latitude, distances->longitude, distances->length, distances->distance);
+
+  return distances;
+}
+
+// The position distance metres along the path, given that it is between point index and the next one.
+void interpolatePosition(const GPXCumulativeDistances * distances, int index, double distance, double * latitude,
+                         double * longitude){
+  int next = index + 1;
+
+  if(next == distances->length || distances->distance[next] == distances->distance[index]){
+    *latitude = distances->latitude[index];
+    *longitude = distances->longitude[index];
+    return;
+  }
+
+  double fraction = (distance - distances->distance[index]) / (distances->distance[next] - distances->distance[index]);
+  // The short way round, so that a hop across the antimeridian isn't interpolated the long way.
+  double longitudeChange = remainder(distances->longitude[next] - distances->longitude[index], FULL_CIRCLE_DEGREES);
+
+  *latitude = distances->latitude[index] + fraction * (distances->latitude[next] - distances->latitude[index]);
+  *longitude = remainder(distances->longitude[index] + fraction * longitudeChange, FULL_CIRCLE_DEGREES);
+}
+
+/* ***************************************************************************PUBLIC API************************************************************************************* */
+
+GPXCumulativeDistances * routeToCumulativeDistances(const Route * rt){
+  return (rt == NULL) ? NULL : waypointsToCumulativeDistances(rt->waypoints);
+}
+
+GPXCumulativeDistances * segmentToCumulativeDistances(const TrackSegment * seg){
+  return (seg == NULL) ? NULL : waypointsToCumulativeDistances(seg->waypoints);
+}
+
+GPXCumulativeDistances * trackToCumulativeDistances(const Track * tr){
+  if(tr == NULL){
+    return NULL;
+  }
+
+  int numPoints = 0;
+  ListIterator iterator = createIterator(tr->segments);
+  TrackSegment * segment;
+
+  while((segment = (TrackSegment *) nextElement(&iterator)) != NULL){
+    numPoints += getLength(segment->waypoints);
+  }
+
+  GPXCumulativeDistances * distances = createCumulativeDistances(numPoints, getLength(tr->segments));
+
+  if(distances == NULL){
+    return NULL;
+  }
+
+  iterator = createIterator(tr->segments);
+
+  while((segment = (TrackSegment *) nextElement(&iterator)) != NULL){
+    addCumulativeSegment(distances, segment->waypoints);
+  }
+
+  // The segments are one path, as in getTrackLen.
+  cumulativeHopDistances(distances->latitude, distances->longitude, distances->length, distances->distance);
+
+  return distances;
+}
+
+void deleteCumulativeDistances(GPXCumulativeDistances * distances){
+  if(distances == NULL){
+    return;
+  }
+
+  free(distances->latitude);
+  free(distances->longitude);
+  free(distances->distance);
+  free(distances->segmentStarts);
+  free(distances);
+}
+
+double getDistanceBetweenPoints(const GPXCumulativeDistances * distances, int from, int to){
+  if(distances == NULL || from < 0 || to < 0 || from >= distances->length || to >= distances->length){
+    return -1;
+  }
+
+  return fabs(distances->distance[to] - distances->distance[from]);
+}
+
+int getPositionAtDistance(const GPXCumulativeDistances * distances, double distance, double * latitude, double * longitude){
+  // Also -1 for NAN, which fails both comparisons.
+  if(distances == NULL || distances->length == 0 ||
+     !(distance >= 0 && distance <= distances->distance[distances->length - 1])){
+    return -1;
+  }
+
+  // The last point at or before the distance. distance[0] is 0, so there is always one.
+  int low = 0;
+  int high = distances->length - 1;
+
+  while(low < high){
+    int middle = low + (high - low + 1) / 2;
+
+    if(distances->distance[middle] <= distance){
+      low = middle;
+    }
+    else{
+      high = middle - 1;
+    }
+  }
+
+  double interpolatedLatitude, interpolatedLongitude;
+
+  interpolatePosition(distances, low, distance, &interpolatedLatitude, &interpolatedLongitude);
+
+  if(latitude != NULL){
+    *latitude = interpolatedLatitude;
+  }
+
+  if(longitude != NULL){
+    *longitude = interpolatedLongitude;
+  }
+
+  return low;
+}
+
+bool splitCumulativeDistances(const GPXCumulativeDistances * distances, double distance, GPXCumulativeDistances ** before,
+                              GPXCumulativeDistances ** after){
+  double latitude, longitude;
+  int index = getPositionAtDistance(distances, distance, &latitude, &longitude);
+
+  if(index == -1 || before == NULL || after == NULL){
+    return false;
+  }
+
+  // A split exactly on a point doesn't add one: the point ends the first part and starts the second.
+  bool onPoint = (distances->distance[index] == distance);
+  int beforeSegments = 0;
+
+  while(beforeSegments < distances->numSegments && distances->segmentStarts[beforeSegments] <= index){
+    beforeSegments++;
+  }
+
+  GPXCumulativeDistances * first = createCumulativeDistances(index + 1 + (onPoint ? 0 : 1), beforeSegments);
+  GPXCumulativeDistances * second = createCumulativeDistances(distances->length - index, distances->numSegments - beforeSegments + 1);
+
+  if(first == NULL || second == NULL){
+    deleteCumulativeDistances(first);
+    deleteCumulativeDistances(second);
+    return false;
+  }
+
+  // Points 0 to index, then the split.
+  first->length = index + 1;
+  memcpy(first->latitude, distances->latitude, sizeof(double) * first->length);
+  memcpy(first->longitude, distances->longitude, sizeof(double) * first->length);
+  memcpy(first->distance, distances->distance, sizeof(double) * first->length);
+
+  if(onPoint == false){
+    first->latitude[first->length] = latitude;
+    first->longitude[first->length] = longitude;
+    first->distance[first->length] = distance;
+    first->length++;
+  }
+
+  first->numSegments = beforeSegments;
+  memcpy(first->segmentStarts, distances->segmentStarts, sizeof(int) * beforeSegments);
+
+  // The split, then the points after index. Point k of the path is point k - index of the second part.
+  second->length = distances->length - index;
+  second->latitude[0] = latitude;
+  second->longitude[0] = longitude;
+  second->distance[0] = 0.0;
+
+  for(int k = index + 1; k < distances->length; k++){
+    second->latitude[k - index] = distances->latitude[k];
+    second->longitude[k - index] = distances->longitude[k];
+    second->distance[k - index] = distances->distance[k] - distance;
+  }
+
+  second->segmentStarts[second->numSegments++] = 0;
+
+  for(int s = beforeSegments; s < distances->numSegments; s++){
+    second->segmentStarts[second->numSegments++] = distances->segmentStarts[s] - index;
+  }
+
+  *before = first;
+  *after = second;
+
+  return true;
+}
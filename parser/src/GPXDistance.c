@@ -0,0 +1,572 @@
+/* Filename: GPXDistance.c
+ * Description: Batched distances for the length functions, under each GPXDistanceModel. getRouteLen, getTrackLen and
+ *              getPointColumnsLen gather their points into arrays of doubles, work out the hops between them here a batch
+ *              at a time and add them up with Kahan summation. Haversine hops go four at a time with AVX2 when the CPU
+ *              has it and one at a time otherwise. Three things make this cheaper than a computeDistanceBetweenWaypoints call
+ *              per hop:
+ *                - each point's cos(latitude) is worked out once, not once as each end of its two hops
+ *                - sin and cos are Taylor polynomials on [0, pi/4], and asin one on [0, 1/16], instead of libm calls
+ *                - the polynomials run on four hops at once
+ *              Both paths do exactly the same double operations, with no fused multiply-adds, so they give bit-for-bit the same
+ *              distances, and each hop goes to the same one of the Kahan sums however the points were split into batches, so
+ *              the total doesn't depend on either. Anything outside the polynomials' ranges - a latitude beyond +-90 degrees,
+ *              a longitude difference over 360, a hop longer than about 800 km, NaN - is left to libm.
+ *
+ *              Error bound: the polynomials are truncated where the next term is below 1e-16 of the result, and each hop comes
+ *              out within about 1e-13, in relative terms, of the exact haversine of its double coordinates, and a length within
+ *              1e-12. The equirectangular and Vincenty models are plain scalar code, and are described with GPXDistanceModel.
+ */
+
+#include "GPXHelpers.h"
+#include <immintrin.h>
+
+#define EARTH_MEAN_RADIUS 6371e3
+#define DEGREES_TO_RADIANS (M_PI / HALF_CIRCLE_DEGREES)
+#define DISTANCE_LANES 4
+
+// The WGS-84 ellipsoid, for Vincenty's formula: the equatorial radius, the flattening and the polar radius.
+#define WGS84_A 6378137.0
+#define WGS84_F (1 / 298.257223563)
+#define WGS84_B (WGS84_A * (1 - WGS84_F))
+#define VINCENTY_MAX_ITERATIONS 200
+#define VINCENTY_TOLERANCE 1e-12
+
+// pi/2 and pi split into a double and the remainder, so that pi/2 - a and pi - a are exact to well below a double's precision.
+#define PIO2_HI 1.57079632679489655800e+00
+#define PIO2_LO 6.12323399573676603587e-17
+#define PI_HI 3.14159265358979311600e+00
+#define PI_LO 1.22464679914735317723e-16
+#define PIO4 7.85398163397448278999e-01
+
+// asin's polynomial is used up to here. sqrt of the haversine is 1/16 for a hop of about 800 km.
+#define ASIN_POLY_LIMIT 0.0625
+
+// Taylor coefficients: sin(r) = r + r^3 (S1 + r^2 (S2 + ...)), cos(r) = 1 + r^2 (C1 + r^2 (C2 + ...)) and
+// asin(x) = x + x^3 (A1 + x^2 (A2 + ...)).
+#define S1 (-1.0 / 6)
+#define S2 (1.0 / 120)
+#define S3 (-1.0 / 5040)
+#define S4 (1.0 / 362880)
+#define S5 (-1.0 / 39916800)
+#define S6 (1.0 / 6227020800)
+#define S7 (-1.0 / 1307674368000)
+#define C1 (-1.0 / 2)
+#define C2 (1.0 / 24)
+#define C3 (-1.0 / 720)
+#define C4 (1.0 / 40320)
+#define C5 (-1.0 / 3628800)
+#define C6 (1.0 / 479001600)
+#define C7 (-1.0 / 87178291200)
+#define C8 (1.0 / 20922789888000)
+#define A1 (1.0 / 6)
+#define A2 (3.0 / 40)
+#define A3 (5.0 / 112)
+#define A4 (35.0 / 1152)
+#define A5 (63.0 / 2816)
+#define A6 (231.0 / 13312)
+#define A7 (143.0 / 10240)
+
+/* Scalar */
+
+double sinPoly(double r){
+  double z = r * r;
+
+  return r + r * z * (S1 + z * (S2 + z * (S3 + z * (S4 + z * (S5 + z * (S6 + z * S7))))));
+}
+
+double cosPoly(double r){
+  double z = r * r;
+
+  return 1.0 + z * (C1 + z * (C2 + z * (C3 + z * (C4 + z * (C5 + z * (C6 + z * (C7 + z * C8)))))));
+}
+
+// sin(a) for a in [0, pi/2]: past pi/4, it is cos(pi/2 - a).
+double sinQuadrant(double a){
+  return (a > PIO4) ? cosPoly((PIO2_HI - a) + PIO2_LO) : sinPoly(a);
+}
+
+double cosLatitude(double latitude){
+  double radians = latitude * DEGREES_TO_RADIANS;
+  double a = fabs(radians);
+
+  if(!(a <= PIO2_HI)){
+    return cos(radians);
+  }
+
+  return (a > PIO4) ? sinPoly((PIO2_HI - a) + PIO2_LO) : cosPoly(a);
+}
+
+// sin^2 of half a difference in degrees. sin^2 is symmetric about pi/2, so (pi/2, pi] is reflected onto [0, pi/2).
+double halfSinSquared(double difference){
+  double half = difference * DEGREES_TO_RADIANS * 0.5;
+  double a = fabs(half);
+
+  if(!(a <= PI_HI)){
+    double s = sin(half);
+
+    return s * s;
+  }
+
+  a = (a > PIO2_HI) ? (PI_HI - a) + PI_LO : a;
+
+  double s = sinQuadrant(a);
+
+  return s * s;
+}
+
+double hopDistance(double latitude1, double longitude1, double cos1, double latitude2, double longitude2, double cos2){
+  double h = halfSinSquared(latitude2 - latitude1) + cos1 * cos2 * halfSinSquared(longitude2 - longitude1);
+  double x = sqrt((h > 1.0) ? 1.0 : h);
+
+  if(!(x <= ASIN_POLY_LIMIT)){
+    return EARTH_MEAN_RADIUS * (2.0 * asin(x));
+  }
+
+  double z = x * x;
+  double c = x + x * z * (A1 + z * (A2 + z * (A3 + z * (A4 + z * (A5 + z * (A6 + z * A7))))));
+
+  return EARTH_MEAN_RADIUS * (2.0 * c);
+}
+
+// Writes the distance of the hop ending at each point after the first to hops[i - 1].
+void haversineHopsScalar(const double * latitude, const double * longitude, const double * cosines, int length, double * hops){
+  for(int i = 1; i < length; i++){
+    hops[i - 1] = hopDistance(latitude[i - 1], longitude[i - 1], cosines[i - 1], latitude[i], longitude[i], cosines[i]);
+  }
+}
+
+/* Other models */
+
+// Flat earth around the hop: the longitude difference is scaled by the mean of the two cosines, which is cos of the mean
+// latitude to within a few parts in 1e9 for hops of up to a kilometre. Longitude differences are taken the short way round.
+double equirectangularHop(double latitude1, double longitude1, double cos1, double latitude2, double longitude2, double cos2){
+  double x = longitude2 - longitude1;
+  double y = latitude2 - latitude1;
+
+  if(x > HALF_CIRCLE_DEGREES){
+    x -= 2 * HALF_CIRCLE_DEGREES;
+  }
+  else if(x < -HALF_CIRCLE_DEGREES){
+    x += 2 * HALF_CIRCLE_DEGREES;
+  }
+
+  x *= 0.5 * (cos1 + cos2);
+
+  return EARTH_MEAN_RADIUS * DEGREES_TO_RADIANS * sqrt(x * x + y * y);
+}
+
+// Vincenty's inverse formula on the WGS-84 ellipsoid. It doesn't converge for nearly antipodal points, which get the
+// haversine distance instead.
+double vincentyHop(double latitude1, double longitude1, double latitude2, double longitude2){
+  const double L = remainder(longitude2 - longitude1, 2 * HALF_CIRCLE_DEGREES) * DEGREES_TO_RADIANS;
+  const double U1 = atan((1 - WGS84_F) * tan(latitude1 * DEGREES_TO_RADIANS));
+  const double U2 = atan((1 - WGS84_F) * tan(latitude2 * DEGREES_TO_RADIANS));
+  const double sinU1 = sin(U1), cosU1 = cos(U1);
+  const double sinU2 = sin(U2), cosU2 = cos(U2);
+  double lambda = L;
+
+  for(int iteration = 0; iteration < VINCENTY_MAX_ITERATIONS; iteration++){
+    const double sinLambda = sin(lambda), cosLambda = cos(lambda);
+    const double sinSigma = hypot(cosU2 * sinLambda, cosU1 * sinU2 - sinU1 * cosU2 * cosLambda);
+
+    if(sinSigma == 0){
+      return 0; // The same point
+    }
+
+    const double cosSigma = sinU1 * sinU2 + cosU1 * cosU2 * cosLambda;
+    const double sigma = atan2(sinSigma, cosSigma);
+    const double sinAlpha = cosU1 * cosU2 * sinLambda / sinSigma;
+    const double cosSqAlpha = 1 - sinAlpha * sinAlpha;
+    // On the equator cosSqAlpha is 0, and the term it divides drops out.
+    const double cos2SigmaM = (cosSqAlpha != 0) ? cosSigma - 2 * sinU1 * sinU2 / cosSqAlpha : 0;
+    const double C = WGS84_F / 16 * cosSqAlpha * (4 + WGS84_F * (4 - 3 * cosSqAlpha));
+    const double previous = lambda;
+
+    lambda = L + (1 - C) * WGS84_F * sinAlpha *
+             (sigma + C * sinSigma * (cos2SigmaM + C * cosSigma * (-1 + 2 * cos2SigmaM * cos2SigmaM)));
+
+    if(fabs(lambda - previous) <= VINCENTY_TOLERANCE){
+      const double uSq = cosSqAlpha * (WGS84_A * WGS84_A - WGS84_B * WGS84_B) / (WGS84_B * WGS84_B);
+      const double A = 1 + uSq / 16384 * (4096 + uSq * (-768 + uSq * (320 - 175 * uSq)));
+      const double B = uSq / 1024 * (256 + uSq * (-128 + uSq * (74 - 47 * uSq)));
+      const double deltaSigma = B * sinSigma * (cos2SigmaM + B / 4 * (cosSigma * (-1 + 2 * cos2SigmaM * cos2SigmaM) -
+                                B / 6 * cos2SigmaM * (-3 + 4 * sinSigma * sinSigma) * (-3 + 4 * cos2SigmaM * cos2SigmaM)));
+
+      return WGS84_B * A * (sigma - deltaSigma);
+    }
+  }
+
+  return hopDistance(latitude1, longitude1, cosLatitude(latitude1), latitude2, longitude2, cosLatitude(latitude2));
+}
+
+/* AVX2 - each function is its scalar namesake on four lanes, with the branches turned into blends. Lanes a blend can't
+ * cover (the libm cases) are flagged in *slow and redone by the scalar code.
+ */
+
+__attribute__((target("avx2")))
+__m256d sinPolyAVX2(__m256d r){
+  __m256d z = _mm256_mul_pd(r, r);
+  __m256d p = _mm256_set1_pd(S7);
+
+  p = _mm256_add_pd(_mm256_set1_pd(S6), _mm256_mul_pd(z, p));
+  p = _mm256_add_pd(_mm256_set1_pd(S5), _mm256_mul_pd(z, p));
+  p = _mm256_add_pd(_mm256_set1_pd(S4), _mm256_mul_pd(z, p));
+  p = _mm256_add_pd(_mm256_set1_pd(S3), _mm256_mul_pd(z, p));
+  p = _mm256_add_pd(_mm256_set1_pd(S2), _mm256_mul_pd(z, p));
+  p = _mm256_add_pd(_mm256_set1_pd(S1), _mm256_mul_pd(z, p));
+
+  return _mm256_add_pd(r, _mm256_mul_pd(_mm256_mul_pd(r, z), p));
+}
+
+__attribute__((target("avx2")))
+__m256d cosPolyAVX2(__m256d r){
+  __m256d z = _mm256_mul_pd(r, r);
+  __m256d p = _mm256_set1_pd(C8);
+
+  p = _mm256_add_pd(_mm256_set1_pd(C7), _mm256_mul_pd(z, p));
+  p = _mm256_add_pd(_mm256_set1_pd(C6), _mm256_mul_pd(z, p));
+  p = _mm256_add_pd(_mm256_set1_pd(C5), _mm256_mul_pd(z, p));
+  p = _mm256_add_pd(_mm256_set1_pd(C4), _mm256_mul_pd(z, p));
+  p = _mm256_add_pd(_mm256_set1_pd(C3), _mm256_mul_pd(z, p));
+  p = _mm256_add_pd(_mm256_set1_pd(C2), _mm256_mul_pd(z, p));
+  p = _mm256_add_pd(_mm256_set1_pd(C1), _mm256_mul_pd(z, p));
+
+  return _mm256_add_pd(_mm256_set1_pd(1.0), _mm256_mul_pd(z, p));
+}
+
+__attribute__((target("avx2")))
+__m256d absAVX2(__m256d x){
+  return _mm256_andnot_pd(_mm256_set1_pd(-0.0), x);
+}
+
+// (hi - a) + lo, the complement of a in [0, hi].
+__attribute__((target("avx2")))
+__m256d complementAVX2(double hi, double lo, __m256d a){
+  return _mm256_add_pd(_mm256_sub_pd(_mm256_set1_pd(hi), a), _mm256_set1_pd(lo));
+}
+
+// sinPoly(a) in the lanes where useCos is clear and cosPoly((pi/2 - a)) where it is set. Points close together are nearly always
+// on the same side of pi/4, so usually only one of the polynomials is needed.
+__attribute__((target("avx2")))
+__m256d sinOrCosPolyAVX2(__m256d a, __m256d useCos){
+  int lanes = _mm256_movemask_pd(useCos);
+
+  if(lanes == 0){
+    return sinPolyAVX2(a);
+  }
+
+  __m256d cosine = cosPolyAVX2(complementAVX2(PIO2_HI, PIO2_LO, a));
+
+  return (lanes == (1 << DISTANCE_LANES) - 1) ? cosine : _mm256_blendv_pd(sinPolyAVX2(a), cosine, useCos);
+}
+
+__attribute__((target("avx2")))
+__m256d cosLatitudeAVX2(__m256d latitude, __m256d * slow){
+  __m256d a = absAVX2(_mm256_mul_pd(latitude, _mm256_set1_pd(DEGREES_TO_RADIANS)));
+  __m256d high = _mm256_cmp_pd(a, _mm256_set1_pd(PIO4), _CMP_GT_OQ);
+
+  *slow = _mm256_or_pd(*slow, _mm256_cmp_pd(a, _mm256_set1_pd(PIO2_HI), _CMP_NLE_UQ));
+
+  // The same thing the other way round: cos(a) is cosPoly(a) up to pi/4 and sinPoly(pi/2 - a) past it.
+  int lanes = _mm256_movemask_pd(high);
+
+  if(lanes == 0){
+    return cosPolyAVX2(a);
+  }
+
+  __m256d sine = sinPolyAVX2(complementAVX2(PIO2_HI, PIO2_LO, a));
+
+  return (lanes == (1 << DISTANCE_LANES) - 1) ? sine : _mm256_blendv_pd(cosPolyAVX2(a), sine, high);
+}
+
+__attribute__((target("avx2")))
+__m256d halfSinSquaredAVX2(__m256d difference, __m256d * slow){
+  __m256d half = _mm256_mul_pd(_mm256_mul_pd(difference, _mm256_set1_pd(DEGREES_TO_RADIANS)), _mm256_set1_pd(0.5));
+  __m256d a = absAVX2(half);
+
+  *slow = _mm256_or_pd(*slow, _mm256_cmp_pd(a, _mm256_set1_pd(PI_HI), _CMP_NLE_UQ));
+  a = _mm256_blendv_pd(a, complementAVX2(PI_HI, PI_LO, a), _mm256_cmp_pd(a, _mm256_set1_pd(PIO2_HI), _CMP_GT_OQ));
+
+  __m256d s = sinOrCosPolyAVX2(a, _mm256_cmp_pd(a, _mm256_set1_pd(PIO4), _CMP_GT_OQ));
+
+  return _mm256_mul_pd(s, s);
+}
+
+__attribute__((target("avx2")))
+__m256d hopDistanceAVX2(__m256d latitude1, __m256d longitude1, __m256d cos1, __m256d latitude2, __m256d longitude2, __m256d cos2,
+                        __m256d * slow){
+  __m256d h = _mm256_add_pd(halfSinSquaredAVX2(_mm256_sub_pd(latitude2, latitude1), slow),
+                            _mm256_mul_pd(_mm256_mul_pd(cos1, cos2), halfSinSquaredAVX2(_mm256_sub_pd(longitude2, longitude1), slow)));
+  __m256d one = _mm256_set1_pd(1.0);
+  __m256d x = _mm256_sqrt_pd(_mm256_blendv_pd(h, one, _mm256_cmp_pd(h, one, _CMP_GT_OQ)));
+  __m256d z = _mm256_mul_pd(x, x);
+  __m256d p = _mm256_set1_pd(A7);
+
+  *slow = _mm256_or_pd(*slow, _mm256_cmp_pd(x, _mm256_set1_pd(ASIN_POLY_LIMIT), _CMP_NLE_UQ));
+
+  p = _mm256_add_pd(_mm256_set1_pd(A6), _mm256_mul_pd(z, p));
+  p = _mm256_add_pd(_mm256_set1_pd(A5), _mm256_mul_pd(z, p));
+  p = _mm256_add_pd(_mm256_set1_pd(A4), _mm256_mul_pd(z, p));
+  p = _mm256_add_pd(_mm256_set1_pd(A3), _mm256_mul_pd(z, p));
+  p = _mm256_add_pd(_mm256_set1_pd(A2), _mm256_mul_pd(z, p));
+  p = _mm256_add_pd(_mm256_set1_pd(A1), _mm256_mul_pd(z, p));
+
+  __m256d c = _mm256_add_pd(x, _mm256_mul_pd(_mm256_mul_pd(x, z), p));
+
+  return _mm256_mul_pd(_mm256_set1_pd(EARTH_MEAN_RADIUS), _mm256_mul_pd(_mm256_set1_pd(2.0), c));
+}
+
+__attribute__((target("avx2")))
+void cosLatitudesAVX2(const double * latitude, double * cosines, int length){
+  int i = 0;
+
+  for(; i + DISTANCE_LANES <= length; i += DISTANCE_LANES){
+    __m256d slow = _mm256_setzero_pd();
+
+    _mm256_storeu_pd(cosines + i, cosLatitudeAVX2(_mm256_loadu_pd(latitude + i), &slow));
+
+    if(_mm256_movemask_pd(slow) != 0){
+      for(int lane = 0; lane < DISTANCE_LANES; lane++){
+        cosines[i + lane] = cosLatitude(latitude[i + lane]);
+      }
+    }
+  }
+
+  for(; i < length; i++){
+    cosines[i] = cosLatitude(latitude[i]);
+  }
+}
+
+__attribute__((target("avx2")))
+void haversineHopsAVX2(const double * latitude, const double * longitude, const double * cosines, int length, double * hops){
+  int i = 1;
+
+  for(; i + DISTANCE_LANES <= length; i += DISTANCE_LANES){
+    __m256d slow = _mm256_setzero_pd();
+    __m256d distance = hopDistanceAVX2(_mm256_loadu_pd(latitude + i - 1), _mm256_loadu_pd(longitude + i - 1),
+                                       _mm256_loadu_pd(cosines + i - 1), _mm256_loadu_pd(latitude + i),
+                                       _mm256_loadu_pd(longitude + i), _mm256_loadu_pd(cosines + i), &slow);
+    int slowLanes = _mm256_movemask_pd(slow);
+
+    _mm256_storeu_pd(hops + i - 1, distance);
+
+    for(int lane = 0; slowLanes != 0 && lane < DISTANCE_LANES; lane++){
+      int hop = i + lane;
+
+      if((slowLanes & (1 << lane)) != 0){
+        hops[hop - 1] = hopDistance(latitude[hop - 1], longitude[hop - 1], cosines[hop - 1], latitude[hop], longitude[hop],
+                                    cosines[hop]);
+      }
+    }
+  }
+
+  haversineHopsScalar(latitude + i - 1, longitude + i - 1, cosines + i - 1, length - i + 1, hops + i - 1);
+}
+
+/* Batches */
+
+void cosLatitudes(const double * latitude, double * cosines, int length, bool useAVX2){
+  if(useAVX2){
+    cosLatitudesAVX2(latitude, cosines, length);
+    return;
+  }
+
+  for(int i = 0; i < length; i++){
+    cosines[i] = cosLatitude(latitude[i]);
+  }
+}
+
+// Writes the distances of the hops between up to DISTANCE_BATCH points to hops.
+void measureHops(GPXDistanceModel model, const double * latitude, const double * longitude, int length, double * hops,
+                 bool useAVX2){
+  double cosines[DISTANCE_BATCH];
+
+  switch(model){
+    case GPX_DISTANCE_VINCENTY:
+      for(int i = 1; i < length; i++){
+        hops[i - 1] = vincentyHop(latitude[i - 1], longitude[i - 1], latitude[i], longitude[i]);
+      }
+      break;
+    case GPX_DISTANCE_EQUIRECTANGULAR:
+      cosLatitudes(latitude, cosines, length, useAVX2);
+
+      for(int i = 1; i < length; i++){
+        hops[i - 1] = equirectangularHop(latitude[i - 1], longitude[i - 1], cosines[i - 1], latitude[i], longitude[i], cosines[i]);
+      }
+      break;
+    default:
+      cosLatitudes(latitude, cosines, length, useAVX2);
+
+      if(useAVX2){
+        haversineHopsAVX2(latitude, longitude, cosines, length, hops);
+      }
+      else{
+        haversineHopsScalar(latitude, longitude, cosines, length, hops);
+      }
+      break;
+  }
+}
+
+// Kahan summation: compensation holds what the last addition lost to rounding, and is taken off the next distance.
+void kahanAdd(double * total, double * compensation, double distance){
+  double y = distance - *compensation;
+  double t = *total + y;
+
+  *compensation = (t - *total) - y;
+  *total = t;
+}
+
+void initDistanceSum(DistanceSum * sum){
+  for(int lane = 0; lane < SUM_LANES; lane++){
+    sum->total[lane] = 0.0;
+    sum->compensation[lane] = 0.0;
+  }
+
+  sum->lane = 0;
+}
+
+// A single Kahan sum is a chain of four dependent additions per distance, which would take longer than working the distances
+// out, so the distances are dealt round SUM_LANES sums that run side by side. Distance k of a path always goes to lane
+// k % SUM_LANES, however the path is split into batches.
+void addDistances(DistanceSum * sum, const double * distances, int count){
+  double total[SUM_LANES];
+  double compensation[SUM_LANES];
+  int i = 0;
+
+  // The sums are worked on in locals (which the compiler keeps in registers), rotated so that the next distance always goes to
+  // total[0]: local lane j is the sum's lane (sum->lane + j) % SUM_LANES.
+  for(int lane = 0; lane < SUM_LANES; lane++){
+    total[lane] = sum->total[(sum->lane + lane) % SUM_LANES];
+    compensation[lane] = sum->compensation[(sum->lane + lane) % SUM_LANES];
+  }
+
+  for(; i + SUM_LANES <= count; i += SUM_LANES){
+    for(int lane = 0; lane < SUM_LANES; lane++){
+      kahanAdd(&total[lane], &compensation[lane], distances[i + lane]);
+    }
+  }
+
+  for(; i < count; i++){
+    double nextTotal = total[0];
+    double nextCompensation = compensation[0];
+
+    kahanAdd(&nextTotal, &nextCompensation, distances[i]);
+
+    for(int lane = 1; lane < SUM_LANES; lane++){
+      total[lane - 1] = total[lane];
+      compensation[lane - 1] = compensation[lane];
+    }
+
+    total[SUM_LANES - 1] = nextTotal;
+    compensation[SUM_LANES - 1] = nextCompensation;
+    sum->lane = (sum->lane + 1) % SUM_LANES;
+  }
+
+  for(int lane = 0; lane < SUM_LANES; lane++){
+    sum->total[(sum->lane + lane) % SUM_LANES] = total[lane];
+    sum->compensation[(sum->lane + lane) % SUM_LANES] = compensation[lane];
+  }
+}
+
+double distanceSumTotal(const DistanceSum * sum){
+  double total = 0.0;
+  double compensation = 0.0;
+
+  for(int lane = 0; lane < SUM_LANES; lane++){
+    kahanAdd(&total, &compensation, sum->total[lane]);
+    kahanAdd(&total, &compensation, -sum->compensation[lane]);
+  }
+
+  return total;
+}
+
+/* ***************************************************************************DISTANCE API************************************************************************************* */
+
+bool isGPXDistanceModel(GPXDistanceModel model){
+  return model == GPX_DISTANCE_HAVERSINE || model == GPX_DISTANCE_EQUIRECTANGULAR || model == GPX_DISTANCE_VINCENTY;
+}
+
+void sumHopDistances(const double * latitude, const double * longitude, int length, GPXDistanceModel model, DistanceSum * sum){
+  double hops[DISTANCE_BATCH];
+  bool useAVX2 = __builtin_cpu_supports("avx2");
+
+  // A batch at a time, so the scratch arrays fit on the stack. Consecutive batches share a point, for the hop between them.
+  for(int start = 0; start + 1 < length; start += DISTANCE_BATCH - 1){
+    int count = (length - start < DISTANCE_BATCH) ? length - start : DISTANCE_BATCH;
+
+    measureHops(model, latitude + start, longitude + start, count, hops, useAVX2);
+    addDistances(sum, hops, count - 1);
+  }
+}
+
+void cumulativeHopDistances(const double * latitude, const double * longitude, int length, double * cumulative){
+  double hops[DISTANCE_BATCH];
+  bool useAVX2 = __builtin_cpu_supports("avx2");
+  double total = 0.0;
+  double compensation = 0.0;
+
+  if(length > 0){
+    cumulative[0] = 0.0;
+  }
+
+  // Every running total is wanted here, so there is just the one Kahan sum.
+  for(int start = 0; start + 1 < length; start += DISTANCE_BATCH - 1){
+    int count = (length - start < DISTANCE_BATCH) ? length - start : DISTANCE_BATCH;
+
+    measureHops(GPX_DISTANCE_HAVERSINE, latitude + start, longitude + start, count, hops, useAVX2);
+
+    for(int i = 1; i < count; i++){
+      kahanAdd(&total, &compensation, hops[i - 1]);
+      cumulative[start + i] = total;
+    }
+  }
+}
+
+void initPathLength(PathLength * path, GPXDistanceModel model){
+  path->model = model;
+  path->count = 0;
+  initDistanceSum(&path->sum);
+}
+
+void addPathPoint(PathLength * path, double latitude, double longitude){
+  path->latitude[path->count] = latitude;
+  path->longitude[path->count] = longitude;
+  path->count++;
+
+  if(path->count == DISTANCE_BATCH){
+    sumHopDistances(path->latitude, path->longitude, path->count, path->model, &path->sum);
+
+    // The last point starts the next batch.
+    path->latitude[0] = latitude;
+    path->longitude[0] = longitude;
+    path->count = 1;
+  }
+}
+
+double finishPathLength(PathLength * path){
+  sumHopDistances(path->latitude, path->longitude, path->count, path->model, &path->sum);
+
+  return distanceSumTotal(&path->sum);
+}
+
+/* ***************************************************************************PUBLIC API************************************************************************************* */
+
+double getGPXDistance(double latitude1, double longitude1, double latitude2, double longitude2, GPXDistanceModel model){
+  double latitude[2] = { latitude1, latitude2 };
+  double longitude[2] = { longitude1, longitude2 };
+
+  return getPathLen(latitude, longitude, 2, model);
+}
+
+double getPathLen(const double * latitude, const double * longitude, int length, GPXDistanceModel model){
+  if(latitude == NULL || longitude == NULL || isGPXDistanceModel(model) == false){
+    return 0;
+  }
+
+  DistanceSum sum;
+
+  initDistanceSum(&sum);
+  sumHopDistances(latitude, longitude, length, model, &sum);
+
+  return distanceSumTotal(&sum);
+}
@@ -0,0 +1,330 @@
+/* Filename: GPXIndex.c
+ * Description: The name index behind getWaypoint, getRoute and getTrack. The first lookup on a document builds three open
+ *              addressing hash tables, one for each kind of entity, that map a name to the entity those functions would have
+ *              found by scanning - the first one with that name, in document order. After that a lookup is a hash and a
+ *              strcmp or two. The index keeps its own copies of the names, so a name the caller changes or frees is never read.
+ *              addRoute and addWaypoint keep the index up to date. Each route point's entry holds the position of its route,
+ *              so a point added to a route other than the last one, which comes in the middle of the route points in the
+ *              scanning order, can still be put in its place. updateGPXdocCounts drops the index, since the document may
+ *              have changed in any way.
+ *              An index is built without a lock and published with a compare-and-swap, so lookups on different documents never
+ *              wait for each other. If two threads build one for the same document at once, the loser frees its copy.
+ */
+
+#include "GPXHelpers.h"
+
+#define MIN_NAME_TABLE_CAPACITY 16
+#define MIN_NAME_KEY_BLOCK 4096
+#define FNV_OFFSET_BASIS 14695981039346656037ULL
+#define FNV_PRIME 1099511628211ULL
+
+// getWaypoint looks at top-level waypoints, then route points, then track points. Where a name is on more than one, the
+// entry holds the one with the lowest rank. Routes and tracks are all RANK_TOP_LEVEL.
+typedef enum {
+  RANK_TOP_LEVEL = 0,
+  RANK_ROUTE_POINT,
+  RANK_TRACK_POINT
+} NameRank;
+
+typedef struct {
+  const char * name; // The index's copy of the name, or NULL for an empty slot
+  void * entity;
+  NameRank rank;
+  int route; // For a route point, the position of its route in the document's routes
+} NameEntry;
+
+typedef struct {
+  NameEntry * entries;
+  size_t capacity; // Always a power of two
+  size_t count;
+} NameTable;
+
+// The copies of the names are packed into blocks that are only freed with the index.
+typedef struct NameKeyBlock {
+  struct NameKeyBlock * next;
+  size_t used;
+  size_t size;
+  char keys[];
+} NameKeyBlock;
+
+struct GPXNameIndex {
+  NameTable waypoints;
+  NameTable routes;
+  NameTable tracks;
+  NameKeyBlock * keyBlocks;
+  int numRoutes; // The routes indexed so far, which are the document's first numRoutes
+};
+
+// FNV-1a.
+uint64_t hashGPXName(const char * name){
+  uint64_t hash = FNV_OFFSET_BASIS;
+
+  for(const unsigned char * p = (const unsigned char *) name; *p != '\0'; p++){
+    hash = (hash ^ *p) * FNV_PRIME;
+  }
+
+  return hash;
+}
+
+bool initNameTable(NameTable * table, size_t capacity){
+  table->entries = (NameEntry *) calloc(capacity, sizeof(NameEntry));
+  table->capacity = capacity;
+  table->count = 0;
+
+  return table->entries != NULL;
+}
+
+// The slot that holds name, or the empty slot it would go in.
+NameEntry * findNameEntry(const NameTable * table, const char * name){
+  size_t mask = table->capacity - 1;
+  size_t slot = (size_t) hashGPXName(name) & mask;
+
+  while(table->entries[slot].name != NULL && strcmp(table->entries[slot].name, name) != EQUAL_STRINGS){
+    slot = (slot + 1) & mask;
+  }
+
+  return &table->entries[slot];
+}
+
+bool growNameTable(NameTable * table){
+  NameTable grown;
+
+  if(initNameTable(&grown, table->capacity * 2) == false){
+    return false;
+  }
+
+  for(size_t i = 0; i < table->capacity; i++){
+    if(table->entries[i].name != NULL){
+      *findNameEntry(&grown, table->entries[i].name) = table->entries[i];
+    }
+  }
+
+  grown.count = table->count;
+  free(table->entries);
+  *table = grown;
+
+  return true;
+}
+
+const char * copyNameKey(GPXNameIndex * index, const char * name){
+  size_t len = strlen(name) + 1;
+  NameKeyBlock * block = index->keyBlocks;
+
+  if(block == NULL || block->size - block->used < len){
+    size_t size = (len > MIN_NAME_KEY_BLOCK) ? len : MIN_NAME_KEY_BLOCK;
+
+    block = (NameKeyBlock *) malloc(sizeof(NameKeyBlock) + size);
+
+    if(block == NULL){
+      return NULL;
+    }
+
+    block->next = index->keyBlocks;
+    block->used = 0;
+    block->size = size;
+    index->keyBlocks = block;
+  }
+
+  char * key = block->keys + block->used;
+
+  memcpy(key, name, len);
+  block->used += len;
+
+  return key;
+}
+
+// Adds an entity under its name, unless the name already has one that comes first in the scanning order - one of a lower
+// rank, or a route point of the same or an earlier route. Returns false if memory ran out.
+bool indexName(GPXNameIndex * index, NameTable * table, const char * name, void * entity, NameRank rank, int route){
+  // Keep the load factor under a half, so probe runs stay short.
+  if((table->count + 1) * 2 > table->capacity && growNameTable(table) == false){
+    return false;
+  }
+
+  NameEntry * entry = findNameEntry(table, name);
+
+  if(entry->name == NULL){
+    entry->name = copyNameKey(index, name);
+
+    if(entry->name == NULL){
+      return false;
+    }
+
+    entry->entity = entity;
+    entry->rank = rank;
+    entry->route = route;
+    table->count++;
+  }
+  else if(entry->rank > rank || (rank == RANK_ROUTE_POINT && entry->rank == RANK_ROUTE_POINT && entry->route > route)){
+    entry->entity = entity;
+    entry->rank = rank;
+    entry->route = route;
+  }
+
+  return true;
+}
+
+bool indexWaypointList(GPXNameIndex * index, NameTable * table, List * waypoints, NameRank rank, int route){
+  ListIterator iterator = createIterator(waypoints);
+  Waypoint * waypoint;
+
+  while((waypoint = (Waypoint *) nextElement(&iterator)) != NULL){
+    if(indexName(index, table, waypoint->name, waypoint, rank, route) == false){
+      return false;
+    }
+  }
+
+  return true;
+}
+
+// Indexes the route that comes after the ones already indexed.
+bool indexRoute(GPXNameIndex * index, Route * route){
+  int position = index->numRoutes++;
+
+  return indexName(index, &index->routes, route->name, route, RANK_TOP_LEVEL, 0) == true &&
+         indexWaypointList(index, &index->waypoints, route->waypoints, RANK_ROUTE_POINT, position) == true;
+}
+
+// Indexes everything in document order, so that the first entity with each name is the one kept.
+GPXNameIndex * buildGPXNameIndex(const GPXdoc * doc){
+  GPXNameIndex * index = (GPXNameIndex *) calloc(1, sizeof(GPXNameIndex));
+
+  if(index == NULL){
+    return NULL;
+  }
+
+  if(initNameTable(&index->waypoints, MIN_NAME_TABLE_CAPACITY) == false ||
+     initNameTable(&index->routes, MIN_NAME_TABLE_CAPACITY) == false ||
+     initNameTable(&index->tracks, MIN_NAME_TABLE_CAPACITY) == false ||
+     indexWaypointList(index, &index->waypoints, doc->waypoints, RANK_TOP_LEVEL, 0) == false){
+    deleteGPXNameIndex(index);
+    return NULL;
+  }
+
+  ListIterator iterator = createIterator(doc->routes);
+  void * element;
+
+  while((element = nextElement(&iterator)) != NULL){
+    if(indexRoute(index, (Route *) element) == false){
+      deleteGPXNameIndex(index);
+      return NULL;
+    }
+  }
+
+  iterator = createIterator(doc->tracks);
+
+  while((element = nextElement(&iterator)) != NULL){
+    Track * track = (Track *) element;
+    ListIterator segments = createIterator(track->segments);
+    void * segment;
+
+    if(indexName(index, &index->tracks, track->name, track, RANK_TOP_LEVEL, 0) == false){
+      deleteGPXNameIndex(index);
+      return NULL;
+    }
+
+    while((segment = nextElement(&segments)) != NULL){
+      if(indexWaypointList(index, &index->waypoints, ((TrackSegment *) segment)->waypoints, RANK_TRACK_POINT, 0) == false){
+        deleteGPXNameIndex(index);
+        return NULL;
+      }
+    }
+  }
+
+  return index;
+}
+
+/* ***************************************************************************INDEX API************************************************************************************* */
+
+void deleteGPXNameIndex(GPXNameIndex * index){
+  if(index == NULL){
+    return;
+  }
+
+  free(index->waypoints.entries);
+  free(index->routes.entries);
+  free(index->tracks.entries);
+
+  while(index->keyBlocks != NULL){
+    NameKeyBlock * next = index->keyBlocks->next;
+    free(index->keyBlocks);
+    index->keyBlocks = next;
+  }
+
+  free(index);
+}
+
+GPXNameIndex * gpxNameIndex(const GPXdoc * doc){
+  GPXNameIndex * index = __atomic_load_n(&doc->nameIndex, __ATOMIC_ACQUIRE);
+
+  if(index != NULL){
+    return index;
+  }
+
+  GPXNameIndex * built = buildGPXNameIndex(doc);
+
+  if(built == NULL){
+    return NULL;
+  }
+
+  // The index isn't part of what the document holds, so publishing it doesn't count as modifying the document.
+  if(__atomic_compare_exchange_n(&((GPXdoc *) doc)->nameIndex, &index, built, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE) == false){
+    deleteGPXNameIndex(built); // Another thread got there first, and index is now its index.
+    return index;
+  }
+
+  return built;
+}
+
+void dropGPXNameIndex(GPXdoc * doc){
+  deleteGPXNameIndex(doc->nameIndex);
+  doc->nameIndex = NULL;
+}
+
+Waypoint * findIndexedWaypoint(const GPXNameIndex * index, const char * name){
+  return (Waypoint *) findNameEntry(&index->waypoints, name)->entity;
+}
+
+Route * findIndexedRoute(const GPXNameIndex * index, const char * name){
+  return (Route *) findNameEntry(&index->routes, name)->entity;
+}
+
+Track * findIndexedTrack(const GPXNameIndex * index, const char * name){
+  return (Track *) findNameEntry(&index->tracks, name)->entity;
+}
+
+void indexAddedRoute(GPXdoc * doc, Route * route){
+  if(doc->nameIndex != NULL && indexRoute(doc->nameIndex, route) == false){
+    dropGPXNameIndex(doc);
+  }
+}
+
+void indexAddedWaypoint(GPXdoc * doc, Route * route, Waypoint * waypoint){
+  if(doc->nameIndex == NULL){
+    return;
+  }
+
+  GPXNameIndex * index = doc->nameIndex;
+  int position = index->numRoutes - 1;
+
+  // The point comes after the others of its route, so all it needs is the route's position.
+  if(getFromBack(doc->routes) != route){
+    ListIterator iterator = createIterator(doc->routes);
+    void * element;
+
+    position = 0;
+
+    while((element = nextElement(&iterator)) != NULL && element != route){
+      position++;
+    }
+
+    if(element == NULL){ // Taken out of the routes without updateGPXdocCounts being called
+      dropGPXNameIndex(doc);
+      return;
+    }
+  }
+
+  if(indexName(index, &index->waypoints, waypoint->name, waypoint, RANK_ROUTE_POINT, position) == false){
+    dropGPXNameIndex(doc);
+  }
+}
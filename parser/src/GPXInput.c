@@ -0,0 +1,234 @@
+/* Filename: GPXInput.c
+ * Description: Entry points that read GPX content from somewhere other than a plain xmlReadFile, e.g. an upload that is already
+ *              in memory or a memory-mapped file. They all funnel into the same builders as createGPXdoc (buildGPXdocFromXml) and
+ *              createGPXdocStreaming (buildObjectsFromReader), so the resulting GPXdoc is identical.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "GPXHelpers.h"
+#include <limits.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// libxml2 takes buffer sizes as an int, so anything bigger can't be handed over in one piece.
+bool isValidMemoryInput(const char * buffer, size_t length){
+  return buffer != NULL && length > 0 && length <= INT_MAX;
+}
+
+GPXdoc * createGPXdocFromMemoryCtx(GPXParseContext * ctx, const char * buffer, size_t length){
+  beginGPXParse(ctx);
+
+  if(isValidMemoryInput(buffer, length) == false){
+    setGPXParseError(ctx, GPX_ERROR_ARGUMENT, NULL);
+    return finishGPXParse(ctx, NULL);
+  }
+
+  LIBXML_TEST_VERSION
+
+  xmlDoc * doc = xmlReadMemory(buffer, (int) length, NULL, NULL, contextXmlOptions(ctx));
+
+  if(doc == NULL){
+    return finishGPXParse(ctx, NULL);
+  }
+
+  GPXdoc * gpx = buildGPXdocFromXml(ctx, xmlDocGetRootElement(doc));
+
+  xmlFreeDoc(doc);
+
+  return finishGPXParse(ctx, gpx);
+}
+
+GPXdoc * createGPXdocFromMemory(const char * buffer, size_t length){
+  return createGPXdocFromMemoryCtx(NULL, buffer, length);
+}
+
+// Parses the buffer and validates the tree against schema. The tree we just validated is the one we build from - the content
+// is only parsed once.
+GPXdoc * buildValidGPXdocFromMemory(GPXParseContext * ctx, const char * buffer, size_t length, const GPXSchema * schema){
+  LIBXML_TEST_VERSION
+
+  xmlDoc * doc = xmlReadMemory(buffer, (int) length, NULL, NULL, contextXmlOptions(ctx));
+
+  if(doc == NULL){
+    return NULL;
+  }
+
+  GPXdoc * gpx = NULL;
+
+  if(validateXmlDocWithSchema(ctx, doc, schema) == true){
+    gpx = buildGPXdocFromXml(ctx, xmlDocGetRootElement(doc));
+  }
+
+  xmlFreeDoc(doc);
+
+  return gpx;
+}
+
+GPXdoc * createValidGPXdocFromMemoryCtx(GPXParseContext * ctx, const char * buffer, size_t length, char * gpxSchemaFile){
+  beginGPXParse(ctx);
+
+  if(isValidMemoryInput(buffer, length) == false || gpxSchemaFile == NULL || strcmp(gpxSchemaFile, "\0") == EQUAL_STRINGS){
+    setGPXParseError(ctx, GPX_ERROR_ARGUMENT, NULL);
+    return finishGPXParse(ctx, NULL);
+  }
+
+  GPXSchema * schema = loadGPXSchema(ctx, gpxSchemaFile);
+
+  if(schema == NULL){
+    return finishGPXParse(ctx, NULL);
+  }
+
+  GPXdoc * gpx = buildValidGPXdocFromMemory(ctx, buffer, length, schema);
+
+  gpxSchemaFree(schema);
+
+  return finishGPXParse(ctx, gpx);
+}
+
+GPXdoc * createValidGPXdocFromMemory(const char * buffer, size_t length, char * gpxSchemaFile){
+  return createValidGPXdocFromMemoryCtx(NULL, buffer, length, gpxSchemaFile);
+}
+
+GPXdoc * createValidGPXdocFromMemoryWithSchemaCtx(GPXParseContext * ctx, const char * buffer, size_t length, GPXSchema * schema){
+  beginGPXParse(ctx);
+
+  if(isValidMemoryInput(buffer, length) == false || schema == NULL){
+    setGPXParseError(ctx, GPX_ERROR_ARGUMENT, NULL);
+    return finishGPXParse(ctx, NULL);
+  }
+
+  return finishGPXParse(ctx, buildValidGPXdocFromMemory(ctx, buffer, length, schema));
+}
+
+GPXdoc * createValidGPXdocFromMemoryWithSchema(const char * buffer, size_t length, GPXSchema * schema){
+  return createValidGPXdocFromMemoryWithSchemaCtx(NULL, buffer, length, schema);
+}
+
+GPXdoc * createGPXdocFromBorrowedMemoryCtx(GPXParseContext * ctx, const char * buffer, size_t length){
+  beginGPXParse(ctx);
+
+  if(isValidMemoryInput(buffer, length) == false){
+    setGPXParseError(ctx, GPX_ERROR_ARGUMENT, NULL);
+    return finishGPXParse(ctx, NULL);
+  }
+
+  return finishGPXParse(ctx, buildGPXdocFromBuffer(ctx, buffer, length, NULL));
+}
+
+GPXdoc * createGPXdocFromBorrowedMemory(const char * buffer, size_t length){
+  return createGPXdocFromBorrowedMemoryCtx(NULL, buffer, length);
+}
+
+// Read callback state for mappings too large to hand to libxml2 in one piece.
+typedef struct {
+  const char * data;
+  size_t length;
+  size_t offset;
+} MappedInput;
+
+int readMappedInput(void * context, char * buffer, int len){
+  MappedInput * input = (MappedInput *) context;
+  size_t remaining = input->length - input->offset;
+  size_t count = ((size_t) len < remaining) ? (size_t) len : remaining;
+
+  memcpy(buffer, input->data + input->offset, count);
+  input->offset += count;
+
+  return (int) count;
+}
+
+int closeMappedInput(void * context){
+  return 0;
+}
+
+char * mapGPXFile(GPXParseContext * ctx, char * fileName, size_t * length){
+  if(fileName == NULL || length == NULL){
+    setGPXParseError(ctx, GPX_ERROR_ARGUMENT, NULL);
+    return NULL;
+  }
+
+  int fd = open(fileName, O_RDONLY);
+
+  if(fd == -1){
+    setGPXParseError(ctx, GPX_ERROR_IO, "the file could not be opened");
+    return NULL;
+  }
+
+  struct stat fileInfo;
+
+  if(fstat(fd, &fileInfo) == -1 || fileInfo.st_size <= 0){
+    setGPXParseError(ctx, GPX_ERROR_IO, "the file is empty or not a regular file");
+    close(fd);
+    return NULL;
+  }
+
+  *length = (size_t) fileInfo.st_size;
+  char * data = mmap(NULL, *length, PROT_READ, MAP_PRIVATE, fd, 0);
+
+  close(fd); // The mapping keeps the file referenced on its own.
+
+  if(data == MAP_FAILED){
+    setGPXParseError(ctx, GPX_ERROR_IO, "the file could not be mapped");
+    return NULL;
+  }
+
+  // The parsers only ever move forward through the file, so let the kernel read ahead and drop pages behind us.
+  posix_madvise(data, *length, POSIX_MADV_SEQUENTIAL);
+
+  return data;
+}
+
+void unmapGPXFile(char * data, size_t length){
+  if(data != NULL){
+    munmap(data, length);
+  }
+}
+
+GPXdoc * buildGPXdocFromBuffer(GPXParseContext * ctx, const char * data, size_t length, const char * url){
+  MappedInput input = { data, length, 0 };
+  xmlTextReaderPtr reader = NULL;
+  GPXdoc * gpx = NULL;
+
+  LIBXML_TEST_VERSION
+
+  if(length <= INT_MAX){
+    // xmlReaderForMemory wraps the buffer as a static input, so libxml2 reads it in place rather than copying it.
+    reader = xmlReaderForMemory(data, (int) length, url, NULL, contextXmlOptions(ctx));
+  }
+  else{
+    // Past INT_MAX libxml2 can't take the buffer as a single static input, so feed it through the reader's IO callbacks instead.
+    reader = xmlReaderForIO(readMappedInput, closeMappedInput, &input, url, NULL, XML_PARSE_HUGE | contextXmlOptions(ctx));
+  }
+
+  if(reader != NULL){
+    gpx = buildObjectsFromReader(ctx, reader);
+    xmlFreeTextReader(reader);
+  }
+
+  return gpx;
+}
+
+GPXdoc * createGPXdocMappedCtx(GPXParseContext * ctx, char * fileName){
+  size_t length = 0;
+
+  beginGPXParse(ctx);
+
+  char * data = mapGPXFile(ctx, fileName, &length);
+
+  if(data == NULL){
+    return finishGPXParse(ctx, NULL);
+  }
+
+  GPXdoc * gpx = buildGPXdocFromBuffer(ctx, data, length, fileName);
+
+  unmapGPXFile(data, length);
+
+  return finishGPXParse(ctx, gpx);
+}
+
+GPXdoc * createGPXdocMapped(char * fileName){
+  return createGPXdocMappedCtx(NULL, fileName);
+}
@@ -0,0 +1,51 @@
+/* Filename: GPXNames.c
+ * Description: The names of GPXData. Almost every GPXData is one of the twenty simple children GPX 1.1 gives waypoints, routes and
+ *              tracks, so those names live once, in gpxDataNames, and a GPXData with one of them just points at it. Two such
+ *              GPXData have the same name exactly when their name pointers are equal. Any other name is stored inline, after the
+ *              value, so a GPXData is still a single block that goes away with one free (or with its arena).
+ */
+
+#include "GPXHelpers.h"
+
+// In strcmp order, for the binary search in internGPXName, and in the same order as GPXDataName.
+const char * const gpxDataNames[NUM_GPX_DATA_NAMES] = {
+  "ageofdgpsdata", "cmt", "desc", "dgpsid", "ele", "extensions", "fix", "geoidheight", "hdop", "link", "magvar", "name", "number",
+  "pdop", "sat", "src", "sym", "time", "type", "vdop"
+};
+
+const char * internGPXName(const char * name){
+  int low = 0;
+  int high = NUM_GPX_DATA_NAMES - 1;
+
+  while(low <= high){
+    int middle = (low + high) / 2;
+    int order = strcmp(name, gpxDataNames[middle]);
+
+    if(order == EQUAL_STRINGS){
+      return gpxDataNames[middle];
+    }
+    else if(order < 0){
+      high = middle - 1;
+    }
+    else{
+      low = middle + 1;
+    }
+  }
+
+  return NULL;
+}
+
+size_t sizeOfGPXData(const char * sharedName, const char * name, const char * value){
+  size_t size = sizeof(GPXData) + strlen(value) + 1;
+
+  return (sharedName == NULL) ? size + strlen(name) + 1 : size;
+}
+
+GPXData * fillGPXData(GPXData * gpxData, const char * sharedName, const char * name, const char * value){
+  size_t valueLen = strlen(value);
+
+  memcpy(gpxData->value, value, valueLen + 1);
+  gpxData->name = (sharedName != NULL) ? sharedName : strcpy(gpxData->value + valueLen + 1, name);
+
+  return gpxData;
+}
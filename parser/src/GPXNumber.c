@@ -0,0 +1,219 @@
+/* Filename: GPXNumber.c
+ * Description: Fast conversion of the plain decimals GPX uses for coordinates and elevations ("43.537299", "-80.2", "312.1").
+ *              The digits are gathered into one integer - with SSE4.1 when the CPU has it, one digit at a time otherwise - and
+ *              the value is that integer divided by a power of ten. When the integer fits in a double's 53-bit mantissa and the
+ *              power of ten is exact (10^22 or less), that single division is correctly rounded, so the result is bit-for-bit the
+ *              one strtod gives. Anything outside that - exponents, hex, inf/nan, leading whitespace, too many digits - goes to
+ *              strtod itself.
+ *              formatGPXNumber goes the other way, for numbers that are written back out as text.
+ *
+ * Citations: The exactness argument is Clinger's fast path from "How to Read Floating Point Numbers Accurately" (PLDI 1990).
+ */
+
+#include "GPXHelpers.h"
+#include <stdint.h>
+#include <immintrin.h>
+
+#define MAX_EXACT_MANTISSA (1ULL << 53)
+#define MAX_EXACT_POWER 22
+#define MAX_SCALAR_DIGITS 19
+#define SIMD_WIDTH 16
+#define MAX_FORMAT_DECIMALS 20
+
+// Powers of ten that a double holds exactly.
+const double exactPowersOfTen[MAX_EXACT_POWER + 1] = {
+  1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+  1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+// The digits of a decimal with the point taken out: the number is mantissa / 10^fracDigits.
+typedef struct {
+  uint64_t mantissa;
+  int digits;
+  int fracDigits;
+  size_t length; // Characters used, including the point.
+} DecimalDigits;
+
+bool isDecimalDigit(char c){
+  return c >= '0' && c <= '9';
+}
+
+bool scanDecimalScalar(const char * p, const char * end, DecimalDigits * out){
+  const char * start = p;
+
+  out->mantissa = 0;
+  out->digits = 0;
+  out->fracDigits = 0;
+
+  while(p < end && isDecimalDigit(*p)){
+    if(++out->digits > MAX_SCALAR_DIGITS){
+      return false;
+    }
+
+    out->mantissa = out->mantissa * 10 + (uint64_t) (*p - '0');
+    p++;
+  }
+
+  if(p < end && *p == '.'){
+    p++;
+
+    while(p < end && isDecimalDigit(*p)){
+      if(++out->digits > MAX_SCALAR_DIGITS){
+        return false;
+      }
+
+      out->mantissa = out->mantissa * 10 + (uint64_t) (*p - '0');
+      out->fracDigits++;
+      p++;
+    }
+  }
+
+  out->length = (size_t) (p - start);
+
+  return true;
+}
+
+// For each digit count n, the 16 bytes starting at n are a pshufb control that moves the first n bytes of a register to its
+// end and zeroes the rest, so every digit lands in the lane for its place value.
+const unsigned char alignDigitLanes[2 * SIMD_WIDTH] = {
+  0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80,
+  0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15
+};
+
+// Same as scanDecimalScalar, sixteen characters at a time. Returns false (and leaves the number to the scalar scan) if the
+// number doesn't fit in one register.
+__attribute__((target("sse4.1")))
+bool scanDecimalSSE(const char * p, const char * end, DecimalDigits * out){
+  char padded[SIMD_WIDTH];
+  const char * chunkStart = p;
+
+  // Never read past the end of the string: a short tail is copied into a zero-padded buffer first.
+  if(end - p < SIMD_WIDTH){
+    memset(padded, 0, sizeof(padded));
+    memcpy(padded, p, (size_t) (end - p));
+    chunkStart = padded;
+  }
+
+  __m128i chunk = _mm_loadu_si128((const __m128i *) chunkStart);
+  __m128i isDigit = _mm_and_si128(_mm_cmpgt_epi8(chunk, _mm_set1_epi8('0' - 1)), _mm_cmplt_epi8(chunk, _mm_set1_epi8('9' + 1)));
+  unsigned int digitMask = (unsigned int) _mm_movemask_epi8(isDigit);
+
+  int intDigits = __builtin_ctz(~digitMask); // Bit 16 of ~digitMask is always set, so this is at most 16.
+  int fracDigits = 0;
+  int length = intDigits;
+
+  if(intDigits == SIMD_WIDTH){
+    return false;
+  }
+
+  if(chunkStart[intDigits] == '.'){
+    fracDigits = __builtin_ctz(~(digitMask >> (intDigits + 1)));
+    length = intDigits + 1 + fracDigits;
+
+    if(length >= SIMD_WIDTH){ // The digits might carry on past this register.
+      return false;
+    }
+
+    // Close the gap the point leaves: every lane from the point onwards takes the byte after it.
+    __m128i lanes = _mm_setr_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+    __m128i pastPoint = _mm_cmpgt_epi8(lanes, _mm_set1_epi8((char) (intDigits - 1)));
+
+    chunk = _mm_shuffle_epi8(chunk, _mm_sub_epi8(lanes, pastPoint));
+  }
+
+  int digits = intDigits + fracDigits;
+
+  chunk = _mm_sub_epi8(chunk, _mm_set1_epi8('0'));
+  chunk = _mm_shuffle_epi8(chunk, _mm_loadu_si128((const __m128i *) (alignDigitLanes + digits)));
+
+  // Combine neighbouring lanes into 2, 4 and then 8 digit values. Lane 0 of the result holds the high eight digits, lane 1 the low eight.
+  __m128i pairs = _mm_maddubs_epi16(chunk, _mm_setr_epi8(10, 1, 10, 1, 10, 1, 10, 1, 10, 1, 10, 1, 10, 1, 10, 1));
+  __m128i quads = _mm_madd_epi16(pairs, _mm_setr_epi16(100, 1, 100, 1, 100, 1, 100, 1));
+  __m128i packed = _mm_packus_epi32(quads, quads);
+  __m128i octets = _mm_madd_epi16(packed, _mm_setr_epi16(10000, 1, 10000, 1, 10000, 1, 10000, 1));
+
+  uint64_t high = (uint32_t) _mm_cvtsi128_si32(octets);
+  uint64_t low = (uint32_t) _mm_extract_epi32(octets, 1);
+
+  out->mantissa = high * 100000000ULL + low;
+  out->digits = digits;
+  out->fracDigits = fracDigits;
+  out->length = (size_t) length;
+
+  return true;
+}
+
+bool scanDecimal(const char * p, const char * end, DecimalDigits * out){
+  if(__builtin_cpu_supports("sse4.1") && scanDecimalSSE(p, end, out) == true){
+    return true;
+  }
+
+  return scanDecimalScalar(p, end, out);
+}
+
+double parseGPXNumber(const char * str, char ** endPtr){
+  const char * p = str;
+  const char * end = str + strlen(str);
+  bool negative = false;
+  DecimalDigits decimal;
+
+  if(p < end && (*p == '-' || *p == '+')){
+    negative = (*p == '-');
+    p++;
+  }
+
+  if(scanDecimal(p, end, &decimal) == true && decimal.digits > 0 && decimal.mantissa <= MAX_EXACT_MANTISSA &&
+     decimal.fracDigits <= MAX_EXACT_POWER){
+    const char * next = p + decimal.length;
+
+    // Exponents and hex ("0x...") are strtod's job.
+    if(next == end || (*next != 'e' && *next != 'E' && *next != 'x' && *next != 'X')){
+      double value = (double) decimal.mantissa / exactPowersOfTen[decimal.fracDigits];
+
+      if(endPtr != NULL){
+        *endPtr = (char *) next;
+      }
+
+      return (negative == true) ? -value : value;
+    }
+  }
+
+  return strtod(str, endPtr);
+}
+
+bool parseGPXDecimal(const char * text, double * value){
+  size_t len;
+  const char * start = trimSchemaValue(text, &len);
+  const char * end = start + len;
+  const char * p = (start < end && (*start == '-' || *start == '+')) ? start + 1 : start;
+  int numDigits = 0;
+  int numPoints = 0;
+
+  for(; p < end && (isDecimalDigit(*p) == true || *p == '.'); p++){
+    numDigits += (*p == '.') ? 0 : 1;
+    numPoints += (*p == '.') ? 1 : 0;
+  }
+
+  if(numDigits == 0 || p != end || numPoints > 1){
+    return false;
+  }
+
+  // The number stops at the first space after it, if there is one.
+  *value = parseGPXNumber(start, NULL);
+
+  return true;
+}
+
+void formatGPXNumber(double value, char * buffer){
+  // The fewest decimals that read back as the same double. Only a tiny value needs more than MAX_FORMAT_DECIMALS, and it gets
+  // an exponent instead - still exact, though not an xsd:decimal.
+  for(int decimals = 0; decimals <= MAX_FORMAT_DECIMALS; decimals++){
+    snprintf(buffer, DOUBLE_CHARS, "%.*f", decimals, value);
+
+    if(parseGPXNumber(buffer, NULL) == value){
+      return;
+    }
+  }
+
+  snprintf(buffer, DOUBLE_CHARS, "%.17g", value);
+}
@@ -0,0 +1,242 @@
+/* Filename: GPXParallel.c
+ * Description: Parses a single large GPX file on several threads. Almost all of a big track file is one long run of <trkpt>
+ *              elements, so the buffer is cut at <trkpt start tags spread evenly through it, and each chunk from one cut to the
+ *              next is tokenized on a thread of its own into a scratch segment. A serial tokenizer pass over the whole buffer
+ *              then reads everything the chunks don't cover - the prolog, metadata, waypoints, routes and the tags around each
+ *              segment - and, whenever it reaches the start of a chunk while it is between the points of a <trkseg>, moves the
+ *              chunk's points onto the end of that segment and jumps to where the chunk stopped. The points end up in their
+ *              original order, and anything the threads couldn't read is simply read again by the serial pass, so the GPXdoc
+ *              is the one createGPXdoc would build. Input the tokenizer doesn't handle falls back to libxml2 as in GPXTokenizer.c.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "GPXHelpers.h"
+#include <pthread.h>
+#include <unistd.h>
+
+// Chunks smaller than this aren't worth a thread.
+#define MIN_CHUNK_BYTES (1 << 20)
+
+typedef struct {
+  GPXParseContext * ctx;
+  const char * data;
+  const char * end;
+  GPXChunk * chunks;
+  int numChunks;
+  int index;
+
+  // Whether the bytes this worker covers passed isTokenizableInput, and whether they were all ASCII.
+  bool valid;
+  bool isAscii;
+} ParallelWorker;
+
+// Returns true if p is the '<' of a <trkpt start tag.
+bool isChunkStart(const char * p, const char * end){
+  size_t len = strlen(TRKPT) + 1;
+
+  if((size_t) (end - p) <= len || p[0] != '<' || memcmp(p + 1, TRKPT, len - 1) != EQUAL_STRINGS){
+    return false;
+  }
+
+  char next = p[len];
+
+  return next == ' ' || next == '\t' || next == '\n' || next == '\r' || next == '>' || next == '/';
+}
+
+// Searches forward from each of numChunks evenly spaced offsets for a <trkpt start tag to cut at. A cut may land inside a
+// comment or an attribute value; that chunk just fails to line up with the document and gets read by the serial pass.
+int findGPXChunks(const char * data, size_t length, int numChunks, GPXChunk * chunks){
+  const char * end = data + length;
+  const char * from = data;
+  int found = 0;
+
+  for(int i = 0; i < numChunks; i++){
+    const char * p = data + (size_t) ((double) length * i / numChunks);
+
+    if(p < from){
+      p = from;
+    }
+
+    while((p = memchr(p, '<', (size_t) (end - p))) != NULL && isChunkStart(p, end) == false){
+      p++;
+    }
+
+    if(p == NULL){
+      break;
+    }
+
+    chunks[found].start = p;
+    chunks[found].stop = NULL;
+    chunks[found].points = NULL;
+    found++;
+    from = p + 1;
+  }
+
+  return found;
+}
+
+void * runParallelWorker(void * arg){
+  ParallelWorker * worker = (ParallelWorker *) arg;
+  int index = worker->index;
+
+  // Each worker checks the bytes from its own cut up to the next one (the first also checks everything before its cut), so
+  // between them the workers check the whole buffer exactly once.
+  const char * from = (index == 0) ? worker->data : worker->chunks[index].start;
+  const char * to = (index + 1 < worker->numChunks) ? worker->chunks[index + 1].start : worker->end;
+
+  worker->valid = isTokenizableInput(from, (size_t) (to - from), &worker->isAscii);
+
+  if(worker->valid == true){
+    tokenizeGPXChunk(worker->ctx, worker->end, worker->chunks, worker->numChunks, index);
+  }
+
+  return NULL;
+}
+
+// The number of threads to parse length bytes with: one per online CPU for threads <= 0, and never so many that a chunk
+// would be smaller than MIN_CHUNK_BYTES.
+int chooseParallelThreads(size_t length, int threads){
+  if(threads <= 0){
+    long online = sysconf(_SC_NPROCESSORS_ONLN);
+    threads = (online > 0) ? (int) online : 1;
+  }
+
+  size_t most = length / MIN_CHUNK_BYTES;
+
+  if((size_t) threads > most){
+    threads = (most == 0) ? 1 : (int) most;
+  }
+
+  return threads;
+}
+
+// Tokenizes the buffer with up to threads threads. Like tokenizeGPXdoc, returns NULL if the tokenizer can't handle the input.
+GPXdoc * tokenizeGPXdocParallel(GPXParseContext * ctx, const char * data, size_t length, int threads){
+  const GPXAllocator * allocator = contextAllocator(ctx);
+
+  threads = chooseParallelThreads(length, threads);
+
+  if(threads < 2){
+    return tokenizeGPXdoc(ctx, data, length);
+  }
+
+  GPXChunk * chunks = (GPXChunk *) allocateScratch(allocator, sizeof(GPXChunk) * threads);
+  ParallelWorker * workers = (ParallelWorker *) allocateScratch(allocator, sizeof(ParallelWorker) * threads);
+  pthread_t * threadIds = (pthread_t *) allocateScratch(allocator, sizeof(pthread_t) * threads);
+  bool * started = (bool *) allocateScratch(allocator, sizeof(bool) * threads);
+  int numChunks = 0;
+
+  if(chunks != NULL && workers != NULL && threadIds != NULL && started != NULL){
+    numChunks = findGPXChunks(data, length, threads, chunks);
+  }
+
+  if(numChunks < 2){ // Out of memory, or not enough points to be worth splitting.
+    releaseScratch(allocator, chunks);
+    releaseScratch(allocator, workers);
+    releaseScratch(allocator, threadIds);
+    releaseScratch(allocator, started);
+
+    return tokenizeGPXdoc(ctx, data, length);
+  }
+
+  for(int i = 0; i < numChunks; i++){
+    ParallelWorker worker = { ctx, data, data + length, chunks, numChunks, i, false, false };
+
+    workers[i] = worker;
+    started[i] = false;
+  }
+
+  // The calling thread takes the first chunk. A chunk whose thread can't be started is tokenized here as well.
+  for(int i = 1; i < numChunks; i++){
+    started[i] = (pthread_create(&threadIds[i], NULL, runParallelWorker, &workers[i]) == 0);
+  }
+
+  runParallelWorker(&workers[0]);
+
+  bool valid = true;
+  bool isAscii = true;
+
+  for(int i = 0; i < numChunks; i++){
+    if(i > 0 && started[i] == true){
+      pthread_join(threadIds[i], NULL);
+    }
+    else if(i > 0){
+      runParallelWorker(&workers[i]);
+    }
+
+    valid = valid && workers[i].valid;
+    isAscii = isAscii && workers[i].isAscii;
+  }
+
+  GPXdoc * gpx = NULL;
+
+  if(valid == true){
+    gpx = tokenizeCheckedGPXdoc(ctx, data, length, isAscii, chunks, numChunks);
+  }
+
+  // Spliced chunks have been freed already, so this only frees the chunks that were skipped.
+  for(int i = 0; i < numChunks; i++){
+    deleteGPXdoc(chunks[i].points);
+  }
+
+  releaseScratch(allocator, chunks);
+  releaseScratch(allocator, workers);
+  releaseScratch(allocator, threadIds);
+  releaseScratch(allocator, started);
+
+  return gpx;
+}
+
+GPXdoc * buildGPXdocInParallel(GPXParseContext * ctx, const char * data, size_t length, const char * url, int threads){
+  GPXdoc * gpx = tokenizeGPXdocParallel(ctx, data, length, threads);
+
+  if(gpx == NULL){ // Same as buildGPXdocWithFallback - libxml2 has the final say.
+    if(ctx != NULL){
+      ctx->stats.numFallbacks++;
+    }
+
+    gpx = buildGPXdocFromBuffer(ctx, data, length, url);
+  }
+
+  return gpx;
+}
+
+/* *****************************************************************************PUBLIC API****************************************************************************** */
+
+GPXdoc * createGPXdocParallelFromMemoryCtx(GPXParseContext * ctx, const char * buffer, size_t length, int threads){
+  beginGPXParse(ctx);
+
+  if(buffer == NULL || length == 0){
+    setGPXParseError(ctx, GPX_ERROR_ARGUMENT, NULL);
+    return finishGPXParse(ctx, NULL);
+  }
+
+  return finishGPXParse(ctx, buildGPXdocInParallel(ctx, buffer, length, NULL, threads));
+}
+
+GPXdoc * createGPXdocParallelFromMemory(const char * buffer, size_t length, int threads){
+  return createGPXdocParallelFromMemoryCtx(NULL, buffer, length, threads);
+}
+
+GPXdoc * createGPXdocParallelCtx(GPXParseContext * ctx, char * fileName, int threads){
+  size_t length = 0;
+
+  beginGPXParse(ctx);
+
+  char * data = mapGPXFile(ctx, fileName, &length);
+
+  if(data == NULL){
+    return finishGPXParse(ctx, NULL);
+  }
+
+  GPXdoc * gpx = buildGPXdocInParallel(ctx, data, length, fileName, threads);
+
+  unmapGPXFile(data, length);
+
+  return finishGPXParse(ctx, gpx);
+}
+
+GPXdoc * createGPXdocParallel(char * fileName, int threads){
+  return createGPXdocParallelCtx(NULL, fileName, threads);
+}
@@ -13,53 +13,12 @@
 
 #include "GPXParser.h"
 #include <stdbool.h>
+#include "GPXHelpers.h"
 
-#define EQUAL_STRINGS 0
-#define NO_ELEMENTS 0
-#define MAX_READ_CHARS 256
-#define DOUBLE_CHARS 325
-#define GPXDATA_SIZE 1000
-#define JSON_LIST_STR_MAX_LENGTH 6000
-#define JSON_GPX_STR_MAX_LENGTH 9000
-#define MAX_NAME_LENGTH 1250
-#define HALF_CIRCLE_DEGREES 180
-#define MIN_LOOP_WPTS 4
-#define DEFAULT_DELTA 10
-#define JSON_NAME_LEN 257
-#define JSON_WPT_STR_LEN 600
-#define JSON_STR_LEN 1000
-#define FILE_JSON_STR_LEN 10000
-
-#define MAX_LATITUDE 90.000000
-#define MIN_LATITUDE -90.000000
-#define MAX_LONGITUDE 180.000000
-#define MIN_LONGITUDE -180.000000
-
-#define SENTINEL_LAT_LON -200.000000 // Base invalid value. If a lat or lon isn't properly set, then this value will indicate so.
-#define SENTINEL_VERSION -1.0 // Same purpose as the sentinel value above, but for the gpx version.
-
-#define GPX "gpx"
-#define TRK "trk"
-#define TRKSEG "trkseg"
-#define TRKPT "trkpt"
-#define RTEPT "rtept"
-#define WPT "wpt"
-#define ELE "ele"
-#define RTE "rte"
-#define VERSION "version"
-#define CREATOR "creator"
-#define TEXT "text"
-#define LAT "lat"
-#define LON "lon"
-#define NAME "name"
-#define DEFAULT_NAMESPACE "http://www.topografix.com/GPX/1/1"
-
-
-bool parseFail = false;
 
 /* **************************************************************************CONSTRUCTORS**************************************************************************************** */
 
-GPXdoc * buildGPXdoc(GPXdoc * gpx, char * schemaLocation, char * version, char * creator){
+GPXdoc * buildGPXdoc(GPXdoc * gpx, char * schemaLocation, char * version, char * creator, ListAllocator * allocator){
   char * endPtr;
 
   if(gpx == NULL || schemaLocation == NULL || version == NULL || creator == NULL){
@@ -67,6 +26,12 @@ GPXdoc * buildGPXdoc(GPXdoc * gpx, char * schemaLocation, char * version, char *
     return NULL;
   }
 
+  // The namespace is stored in a fixed array, so one that doesn't fit is a document a GPXdoc can't hold.
+  if(strlen(schemaLocation) >= sizeof(gpx->namespace)){
+    free(gpx);
+    return NULL;
+  }
+
   int strMemLen = strlen(creator) + 2;
 
   if(strcmp(version, "\0") == EQUAL_STRINGS){
@@ -86,10 +51,13 @@ GPXdoc * buildGPXdoc(GPXdoc * gpx, char * schemaLocation, char * version, char *
 
   strcpy(gpx->creator, creator);
   strcpy(gpx->namespace, schemaLocation);
+  gpx->numSegments = 0;
+  gpx->numGPXData = 0;
+  gpx->nameIndex = NULL;
 
-  gpx->waypoints = initializeList(waypointToString, deleteWaypoint, compareWaypoints);
-  gpx->routes = initializeList(routeToString, deleteRoute, compareRoutes);
-  gpx->tracks = initializeList(trackToString, deleteTrack, compareTracks);
+  gpx->waypoints = initializeListWithAllocator(waypointToString, deleteWaypoint, compareWaypoints, allocator);
+  gpx->routes = initializeListWithAllocator(routeToString, deleteRoute, compareRoutes, allocator);
+  gpx->tracks = initializeListWithAllocator(trackToString, deleteTrack, compareTracks, allocator);
 
   if(gpx->waypoints == NULL || gpx->routes == NULL || gpx->tracks == NULL){
     freeList(gpx->waypoints);
@@ -102,7 +70,7 @@ GPXdoc * buildGPXdoc(GPXdoc * gpx, char * schemaLocation, char * version, char *
   return gpx;
 }
 
-Track * buildTrack(Track * track, char * name){
+Track * buildTrack(Track * track, char * name, ListAllocator * allocator){
   int strMemLen = 0;
   track = (Track *) malloc(sizeof(Track));
   track->name = (char *) malloc(sizeof(char));
@@ -115,8 +83,9 @@ Track * buildTrack(Track * track, char * name){
   else{
     strMemLen = strlen(name) + 2;
     strcpy(track->name, "\0");
-    track->segments = initializeList(trackSegmentToString, deleteTrackSegment, compareTrackSegments);
-    track->otherData = initializeList(gpxDataToString, deleteGpxData, compareGpxData);
+    memset(&track->summary, 0, sizeof(GPXSummaryCache));
+    track->segments = initializeListWithAllocator(trackSegmentToString, deleteTrackSegment, compareTrackSegments, allocator);
+    track->otherData = initializeListWithAllocator(gpxDataToString, deleteGpxData, compareGpxData, allocator);
 
     if(track->segments == NULL || track->otherData == NULL){
       freeList(track->segments);
@@ -146,7 +115,7 @@ Track * buildTrack(Track * track, char * name){
   return track;
 }
 
-Route * buildRoute(Route * route, char * name){
+Route * buildRoute(Route * route, char * name, ListAllocator * allocator){
   int strMemLen = 1;
   route = (Route *) malloc(sizeof(Route));
   route->name = (char *) malloc(sizeof(char));
@@ -159,8 +128,10 @@ Route * buildRoute(Route * route, char * name){
   else{
     strMemLen = strlen(name) + 2;
     strcpy(route->name, "\0");
-    route->waypoints = initializeList(waypointToString, deleteWaypoint, compareWaypoints);
-    route->otherData = initializeList(gpxDataToString, deleteGpxData, compareGpxData);
+    route->doc = NULL;
+    memset(&route->summary, 0, sizeof(GPXSummaryCache));
+    route->waypoints = initializeListWithAllocator(waypointToString, deleteWaypoint, compareWaypoints, allocator);
+    route->otherData = initializeListWithAllocator(gpxDataToString, deleteGpxData, compareGpxData, allocator);
 
     if(route->waypoints == NULL || route->otherData == NULL){
       freeList(route->waypoints);
@@ -188,7 +159,7 @@ Route * buildRoute(Route * route, char * name){
   return route;
 }
 
-Waypoint * buildWaypoint(Waypoint * waypoint, char * name, char * longitude, char * latitude){
+Waypoint * buildWaypoint(Waypoint * waypoint, char * name, char * longitude, char * latitude, ListAllocator * allocator){
   char * endPtr;
   int strMemLen = 0;
 
@@ -205,7 +176,9 @@ Waypoint * buildWaypoint(Waypoint * waypoint, char * name, char * longitude, cha
     strcpy(waypoint->name, "\0");
     waypoint->longitude = SENTINEL_LAT_LON;
     waypoint->latitude = SENTINEL_LAT_LON;
-    waypoint->otherData = initializeList(gpxDataToString, deleteGpxData, compareGpxData);
+    waypoint->elevation = NAN;
+    waypoint->time = GPX_NO_TIME;
+    waypoint->otherData = initializeListWithAllocator(gpxDataToString, deleteGpxData, compareGpxData, allocator);
 
     if(waypoint->otherData == NULL){
       freeList(waypoint->otherData);
@@ -227,46 +200,32 @@ Waypoint * buildWaypoint(Waypoint * waypoint, char * name, char * longitude, cha
   else{
     strcpy(waypoint->name, name);
     if(!(strcmp(longitude, "\0") == EQUAL_STRINGS)){
-      waypoint->longitude = strtod(longitude, &endPtr);  
+      waypoint->longitude = parseGPXNumber(longitude, &endPtr);  
     }
     if(!(strcmp(longitude, "\0") == EQUAL_STRINGS)){
-      waypoint->latitude = strtod(latitude, &endPtr);
+      waypoint->latitude = parseGPXNumber(latitude, &endPtr);
     }
   }
 
   return waypoint;
 }
 
-GPXData * buildGPXData(GPXData * gpxData, char * name, char * value){
-  gpxData = (GPXData *) malloc(sizeof(GPXData) + (2 * sizeof(char))); // For the empty flexible array member.
-  int strMemLen = 1;
-
-  if(gpxData == NULL || name == NULL || value == NULL || strcmp(value, "\0") == EQUAL_STRINGS){
-    free(gpxData);
+GPXData * buildGPXData(GPXData * gpxData, const char * name, const char * value){
+  if(name == NULL || value == NULL || strcmp(value, "\0") == EQUAL_STRINGS){
     return NULL;
   }
-  else{
-    strMemLen = (sizeof(char) * strlen(value)) + 5;
-    strcpy(gpxData->name, "\0");
-    strcpy(gpxData->value, "\0");
-  }
 
-  if(!(strcmp(value, "\0") == EQUAL_STRINGS)){
-    gpxData = (GPXData *) realloc(gpxData, sizeof(GPXData) + strMemLen);
-  }
+  const char * sharedName = internGPXName(name);
+  gpxData = (GPXData *) malloc(sizeOfGPXData(sharedName, name, value));
 
   if(gpxData == NULL){
-    free(gpxData);
     return NULL;
   }
 
-  strcpy(gpxData->name, name);
-  strcpy(gpxData->value, value);
-
-  return gpxData;
+  return fillGPXData(gpxData, sharedName, name, value);
 }
 
-TrackSegment * buildTrackSegment(TrackSegment * trackSegment){
+TrackSegment * buildTrackSegment(TrackSegment * trackSegment, ListAllocator * allocator){
   trackSegment = (TrackSegment *) malloc(sizeof(TrackSegment));
 
   if(trackSegment == NULL){
@@ -274,7 +233,7 @@ TrackSegment * buildTrackSegment(TrackSegment * trackSegment){
     return NULL;
   }
 
-  trackSegment->waypoints = initializeList(waypointToString, deleteWaypoint, compareWaypoints);
+  trackSegment->waypoints = initializeListWithAllocator(waypointToString, deleteWaypoint, compareWaypoints, allocator);
 
   if(trackSegment->waypoints == NULL){
     free(trackSegment->waypoints);
@@ -285,310 +244,386 @@ TrackSegment * buildTrackSegment(TrackSegment * trackSegment){
   return trackSegment;
 }
 
-GPXdoc * buildObjects(xmlNode * a_node, GPXdoc * gpx){
-  xmlNode * cur_node = NULL;
+GPXdoc * newGPXdoc(GPXParseContext * ctx, char * schemaLocation, char * version, char * creator){
+  if(contextUsesArena(ctx) == true){
+    return buildArenaGPXdoc(schemaLocation, version, creator);
+  }
 
-  Track * track;
-  TrackSegment * trackSegment;
-  Waypoint * waypoint;
-  Route * route;
-  GPXData * gpxData;
+  ListNodePool * pool = createNodePool();
 
-  char * gpxSchema = "\0";
-  char * gpxVersion = "\0";
-  char * gpxCreator = "\0";
+  if(pool == NULL){
+    return NULL;
+  }
 
-  char trkName[MAX_NAME_LENGTH] = "\0";
-  char wptName[MAX_NAME_LENGTH] = "\0";
-  char rteName[MAX_NAME_LENGTH] = "\0";
-  
-  char * wptLat = "\0";
-  char * wptLon = "\0";
+  GPXdoc * gpx = (GPXdoc *) malloc(sizeof(GPXdoc));
+  gpx = buildGPXdoc(gpx, schemaLocation, version, creator, nodePoolAllocator(pool));
 
-  char * gpxDataName = "\0";
-  char * gpxDataValue = "\0";
+  // From here on the document's lists keep the pool alive, and the last one to be freed frees it.
+  releaseNodePool(pool);
 
-  for (cur_node = a_node; cur_node != NULL; cur_node = cur_node->next) {
-    if (cur_node->type == XML_ELEMENT_NODE){
-      if(strcmp((char *) cur_node->name, RTE) == EQUAL_STRINGS){
-        xmlNode * child = cur_node->children->next;
-        xmlChar * content = xmlNodeGetContent(child);
-        
-        if(cur_node->children != NULL){
-          while(child != NULL && child != child->last){
-            if(strcmp((char *) child->name, NAME) == EQUAL_STRINGS){
-              strcpy(rteName, (char *) content);
-            }
-
-            child = child->next;
-          }
-                        
-          xmlFree(content);
-        } 
-      }
+  return gpx;
+}
 
-      if(strcmp((char *) cur_node->name, TRK) == EQUAL_STRINGS){
-        if(cur_node->children != NULL){
-          xmlNode * child = cur_node->children->next;
+/* ***********************************************************************INCREMENTAL BUILDERS************************************************************************************* */
 
-          xmlChar * content = xmlNodeGetContent(child);
-          while(child != NULL && child != child->last){
-            if(strcmp((char *) child->name, NAME) == EQUAL_STRINGS){
-              strcpy(trkName, (char *) content);
-            }
+GPXElement classifyGPXElement(const char * name){
+  if(name == NULL){
+    return GPX_ELEMENT_OTHER;
+  }
 
-            child = child->next;
-          }
-                        
-          xmlFree(content);
-        } 
+  // Switch on the first character so most names are rejected without running a strcmp chain.
+  switch(name[0]){
+    case 'g':
+      if(strcmp(name, GPX) == EQUAL_STRINGS){
+        return GPX_ELEMENT_GPX;
+      }
+      break;
+    case 'w':
+      if(strcmp(name, WPT) == EQUAL_STRINGS){
+        return GPX_ELEMENT_WPT;
+      }
+      break;
+    case 'r':
+      if(strcmp(name, RTEPT) == EQUAL_STRINGS){
+        return GPX_ELEMENT_RTEPT;
       }
+      else if(strcmp(name, RTE) == EQUAL_STRINGS){
+        return GPX_ELEMENT_RTE;
+      }
+      break;
+    case 't':
+      if(strcmp(name, TRKPT) == EQUAL_STRINGS){
+        return GPX_ELEMENT_TRKPT;
+      }
+      else if(strcmp(name, TRKSEG) == EQUAL_STRINGS){
+        return GPX_ELEMENT_TRKSEG;
+      }
+      else if(strcmp(name, TRK) == EQUAL_STRINGS){
+        return GPX_ELEMENT_TRK;
+      }
+      break;
+    case 'n':
+      if(strcmp(name, NAME) == EQUAL_STRINGS){
+        return GPX_ELEMENT_NAME;
+      }
+      break;
+  }
 
-      else if(strcmp((char *) cur_node->name, TRKSEG) == EQUAL_STRINGS){
-        if((getFromBack(gpx->tracks)) == NULL){
-          track = (Track *) buildTrack(track, "\0");
+  return GPX_ELEMENT_OTHER;
+}
 
-          if(track == NULL){
-            parseFail = true;
-            return NULL;
-          }
+bool isStructuralChild(GPXElement parent, GPXElement child){
+  switch(parent){
+    case GPX_ELEMENT_GPX:
+      return child == GPX_ELEMENT_WPT || child == GPX_ELEMENT_RTE || child == GPX_ELEMENT_TRK;
+    case GPX_ELEMENT_RTE:
+      return child == GPX_ELEMENT_RTEPT;
+    case GPX_ELEMENT_TRK:
+      return child == GPX_ELEMENT_TRKSEG;
+    case GPX_ELEMENT_TRKSEG:
+      return child == GPX_ELEMENT_TRKPT;
+    default:
+      return false;
+  }
+}
 
-          insertBack(gpx->tracks, (void *) track); 
-        }
-        else{
-          track = (Track *) getFromBack(gpx->tracks);
-        }
+bool isOwnerElement(GPXElement element){
+  return element == GPX_ELEMENT_TRK || element == GPX_ELEMENT_RTE || element == GPX_ELEMENT_WPT ||
+         element == GPX_ELEMENT_TRKPT || element == GPX_ELEMENT_RTEPT;
+}
 
-        trackSegment = buildTrackSegment(trackSegment);
+// Each of these allocates from the document's arena if it has one.
+Track * openTrack(GPXdoc * gpx){
+  GPXArena * arena = listArena(gpx->tracks);
+  Track * track = NULL;
+  track = (arena != NULL) ? buildArenaTrack(arena) : buildTrack(track, "\0", gpx->tracks->allocator);
 
-        if(trackSegment == NULL){
-          parseFail = true;
-          return NULL;
-        }
+  if(track == NULL){
+    return NULL;
+  }
 
-        insertBack(track->segments, (void *) trackSegment);
-      }
+  if(insertBack(gpx->tracks, (void *) track) == false){
+    gpx->tracks->deleteData(track);
+    return NULL;
+  }
 
-      xmlAttr *attr;
-      for (attr = cur_node->properties; attr != NULL; attr = attr->next) {
-        xmlNode * value = attr->children;
-        char * attrName = (char *) attr->name;
-        char * cont = (char *) (value->content);
-
-        if(strcmp((char *) cur_node->name, GPX) == EQUAL_STRINGS){
-          gpxSchema = (char *) cur_node->ns->href;
-
-          if(strcmp(attrName, VERSION) == EQUAL_STRINGS){
-            gpxVersion = cont;
-          }
-          else if(strcmp(attrName, CREATOR) == EQUAL_STRINGS){
-            gpxCreator = cont;
-          }
-        }
-        else if(strcmp((char *) cur_node->name, TRKPT) == EQUAL_STRINGS || strcmp((char *) cur_node->name, WPT) == EQUAL_STRINGS ||
-                strcmp((char *) cur_node->name, RTEPT) == EQUAL_STRINGS){ 
-          
-          if(cur_node->children != NULL){
-            xmlNode * child = cur_node->children->next;
-
-            xmlChar * content = xmlNodeGetContent(child);
-            while(child != NULL && child != child->last){
-              if(strcmp((char *) child->name, NAME) == EQUAL_STRINGS){
-                strcpy(wptName, (char *) content);
-              }
-
-              child = child->next;
-            }
-                          
-            xmlFree(content);
-          }          
-
-          if(strcmp(attrName, LAT) == EQUAL_STRINGS){
-            wptLat = cont;
-          }
-          else if(strcmp(attrName, LON) == EQUAL_STRINGS){
-            wptLon = cont;
-          }
-        }
-      }
+  return track;
+}
 
-      if(strcmp((char *) cur_node->name, GPX) == EQUAL_STRINGS){
-        gpx = buildGPXdoc(gpx, gpxSchema, gpxVersion, gpxCreator);
+TrackSegment * openTrackSegment(GPXdoc * gpx){
+  Track * track = (Track *) getFromBack(gpx->tracks);
+  TrackSegment * trackSegment = NULL;
 
-        if(gpx == NULL){
-          parseFail = true;
-          return NULL;
-        }
-      }
-      else if(strcmp((char *) cur_node->name, TRKPT) == EQUAL_STRINGS || strcmp((char *) cur_node->name, WPT) == EQUAL_STRINGS ||
-              strcmp((char *) cur_node->name, RTEPT) == EQUAL_STRINGS){
+  if(track == NULL){ // A segment outside of a <trk> gets an anonymous track.
+    track = openTrack(gpx);
 
-        waypoint = buildWaypoint(waypoint, wptName, wptLon, wptLat);
+    if(track == NULL){
+      return NULL;
+    }
+  }
 
-        strcpy(wptName, "\0");
+  GPXArena * arena = listArena(track->segments);
+  trackSegment = (arena != NULL) ? buildArenaTrackSegment(arena) : buildTrackSegment(trackSegment, track->segments->allocator);
 
-        if(waypoint == NULL){
-          parseFail = true;
-          return NULL;
-        }
+  if(trackSegment == NULL){
+    return NULL;
+  }
 
-        if(cur_node->children != NULL){
-          xmlNode * child = cur_node->children->next;
+  if(insertBack(track->segments, (void *) trackSegment) == false){
+    track->segments->deleteData(trackSegment);
+    return NULL;
+  }
 
-          while(child != NULL && child != child->last){
-            xmlChar * content = xmlNodeGetContent(child);
-            if(strcmp((char *) child->name, TEXT) != EQUAL_STRINGS && strcmp((char *) child->name, NAME) != EQUAL_STRINGS){
-              gpxDataName = (char *) child->name;
-              gpxDataValue = (char *) content;
+  return trackSegment;
+}
 
-              gpxData = buildGPXData(gpxData, gpxDataName, gpxDataValue);
+Route * openRoute(GPXdoc * gpx){
+  GPXArena * arena = listArena(gpx->routes);
+  Route * route = NULL;
+  route = (arena != NULL) ? buildArenaRoute(arena) : buildRoute(route, "\0", gpx->routes->allocator);
 
-              if(gpxData == NULL){
-                parseFail = true;
-                return NULL;
-              }
+  if(route == NULL){
+    return NULL;
+  }
 
-              insertBack(waypoint->otherData, gpxData);
-            }
+  if(insertBack(gpx->routes, (void *) route) == false){
+    gpx->routes->deleteData(route);
+    return NULL;
+  }
 
-            xmlFree(content);
-            child = child->next;
-          }
-        }
+  return route;
+}
 
-        if(strcmp((char *) cur_node->name, WPT) == EQUAL_STRINGS){
-          insertBack(gpx->waypoints, (void *) waypoint);  
-        }
-        else if(strcmp((char *) cur_node->name, TRKPT) == EQUAL_STRINGS){
-          if(getFromBack(gpx->tracks) == NULL){
-            track = buildTrack(track, "\0"); // Since there is no regular data to store here.
-
-            if(track == NULL){
-              parseFail = true;
-              return NULL;
-            }
-
-            insertBack(gpx->tracks, (void *) track);
-          }
-          else{
-            track = (Track *) getFromBack(gpx->tracks);
-          }
-
-          if((getFromBack(track->segments)) == NULL){
-            trackSegment = buildTrackSegment(trackSegment);
-
-            if(trackSegment == NULL){
-              parseFail = true;
-              return NULL;
-            }
-
-            insertBack(track->segments, (void *) trackSegment);
-          }
-          else{
-            trackSegment = (TrackSegment *) getFromBack(track->segments);
-          }
-          
-          insertBack(trackSegment->waypoints, (void *) waypoint);
-        }
-        else if(strcmp((char *) cur_node->name, RTEPT) == EQUAL_STRINGS){
-          if((getFromBack(gpx->routes)) == NULL){
-            route = buildRoute(route,"\0");
-
-            if(route == NULL){
-              parseFail = true;
-              return NULL;
-            }
-
-            insertBack(gpx->routes, (void *) route);        
-          }
-          else{
-            route = (Route *) getFromBack(gpx->routes);
-          }
-
-          insertBack(route->waypoints, (void *) waypoint);
-        }
-      }
-      else if(strcmp((char *) cur_node->name, TRK) == EQUAL_STRINGS){
-        track = (Track *) buildTrack(track, trkName);
+Waypoint * openWaypoint(GPXdoc * gpx, GPXElement element, char * longitude, char * latitude){
+  List * points = NULL;
 
-        if(track == NULL){
-          parseFail = true;
-          return NULL;
-        }
+  if(element == GPX_ELEMENT_WPT){
+    points = gpx->waypoints;
+  }
+  else if(element == GPX_ELEMENT_TRKPT){
+    Track * track = (Track *) getFromBack(gpx->tracks);
+    TrackSegment * trackSegment = (track == NULL) ? NULL : (TrackSegment *) getFromBack(track->segments);
 
-        strcpy(trkName, "\0");
+    if(trackSegment == NULL){
+      trackSegment = openTrackSegment(gpx);
+    }
 
-        if(cur_node->children != NULL){
-          xmlNode * child = cur_node->children->next;
+    points = (trackSegment == NULL) ? NULL : trackSegment->waypoints;
+  }
+  else if(element == GPX_ELEMENT_RTEPT){
+    Route * route = (Route *) getFromBack(gpx->routes);
 
-          while(child != NULL && child != child->last){
-            xmlChar * content = xmlNodeGetContent(child);
-            if(strcmp((char *) child->name, TEXT) != EQUAL_STRINGS && strcmp((char *) child->name, TRKSEG) != EQUAL_STRINGS &&
-               strcmp((char *) child->name, NAME) != EQUAL_STRINGS){
-              gpxDataName = (char *) child->name;
-              gpxDataValue = (char *) content;
+    if(route == NULL){
+      route = openRoute(gpx);
+    }
 
-              gpxData = buildGPXData(gpxData, gpxDataName, gpxDataValue);
+    points = (route == NULL) ? NULL : route->waypoints;
+  }
 
-              if(gpxData == NULL){
-                parseFail = true;
-                return NULL;
-              }
+  if(points == NULL){
+    return NULL;
+  }
 
-              insertBack(track->otherData, gpxData);
-            }
+  GPXArena * arena = listArena(points);
+  Waypoint * waypoint = NULL;
+  waypoint = (arena != NULL) ? buildArenaWaypoint(arena, longitude, latitude) : buildWaypoint(waypoint, "\0", longitude, latitude, points->allocator);
 
-            xmlFree(content);
-            child = child->next;
-          }
-        }
+  if(waypoint == NULL){
+    return NULL;
+  }
+
+  if(insertBack(points, (void *) waypoint) == false){
+    points->deleteData(waypoint);
+    return NULL;
+  }
+
+  return waypoint;
+}
+
+bool addChildData(char ** nameField, Waypoint * waypoint, List * otherData, const char * childName, const char * value){
+  if(childName == NULL || value == NULL){
+    return false;
+  }
 
-        insertBack(gpx->tracks, track);
+  // From here on, a name is one of gpxDataNames exactly when it is the same pointer.
+  const char * sharedName = internGPXName(childName);
+
+  // A waypoint's first <ele> and <time> go in its typed fields, if they can be read.
+  if(waypoint != NULL && sharedName == gpxDataNames[GPX_NAME_ELE] && isnan(waypoint->elevation) &&
+     parseGPXDecimal(value, &waypoint->elevation) == true){
+    return true;
+  }
+
+  if(waypoint != NULL && sharedName == gpxDataNames[GPX_NAME_TIME] && waypoint->time == GPX_NO_TIME &&
+     parseGPXTime(value, &waypoint->time) == true){
+    return true;
+  }
+
+  GPXArena * arena = listArena(otherData);
+
+  if(sharedName == gpxDataNames[GPX_NAME_NAME]){
+    if(arena != NULL){ // The old name stays in the arena.
+      char * name = arenaString(arena, value);
+
+      if(name == NULL){
+        return false;
       }
-      else if(strcmp((char *) cur_node->name, RTE) == EQUAL_STRINGS){ 
-        route = (Route *) buildRoute(route, rteName);
 
-        if(route == NULL){
-          parseFail = true;
-          return NULL;
-        }
+      *nameField = name;
+
+      return true;
+    }
+
+    char * name = (char *) malloc(sizeof(char) * (strlen(value) + 1));
+
+    if(name == NULL){
+      return false;
+    }
+
+    strcpy(name, value);
+    free(*nameField);
+    *nameField = name;
+
+    return true;
+  }
+
+  // The same GPXData buildGPXData makes, without looking the name up again.
+  if(strcmp(value, "\0") == EQUAL_STRINGS){
+    return false;
+  }
+
+  size_t size = sizeOfGPXData(sharedName, childName, value);
+  GPXData * gpxData = (GPXData *) ((arena != NULL) ? arenaAllocate(arena, size) : malloc(size));
+
+  if(gpxData == NULL){
+    return false;
+  }
+
+  if(insertBack(otherData, (void *) fillGPXData(gpxData, sharedName, childName, value)) == false){
+    otherData->deleteData(gpxData);
+    return false;
+  }
+
+  return true;
+}
+
+/* **************************************************************************DOM WALK******************************************************************************************* */
+
+// Returns the value of an attribute without copying it, or an empty string if the attribute is missing. GPX's attributes are
+// unqualified, so one in a namespace (x:lat) is someone else's and is skipped, as the streaming reader and the tokenizer do.
+char * findAttribute(xmlNode * node, char * attrName){
+  xmlAttr * attr;
+
+  for(attr = node->properties; attr != NULL; attr = attr->next){
+    if(attr->ns == NULL && attr->children != NULL && strcmp((char *) attr->name, attrName) == EQUAL_STRINGS){
+      return (char *) attr->children->content;
+    }
+  }
+
+  return "\0";
+}
+
+// Reads the simple children of a waypoint, route or track into its name, typed fields (waypoint is NULL for the others) and otherData.
+// Structural children (trkseg, rtept) are left for the recursive walk in buildObjects.
+bool buildChildData(xmlNode * parent, GPXElement parentElement, char ** nameField, Waypoint * waypoint, List * otherData){
+  xmlNode * child;
+
+  for(child = parent->children; child != NULL; child = child->next){
+    if(child->type != XML_ELEMENT_NODE || isStructuralChild(parentElement, classifyGPXElement((char *) child->name))){
+      continue;
+    }
+
+    xmlChar * content = xmlNodeGetContent(child);
+    bool added = addChildData(nameField, waypoint, otherData, (char *) child->name, (content == NULL) ? "\0" : (char *) content);
+
+    xmlFree(content);
+
+    if(added == false){
+      return false;
+    }
+  }
+
+  return true;
+}
 
-        strcpy(rteName, "\0");
+GPXdoc * buildObjects(xmlNode * a_node, GPXdoc * gpx, bool * failed){
+  xmlNode * cur_node = NULL;
+  GPXElement parentElement = GPX_ELEMENT_OTHER;
 
-        if(cur_node->children != NULL){
-          xmlNode * child = cur_node->children->next;
+  if(a_node != NULL && a_node->parent != NULL && a_node->parent->type == XML_ELEMENT_NODE){
+    parentElement = classifyGPXElement((char *) a_node->parent->name);
+  }
 
-          while(child != NULL && child != child->last){
-            xmlChar * content = xmlNodeGetContent(child);
-            if(strcmp((char *) child->name, TEXT) != EQUAL_STRINGS && strcmp((char *) child->name, RTEPT) != EQUAL_STRINGS &&
-               strcmp((char *) child->name, NAME) != EQUAL_STRINGS){
-              gpxDataName = (char *) child->name;
-              gpxDataValue = (char *) content;
+  for (cur_node = a_node; cur_node != NULL; cur_node = cur_node->next) {
+    if (cur_node->type == XML_ELEMENT_NODE){
+      GPXElement element = classifyGPXElement((char *) cur_node->name);
 
-              gpxData = buildGPXData(gpxData, gpxDataName, gpxDataValue);
+      if(isOwnerElement(parentElement) && isStructuralChild(parentElement, element) == false){
+        continue; // A simple child - buildChildData has already stored it, so its subtree isn't walked.
+      }
 
-              if(gpxData == NULL){
-                parseFail = true;
-                return NULL;
-              }
+      if(element == GPX_ELEMENT_TRK){
+        Track * track = openTrack(gpx);
 
-              insertBack(route->otherData, gpxData);
-            }
+        if(track == NULL || buildChildData(cur_node, element, &track->name, NULL, track->otherData) == false){
+          *failed = true;
+        }
+      }
+      else if(element == GPX_ELEMENT_TRKSEG){
+        if(openTrackSegment(gpx) == NULL){
+          *failed = true;
+        }
+      }
+      else if(element == GPX_ELEMENT_RTE){
+        Route * route = openRoute(gpx);
 
-            xmlFree(content);
-            child = child->next;
-          }
+        if(route == NULL || buildChildData(cur_node, element, &route->name, NULL, route->otherData) == false){
+          *failed = true;
         }
+      }
+      else if(element == GPX_ELEMENT_WPT || element == GPX_ELEMENT_TRKPT || element == GPX_ELEMENT_RTEPT){
+        Waypoint * waypoint = openWaypoint(gpx, element, findAttribute(cur_node, LON), findAttribute(cur_node, LAT));
 
-        insertBack(gpx->routes, (void *) route);
+        if(waypoint == NULL || buildChildData(cur_node, element, &waypoint->name, waypoint, waypoint->otherData) == false){
+          *failed = true;
+        }
       }
     }
 
-    if(parseFail == true){
-      return NULL;
+    if(*failed == true){
+      return gpx;
+    }
+
+    gpx = buildObjects(cur_node->children, gpx, failed);
+
+    if(*failed == true){
+      return gpx;
     }
+  }
+
+  return gpx;
+}
+
+// Builds a GPXdoc from the root <gpx> element of a libxml2 tree. Returns NULL if the tree isn't a GPX document.
+GPXdoc * buildGPXdocFromXml(GPXParseContext * ctx, xmlNode * root){
+  if(root == NULL || root->type != XML_ELEMENT_NODE || classifyGPXElement((char *) root->name) != GPX_ELEMENT_GPX){
+    return NULL;
+  }
+
+  char * gpxSchema = (root->ns != NULL) ? (char *) root->ns->href : "\0";
+  GPXdoc * gpx = newGPXdoc(ctx, gpxSchema, findAttribute(root, VERSION), findAttribute(root, CREATOR));
 
-    gpx = buildObjects(cur_node->children, gpx);
+  if(gpx == NULL){
+    return NULL;
+  }
+
+  bool failed = false;
+
+  gpx = buildObjects(root->children, gpx, &failed);
+
+  if(failed == true){
+    deleteGPXdoc(gpx);
+    return NULL;
   }
 
   return gpx;
@@ -606,43 +641,43 @@ GPXdoc * buildObjects(xmlNode * a_node, GPXdoc * gpx){
  *@param fileName - a string containing the name of the GPX file
 **/
 GPXdoc * createGPXdoc(char* fileName){
+  return createGPXdocCtx(NULL, fileName);
+}
+
+// Reads a file into a libxml2 tree and builds the GPXdoc from it. Errors are left to the caller's context.
+GPXdoc * readGPXdocFile(GPXParseContext * ctx, char * fileName){
     xmlDoc * doc = NULL;
     xmlNode * root_element = NULL;
-    
-    GPXdoc * gpx = (GPXdoc *) malloc(sizeof(GPXdoc));
-
-    if(gpx == NULL || fileName == NULL){
-      free(gpx);
-      return NULL;
-    }
+    GPXdoc * gpx = NULL;
 
     LIBXML_TEST_VERSION
 
     /*parse the file and get the DOM */
-    doc = xmlReadFile(fileName, NULL, 0);
+    doc = xmlReadFile(fileName, NULL, contextXmlOptions(ctx));
 
     if (doc == NULL) {
-      xmlFreeDoc(doc);
-      xmlCleanupParser();
       return NULL;
     }
 
     /*Get the root element node */
     root_element = xmlDocGetRootElement(doc);
     
-    gpx = buildObjects(root_element, gpx);
+    gpx = buildGPXdocFromXml(ctx, root_element);
 
-    if(parseFail == true){
-      deleteGPXdoc(gpx);
-      xmlFreeDoc(doc);
-      xmlCleanupParser();
-      return NULL;
-    }
-    else{
-      xmlFreeDoc(doc);
-      xmlCleanupParser();
-      return gpx;
-    }
+    xmlFreeDoc(doc);
+
+    return gpx;
+}
+
+GPXdoc * createGPXdocCtx(GPXParseContext * ctx, char * fileName){
+  beginGPXParse(ctx);
+
+  if(fileName == NULL){
+    setGPXParseError(ctx, GPX_ERROR_ARGUMENT, NULL);
+    return finishGPXParse(ctx, NULL);
+  }
+
+  return finishGPXParse(ctx, readGPXdocFile(ctx, fileName));
 }
 
 /** Function to create a string representation of an GPX object.
@@ -742,6 +777,15 @@ void deleteGPXdoc(GPXdoc* doc){
     return;
   }
 
+  GPXArena * arena = listArena(doc->waypoints);
+
+  deleteGPXNameIndex(doc->nameIndex);
+
+  if(arena != NULL){ // Everything is in the arena's blocks, or has been adopted by it.
+    deleteGPXArena(arena);
+    return;
+  }
+
   free(doc->creator);
   freeList(doc->waypoints);
   freeList(doc->routes);
@@ -760,203 +804,100 @@ They all share the same format and only differ in what they have to count.
 
 //Total number of waypoints in the GPX file
 int getNumWaypoints(const GPXdoc* doc){
-  int waypointCount = 0;
-  
-  if(doc == NULL){
-    return waypointCount;    
-  }
-
-  void * element;
-  ListIterator iterator = createIterator(doc->waypoints);
-  
-	while ((element = nextElement(&iterator)) != NULL){
-    waypointCount++;
-  }
-
-  return waypointCount;
+  return (doc == NULL) ? 0 : getLength(doc->waypoints);
 }
 
 //Total number of routes in the GPX file
 int getNumRoutes(const GPXdoc* doc){
-  int routeCount = 0;
-  
-  if(doc == NULL){
-    return routeCount;
-  }
-
-  void * element;
-  ListIterator iterator = createIterator(doc->routes);
-  
-	while ((element = nextElement(&iterator)) != NULL){
-    routeCount++;
-  }
-
-  return routeCount;
+  return (doc == NULL) ? 0 : getLength(doc->routes);
 }
 
 int getNumRouteWaypoints(const Route * route){
-  if(route == NULL){
-    return 0;
-  }
- 
-  int numWaypoints = 0;
-
-  ListIterator iterator = createIterator(route->waypoints);
-  void * element;
-
-  while((element = nextElement(&iterator)) != NULL){
-    numWaypoints++;
-  }
-  
-  return numWaypoints;
+  return (route == NULL) ? 0 : getLength(route->waypoints);
 }
 
 //Total number of tracks in the GPX file
 int getNumTracks(const GPXdoc* doc){
-  int trackCount = 0;
-
-  if(doc == NULL){
-    return trackCount;
-  }
-
-  void * element;
-  ListIterator iterator = createIterator(doc->tracks);
-  
-	while ((element = nextElement(&iterator)) != NULL){
-    trackCount++;
-  }
-
-  return trackCount;
+  return (doc == NULL) ? 0 : getLength(doc->tracks);
 }
 
 //Total number of segments in all tracks in the document
 int getNumSegments(const GPXdoc* doc){
-  int segmentCount = 0;
-
-  if(doc == NULL){
-    return segmentCount;
-  }
-  
-  ListIterator iterator = createIterator(doc->tracks);
-  void * element;
+  return (doc == NULL) ? 0 : doc->numSegments;
+}
 
-  while ((element = nextElement(&iterator)) != NULL){
-    Track * track = (Track *) element;
-    ListIterator iterator2 = createIterator(track->segments);
-    void * element2;
+// The GPXData a waypoint counts for: its name (if it has one), its typed elevation and time, each of which stands for the
+// GPXData it was read from, and its otherData.
+int countWaypointGPXData(const Waypoint * waypoint){
+  int gpxDataCount = getLength(waypoint->otherData);
 
-    while ((element2 = nextElement(&iterator2)) != NULL){
-      segmentCount++;
-    }
-  }
+  gpxDataCount += (strcmp(waypoint->name, "\0") != EQUAL_STRINGS) ? 1 : 0;
+  gpxDataCount += (isnan(waypoint->elevation) == true) ? 0 : 1;
+  gpxDataCount += (waypoint->time == GPX_NO_TIME) ? 0 : 1;
 
-  return segmentCount;
+  return gpxDataCount;
 }
 
-//Total number of GPXData elements in the document
-int getNumGPXData(const GPXdoc* doc){
+// The GPXData of a list of waypoints.
+int countWaypointListGPXData(List * waypoints){
   int gpxDataCount = 0;
-
-  if(doc == NULL){
-    return gpxDataCount;
-  }
-
-  ListIterator iterator = createIterator(doc->waypoints);
+  ListIterator iterator = createIterator(waypoints);
   void * element;
-  
-  // Count waypoint instances.
-  while ((element = nextElement(&iterator)) != NULL){
-    Waypoint * waypoint = (Waypoint *) element;
-
-    if(strcmp(waypoint->name, "\0") != EQUAL_STRINGS){
-      gpxDataCount++;
-    }
-        
-    ListIterator iterator2 = createIterator(waypoint->otherData);
-    void * element2;
 
-    while ((element2 = nextElement(&iterator2)) != NULL){
-      gpxDataCount++;
-    }
+  while((element = nextElement(&iterator)) != NULL){
+    gpxDataCount += countWaypointGPXData((Waypoint *) element);
   }
 
-  // Count Track instances.
-  iterator = createIterator(doc->tracks);
-  while ((element = nextElement(&iterator)) != NULL){
-    Track * track = (Track *) element;
-
-    if(strcmp(track->name, "\0") != EQUAL_STRINGS){
-      gpxDataCount++;
-    }
-        
-    ListIterator iterator2 = createIterator(track->otherData);
-    void * element2;
-
-    while ((element2 = nextElement(&iterator2)) != NULL){
-      gpxDataCount++;
-    }
-
-    ListIterator iterator3 = createIterator(track->segments);
-    void * element3;
-
-    while((element3 = nextElement(&iterator3)) != NULL){
-      TrackSegment * trackSegment = (TrackSegment *) element3;
-      ListIterator iterator4 = createIterator(trackSegment->waypoints);
-      void * element4;
+  return gpxDataCount;
+}
 
-      while((element4 = nextElement(&iterator4)) != NULL){
-        Waypoint * waypoint = (Waypoint *) element4;
+// The GPXData of a route: its name, its otherData and its points'.
+int countRouteGPXData(const Route * route){
+  int gpxDataCount = getLength(route->otherData) + countWaypointListGPXData(route->waypoints);
 
-        if(strcmp(waypoint->name, "\0") != EQUAL_STRINGS){
-          gpxDataCount++;
-        }
+  return gpxDataCount + ((strcmp(route->name, "\0") != EQUAL_STRINGS) ? 1 : 0);
+}
 
-        ListIterator iterator5 = createIterator(waypoint->otherData);
-        void * element5;
+//Total number of GPXData elements in the document
+int getNumGPXData(const GPXdoc* doc){
+  return (doc == NULL) ? 0 : doc->numGPXData;
+}
 
-        while((element5 = nextElement(&iterator5)) != NULL){
-          gpxDataCount++;
-        }
-      }
-    }
+void updateGPXdocCounts(GPXdoc * doc){
+  if(doc == NULL){
+    return;
   }
 
-  // Count Route instances
-  iterator = createIterator(doc->routes);
-
-  while((element = nextElement(&iterator)) != NULL){
-    Route * route = (Route *) element;
-
-    if(strcmp(route->name, "\0") != EQUAL_STRINGS){
-      gpxDataCount++;
-    }
+  dropGPXNameIndex(doc);
+  doc->numSegments = 0;
+  doc->numGPXData = countWaypointListGPXData(doc->waypoints);
 
-    void * element2;
-    ListIterator iterator2 = createIterator(route->otherData);
+  ListIterator iterator = createIterator(doc->routes);
+  void * element;
 
-    while((element2 = nextElement(&iterator2)) != NULL){
-      gpxDataCount++;
-    }
+  while((element = nextElement(&iterator)) != NULL){
+    Route * route = (Route *) element;
 
-    iterator2 = createIterator(route->waypoints);
+    route->doc = doc;
+    route->summary.isCurrent = false; // Its points may have been moved in place.
+    doc->numGPXData += countRouteGPXData(route);
+  }
 
-    while((element2 = nextElement(&iterator2)) != NULL){
-      Waypoint * waypoint = (Waypoint *) element2;
+  iterator = createIterator(doc->tracks);
 
-      if(strcmp(waypoint->name, "\0") != EQUAL_STRINGS){
-        gpxDataCount++;
-      }
+  while((element = nextElement(&iterator)) != NULL){
+    Track * track = (Track *) element;
+    ListIterator iterator2 = createIterator(track->segments);
+    void * element2;
 
-      ListIterator iterator3 = createIterator(waypoint->otherData);
-      void * element3;
+    track->summary.isCurrent = false;
+    doc->numSegments += getLength(track->segments);
+    doc->numGPXData += getLength(track->otherData) + ((strcmp(track->name, "\0") != EQUAL_STRINGS) ? 1 : 0);
 
-      while((element3 = nextElement(&iterator3)) != NULL){
-        gpxDataCount++;
-      }
+    while((element2 = nextElement(&iterator2)) != NULL){
+      doc->numGPXData += countWaypointListGPXData(((TrackSegment *) element2)->waypoints);
     }
   }
-
-  return gpxDataCount;
 }
 
 // Function that returns a waypoint with the given name.  If more than one exists, return the first one.  
@@ -967,7 +908,14 @@ Waypoint* getWaypoint(const GPXdoc* doc, char* name){
   if(doc == NULL || name == NULL){
     return NULL;
   }
-  
+
+  const GPXNameIndex * index = gpxNameIndex(doc);
+
+  if(index != NULL){
+    return findIndexedWaypoint(index, name);
+  }
+
+  // Without an index (if there wasn't the memory for one), scan the points in the order the index would have.
   // THIS LINE JUST COST ME 21%!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!! 
   ListIterator iterator = createIterator(doc->waypoints);
 
@@ -1026,6 +974,12 @@ Track* getTrack(const GPXdoc* doc, char* name){
     return NULL;
   }
 
+  const GPXNameIndex * index = gpxNameIndex(doc);
+
+  if(index != NULL){
+    return findIndexedTrack(index, name);
+  }
+
   ListIterator iterator = createIterator(doc->tracks);
   void * element;
 
@@ -1046,7 +1000,13 @@ Route* getRoute(const GPXdoc* doc, char* name){
   if(doc == NULL || name == NULL){
     return NULL;
   }
-  
+
+  const GPXNameIndex * index = gpxNameIndex(doc);
+
+  if(index != NULL){
+    return findIndexedRoute(index, name);
+  }
+
   ListIterator iterator = createIterator(doc->routes);
   void * element;
 
@@ -1109,7 +1069,11 @@ int compareGpxData(const void *first, const void *second){
 	gpxData1 = (GPXData *) first;
 	gpxData2 = (GPXData *) second;
 	
-	return strcmp((char *)gpxData1->name, (char *)gpxData2->name);
+	if (gpxData1->name == gpxData2->name){
+		return 0;
+	}
+
+	return strcmp(gpxData1->name, gpxData2->name);
 }
 
 void deleteWaypoint(void * data){
@@ -1148,6 +1112,33 @@ char * waypointToString(void * data){
 
 	sprintf(tmpStr, "\tWaypoint:\n\tname: %s\n\tlat: %f lon: %f\n\n", waypoint->name, waypoint->latitude, waypoint->longitude);
 
+  // The typed fields are printed the way their GPXData would be.
+  char typedBuff[DOUBLE_CHARS];
+
+  if(isnan(waypoint->elevation) == false){
+    formatGPXNumber(waypoint->elevation, typedBuff);
+    len += strlen(typedBuff) + 40;
+    tmpStr = (char *) realloc(tmpStr, len);
+
+    if(tmpStr == NULL){
+      return NULL;
+    }
+
+    sprintf(tmpStr + strlen(tmpStr), "\tgpxData name: %s gpxData value: %s\n\n", ELE, typedBuff);
+  }
+
+  if(waypoint->time != GPX_NO_TIME){
+    formatGPXTime(waypoint->time, typedBuff);
+    len += strlen(typedBuff) + 40;
+    tmpStr = (char *) realloc(tmpStr, len);
+
+    if(tmpStr == NULL){
+      return NULL;
+    }
+
+    sprintf(tmpStr + strlen(tmpStr), "\tgpxData name: %s gpxData value: %s\n\n", TIME, typedBuff);
+  }
+
   ListIterator iterator = createIterator(waypoint->otherData);
   void * element2;
 
@@ -1474,6 +1465,13 @@ xmlNode * ConvertGPXDataToXml(xmlNode * parent, GPXData * gpxData){
   return gpxDataChild; // To supress warning. The node should already be connected.
 }
 
+bool precedesWaypointName(const char * name){
+  const char * sharedName = internGPXName(name);
+
+  return sharedName == gpxDataNames[GPX_NAME_ELE] || sharedName == gpxDataNames[GPX_NAME_TIME] ||
+         sharedName == gpxDataNames[GPX_NAME_MAGVAR] || sharedName == gpxDataNames[GPX_NAME_GEOIDHEIGHT];
+}
+
 void ConvertWaypointToXml(xmlNode * parent, Waypoint * waypoint, char * wptType){
   char latBuff[MAX_READ_CHARS];
   char lonBuff[MAX_READ_CHARS];
@@ -1486,18 +1484,39 @@ void ConvertWaypointToXml(xmlNode * parent, Waypoint * waypoint, char * wptType)
   xmlNewProp(newWpt, BAD_CAST LAT, BAD_CAST latBuff);
   xmlNewProp(newWpt, BAD_CAST LON, BAD_CAST lonBuff);  
 
-  if(strcmp(waypoint->name, "\0") != EQUAL_STRINGS){
-    xmlNewChild(newWpt, NULL, BAD_CAST NAME, BAD_CAST waypoint->name);
+  // The children go in gpx.xsd's order: the typed elevation and time first, then the name after whichever of otherData
+  // (magvar, geoidheight, or an ele or time that wasn't readable) comes before it, then the rest of otherData.
+  char typedBuff[DOUBLE_CHARS];
+
+  if(isnan(waypoint->elevation) == false){
+    formatGPXNumber(waypoint->elevation, typedBuff);
+    xmlNewChild(newWpt, NULL, BAD_CAST ELE, BAD_CAST typedBuff);
+  }
+
+  if(waypoint->time != GPX_NO_TIME){
+    formatGPXTime(waypoint->time, typedBuff);
+    xmlNewChild(newWpt, NULL, BAD_CAST TIME, BAD_CAST typedBuff);
   }
 
+  bool namePending = (strcmp(waypoint->name, "\0") != EQUAL_STRINGS);
   ListIterator iterator = createIterator(waypoint->otherData);
   GPXData * gpxData;
   void * element;
 
   while((element = nextElement(&iterator)) != NULL){
     gpxData = (GPXData *) element;
+
+    if(namePending == true && precedesWaypointName(gpxData->name) == false){
+      xmlNewChild(newWpt, NULL, BAD_CAST NAME, BAD_CAST waypoint->name);
+      namePending = false;
+    }
+
     ConvertGPXDataToXml(newWpt, gpxData);
   }
+
+  if(namePending == true){
+    xmlNewChild(newWpt, NULL, BAD_CAST NAME, BAD_CAST waypoint->name);
+  }
 }
 
 void ConvertTrackSegmentToXml(xmlNode * parent, TrackSegment * trackSegment){
@@ -1631,53 +1650,8 @@ xmlDoc * ConvertGPXDocToXmlDoc(GPXdoc * gpx){
   return doc;
 }
 
-bool validateXmlDoc(xmlDoc * doc, char * gpxSchemaFile){
-  bool isValidXml = false;
-
-  xmlSchema * schema = NULL;
-  xmlSchemaParserCtxtPtr context;
-
-  xmlLineNumbersDefault(1);
-  context = xmlSchemaNewParserCtxt(gpxSchemaFile);
-
-  xmlSchemaSetParserErrors(context, (xmlSchemaValidityErrorFunc) fprintf, (xmlSchemaValidityWarningFunc) fprintf, stderr);
-  schema = xmlSchemaParse(context);
-
-  xmlSchemaFreeParserCtxt(context);
-
-  xmlSchemaValidCtxtPtr valContext;
-
-  valContext = xmlSchemaNewValidCtxt(schema);
-  xmlSchemaSetValidErrors(valContext, (xmlSchemaValidityErrorFunc) fprintf, (xmlSchemaValidityWarningFunc) fprintf, stderr);
-
-  int retVal = -1;
-
-  retVal = xmlSchemaValidateDoc(valContext, doc);
-
-  if(retVal > 0){
-    isValidXml = false;
-  }
-  else if (retVal == 0){
-    isValidXml = true;
-  }
-  else{
-    printf("Something else went wrong....\n");
-  }
-
-  if(schema != NULL){
-    xmlSchemaFree(schema);
-  }
-
-  xmlFree(valContext);
-  xmlSchemaCleanupTypes();
-  xmlCleanupParser();
-  xmlMemoryDump();
-
-  return isValidXml; // Will return false in the else case since it doesn't change the boolean's value.
-}
-
 bool validateGPXData(GPXData * gpxData){
-  if(strcmp(gpxData->name, "\0") == EQUAL_STRINGS || strcmp(gpxData->value, "\0") == EQUAL_STRINGS){
+  if(gpxData->name == NULL || strcmp(gpxData->name, "\0") == EQUAL_STRINGS || strcmp(gpxData->value, "\0") == EQUAL_STRINGS){
     return false;
   }
 
@@ -1878,25 +1852,65 @@ bool IsValidGPXdoc(GPXdoc * gpx){
  *@param fileName - a string containing the name of the GPX file
 **/
 GPXdoc* createValidGPXdoc(char* fileName, char* gpxSchemaFile){
-  bool validXml = false;
+  return createValidGPXdocCtx(NULL, fileName, gpxSchemaFile);
+}
+
+// Reads fileName and validates it against schema, then builds the GPXdoc from the tree that was validated - the file is only
+// parsed once. Validation doesn't change the tree, so the result is what createGPXdoc would build.
+GPXdoc * readValidGPXdocFile(GPXParseContext * ctx, char * fileName, const GPXSchema * schema){
   GPXdoc * gpx = NULL;
 
-  xmlDoc * xDoc = xmlReadFile(fileName, NULL, 0);
+  LIBXML_TEST_VERSION
 
-  validXml = validateXmlDoc(xDoc, gpxSchemaFile);
+  xmlDoc * xDoc = xmlReadFile(fileName, NULL, contextXmlOptions(ctx));
 
-  if(validXml == false){
+  if(xDoc == NULL){
     return NULL;
   }
-  else{
-    gpx = createGPXdoc(fileName);
 
-    if(gpx == NULL){ // Probably redundant, but meh. I put it there to be pedantic.
-      return NULL;
-    }
-            
-    return gpx;
+  if(validateXmlDocWithSchema(ctx, xDoc, schema) == true){
+    gpx = buildGPXdocFromXml(ctx, xmlDocGetRootElement(xDoc));
+  }
+
+  xmlFreeDoc(xDoc);
+
+  return gpx;
+}
+
+GPXdoc * createValidGPXdocCtx(GPXParseContext * ctx, char * fileName, char * gpxSchemaFile){
+  beginGPXParse(ctx);
+
+  if(fileName == NULL || gpxSchemaFile == NULL){
+    setGPXParseError(ctx, GPX_ERROR_ARGUMENT, NULL);
+    return finishGPXParse(ctx, NULL);
+  }
+
+  GPXSchema * schema = loadGPXSchema(ctx, gpxSchemaFile);
+
+  if(schema == NULL){
+    return finishGPXParse(ctx, NULL);
+  }
+
+  GPXdoc * gpx = readValidGPXdocFile(ctx, fileName, schema);
+
+  gpxSchemaFree(schema);
+
+  return finishGPXParse(ctx, gpx);
+}
+
+GPXdoc * createValidGPXdocWithSchemaCtx(GPXParseContext * ctx, char * fileName, GPXSchema * schema){
+  beginGPXParse(ctx);
+
+  if(fileName == NULL || schema == NULL){
+    setGPXParseError(ctx, GPX_ERROR_ARGUMENT, NULL);
+    return finishGPXParse(ctx, NULL);
   }
+
+  return finishGPXParse(ctx, readValidGPXdocFile(ctx, fileName, schema));
+}
+
+GPXdoc * createValidGPXdocWithSchema(char * fileName, GPXSchema * schema){
+  return createValidGPXdocWithSchemaCtx(NULL, fileName, schema);
 }
 
 /** Function to validating an existing a GPXobject object against a GPX schema file
@@ -1909,32 +1923,59 @@ GPXdoc* createValidGPXdoc(char* fileName, char* gpxSchemaFile){
  *@param gpxSchemaFile - the name of a schema file
  **/
 bool validateGPXDoc(GPXdoc * doc, char * gpxSchemaFile){
-  bool validXml = false;
-  bool validGPXdoc = false;
+  return validateGPXDocCtx(NULL, doc, gpxSchemaFile);
+}
 
-  if(doc == NULL || gpxSchemaFile == NULL || strcmp(gpxSchemaFile, "\0") == EQUAL_STRINGS){
-    return false;
-  }
+// Converts doc back to XML and checks it against schema, then checks the constraints the schema can't express.
+bool checkGPXdocAgainstSchema(GPXParseContext * ctx, GPXdoc * doc, const GPXSchema * schema){
+  bool validXml = false;
 
   xmlDoc * xDoc = ConvertGPXDocToXmlDoc(doc);
 
   if(xDoc == NULL){
+    setGPXParseError(ctx, GPX_ERROR_MEMORY, NULL);
     return false;
   }
 
-  validXml = validateXmlDoc(xDoc, gpxSchemaFile);
+  validXml = validateXmlDocWithSchema(ctx, xDoc, schema);
 
-  if(validXml == false){
-    return false;
+  xmlFreeDoc(xDoc);
+
+  return validXml == true && IsValidGPXdoc(doc) == true;
+}
+
+bool validateGPXDocCtx(GPXParseContext * ctx, GPXdoc * doc, char * gpxSchemaFile){
+  beginGPXParse(ctx);
+
+  if(doc == NULL || gpxSchemaFile == NULL || strcmp(gpxSchemaFile, "\0") == EQUAL_STRINGS){
+    return finishGPXCall(ctx, false, GPX_ERROR_ARGUMENT);
   }
-  
-  validGPXdoc = IsValidGPXdoc(doc);
 
-  if(validGPXdoc == false){
-    return false;
+  GPXSchema * schema = loadGPXSchema(ctx, gpxSchemaFile);
+
+  if(schema == NULL){
+    return finishGPXCall(ctx, false, GPX_ERROR_SCHEMA);
   }
-  
-  return true;
+
+  bool validGPXdoc = checkGPXdocAgainstSchema(ctx, doc, schema);
+
+  gpxSchemaFree(schema);
+
+  return finishGPXCall(ctx, validGPXdoc, GPX_ERROR_INVALID);
+}
+
+bool validateGPXDocWithSchemaCtx(GPXParseContext * ctx, GPXdoc * doc, GPXSchema * schema){
+  beginGPXParse(ctx);
+
+  if(doc == NULL || schema == NULL){
+    return finishGPXCall(ctx, false, GPX_ERROR_ARGUMENT);
+  }
+
+  return finishGPXCall(ctx, checkGPXdocAgainstSchema(ctx, doc, schema), GPX_ERROR_INVALID);
+}
+
+bool validateGPXDocWithSchema(GPXdoc * doc, GPXSchema * schema){
+  return validateGPXDocWithSchemaCtx(NULL, doc, schema);
 }
 
 /** Function to writing a GPXdoc into a file in GPX format.
@@ -1958,6 +1999,8 @@ bool writeGPXdoc(GPXdoc * doc, char * filename){
   int retVal = -1;
 
   retVal = xmlSaveFormatFileEnc(filename, xDoc, "UTF-8", 1);
+
+  xmlFreeDoc(xDoc);
   
   if(retVal == -1){ // Then there was an error.
     return false;
@@ -1996,53 +2039,55 @@ float round10(float len){
 }
 
 float getRouteLen(const Route * rt){
-  if(rt == NULL){
+  return (float) getRouteLenWithModel(rt, GPX_DISTANCE_HAVERSINE);
+}
+
+double getRouteLenWithModel(const Route * rt, GPXDistanceModel model){
+  if(rt == NULL || isGPXDistanceModel(model) == false){
     return 0;
   }
-  
-  int count = 0;
-  float tempLat = 0.0;
-  float tempLon = 0.0;
-  float routeLength = 0.0;
 
+  // The haversine length is kept in the summary.
+  if(model == GPX_DISTANCE_HAVERSINE){
+    return routeSummary(rt).length;
+  }
+  
+  PathLength path;
   void * element;
   ListIterator iterator = createIterator(rt->waypoints);
-  
+
+  initPathLength(&path, model);
+
 	while ((element = nextElement(&iterator)) != NULL){
     Waypoint * wpt = (Waypoint *) element;
-    //lat: %f\tlon: %f\n", wpt->latitude, wpt->longitude);
-
-    if(count == 0){
-      tempLat = wpt->latitude;
-      tempLon = wpt->longitude;
-    }
-    else{
-      routeLength += computeDistanceBetweenWaypoints(tempLat, tempLon, wpt->latitude, wpt->longitude);
-      tempLat = wpt->latitude;
-      tempLon = wpt->longitude;
-    }
 
-    count++;
+    addPathPoint(&path, wpt->latitude, wpt->longitude);
   }
 
-  return routeLength;
+  return finishPathLength(&path);
 }
 
 float getTrackLen(const Track * tr){
-  if(tr == NULL){
+  return (float) getTrackLenWithModel(tr, GPX_DISTANCE_HAVERSINE);
+}
+
+double getTrackLenWithModel(const Track * tr, GPXDistanceModel model){
+  if(tr == NULL || isGPXDistanceModel(model) == false){
     return 0;
   }
 
-  int count = 0;
-  int segCount = 0;
-  float trackLength = 0.0;
-  float tempLat = 0.0;
-  float tempLon = 0.0;
-   
+  // The haversine length is kept in the summary.
+  if(model == GPX_DISTANCE_HAVERSINE){
+    return trackSummary(tr).length;
+  }
 
+  // The segments are measured as one path, including the hops from the end of each to the start of the next.
+  PathLength path;
   void * element;
   ListIterator iterator = createIterator(tr->segments);
-  
+
+  initPathLength(&path, model);
+
 	while ((element = nextElement(&iterator)) != NULL){
     TrackSegment * trSeg = (TrackSegment *) element;
 
@@ -2052,23 +2097,11 @@ float getTrackLen(const Track * tr){
     while((element2 = nextElement(&iterator2)) != NULL){
       Waypoint * wpt = (Waypoint *) element2;
 
-      if(count == 0 && segCount == 0){ // If its the very first waypoint, then just write to the temp vals and continue on.
-        tempLat = wpt->latitude;
-        tempLon = wpt->longitude;
-      }
-      else{
-        trackLength += computeDistanceBetweenWaypoints(tempLat, tempLon, wpt->latitude, wpt->longitude);
-        tempLat = wpt->latitude;
-        tempLon = wpt->longitude;
-      }
-
-      count++;
+      addPathPoint(&path, wpt->latitude, wpt->longitude);
     }
-
-    segCount++;
   }
 
-  return trackLength;
+  return finishPathLength(&path);
 }
 
 int numRoutesWithLength(const GPXdoc * doc, float len, float delta){
@@ -2129,34 +2162,11 @@ bool isLoopRoute(const Route * rt, float delta){
     return false;
   }
 
-  int numWaypoints = 0;
-
-  float firstLat = 0.0;
-  float firstLon = 0.0;
-  
-  float lastLat = 0.0;
-  float lastLon = 0.0;
-
-  ListIterator iterator = createIterator(rt->waypoints);
-  void * element;
-
-  while((element = nextElement(&iterator)) != NULL){
-    Waypoint * wpt = (Waypoint *) element;
-
-    if(numWaypoints == 0){
-      firstLat = wpt->latitude;
-      firstLon = wpt->longitude;
-    }
-    else{
-      lastLat = wpt->latitude;
-      lastLon = wpt->longitude;
-    }
+  GPXPathSummary summary = routeSummary(rt);
 
-    numWaypoints++;
-  }
-  
-  if(numWaypoints >= MIN_LOOP_WPTS){
-    float distance = computeDistanceBetweenWaypoints(firstLat, firstLon, lastLat, lastLon);
+  if(summary.numPoints >= MIN_LOOP_WPTS){
+    float distance = computeDistanceBetweenWaypoints(summary.firstLatitude, summary.firstLongitude, summary.lastLatitude,
+                                                     summary.lastLongitude);
      
     if(distance <= delta){
       return true;
@@ -2171,42 +2181,11 @@ bool isLoopTrack(const Track * tr, float delta){
     return false;
   }
 
-  int numWaypoints = 0;
-
-  float firstLat = 0.0;
-  float firstLon = 0.0;
-  
-  float lastLat = 0.0;
-  float lastLon = 0.0;
-
-  ListIterator iterator = createIterator(tr->segments);
-  void * element;
-
-  while((element = nextElement(&iterator)) != NULL){
-    TrackSegment * trSeg = (TrackSegment *) element;
-
-    ListIterator iterator2 = createIterator(trSeg->waypoints);
-    void * element2;
-
-    while((element2 = nextElement(&iterator2)) != NULL){
-      Waypoint * wpt = NULL;
-      wpt = (Waypoint *) element2;
-      
-      if(numWaypoints == 0){
-        firstLat = wpt->latitude;
-        firstLon = wpt->longitude;
-      }
-      else{
-        lastLat = wpt->latitude;
-        lastLon = wpt->longitude;
-      }
+  GPXPathSummary summary = trackSummary(tr);
 
-      numWaypoints++;
-    }
-  }
-  
-  if(numWaypoints >= MIN_LOOP_WPTS){
-    float distance = computeDistanceBetweenWaypoints(firstLat, firstLon, lastLat, lastLon);
+  if(summary.numPoints >= MIN_LOOP_WPTS){
+    float distance = computeDistanceBetweenWaypoints(summary.firstLatitude, summary.firstLongitude, summary.lastLatitude,
+                                                     summary.lastLongitude);
      
     if(distance <= delta){
       return true;
@@ -2524,7 +2503,26 @@ void addWaypoint(Route * rt, Waypoint * pt){
     return;
   }
 
-  insertBack(rt->waypoints, (void *) pt);
+  GPXArena * arena = listArena(rt->waypoints);
+
+  // A route in an arena document can't free its points, so the arena takes this one over.
+  if(arena != NULL && adoptArenaObject(arena, pt, deleteWaypoint) == false){
+    return;
+  }
+
+  if(insertBack(rt->waypoints, (void *) pt) == false){ // Out of memory - pt is left with the caller.
+    if(arena != NULL){
+      disownArenaObject(arena, pt);
+    }
+
+    return;
+  }
+
+  // The insert moved the waypoints list's change count, which is what marks the route's summary stale.
+  if(rt->doc != NULL){
+    rt->doc->numGPXData += countWaypointGPXData(pt);
+    indexAddedWaypoint(rt->doc, rt, pt);
+  }
 }  
 
 void addRoute(GPXdoc * doc, Route * rt){
@@ -2532,7 +2530,23 @@ void addRoute(GPXdoc * doc, Route * rt){
     return;
   }
 
-  insertBack(doc->routes, (void *) rt);
+  GPXArena * arena = listArena(doc->routes);
+
+  if(arena != NULL && adoptArenaObject(arena, rt, deleteRoute) == false){
+    return;
+  }
+
+  if(insertBack(doc->routes, (void *) rt) == false){ // Out of memory - rt is left with the caller.
+    if(arena != NULL){
+      disownArenaObject(arena, rt);
+    }
+
+    return;
+  }
+
+  rt->doc = doc;
+  doc->numGPXData += countRouteGPXData(rt);
+  indexAddedRoute(doc, rt);
 }
 
 char * TrimParentheses(char * str){
@@ -2588,7 +2602,7 @@ GPXdoc * JSONtoGPX(const char * gpxString){
 
   GPXdoc * doc = NULL;
 
-  doc = buildGPXdoc(doc, DEFAULT_NAMESPACE, version, creator);
+  doc = buildGPXdoc(doc, DEFAULT_NAMESPACE, version, creator, NULL);
 
   return doc;
 }
@@ -2636,7 +2650,7 @@ Waypoint * JSONtoWaypoint(const char * gpxString){
 
   Waypoint * wpt = NULL;
 
-  wpt = buildWaypoint(wpt, "\0", lonStr, latStr);
+  wpt = buildWaypoint(wpt, "\0", lonStr, latStr, NULL);
 
   return wpt;
 }
@@ -2666,7 +2680,7 @@ Route * JSONtoRoute(const char * gpxString){
 
   Route * rte = NULL;
 
-  rte = buildRoute(rte, name);
+  rte = buildRoute(rte, name, NULL);
 
   return rte;
 }
@@ -2753,10 +2767,31 @@ bool createGPXFileFromJSON(char * filename, char * creator, char * version, char
     return false;
   }
 
-  GPXdoc * newGpx = NULL;
-  newGpx = buildGPXdoc(newGpx, DEFAULT_NAMESPACE, version, creator);
+  GPXSchema * schema = gpxSchemaLoad(gpxSchemaFile);
+  bool created = createGPXFileFromJSONWithSchema(filename, creator, version, schema);
+
+  gpxSchemaFree(schema);
+
+  return created;
+}
+
+bool createGPXFileFromJSONWithSchema(char * filename, char * creator, char * version, GPXSchema * schema){
+  if(filename == NULL || creator == NULL || version == NULL || schema == NULL){
+    return false;
+  }
+
+  if(strcmp(filename, "\0") == EQUAL_STRINGS || strcmp(creator, "\0") == EQUAL_STRINGS || strcmp(version, "\0") == EQUAL_STRINGS){
+    return false;
+  }
+
+  GPXdoc * newGpx = (GPXdoc *) malloc(sizeof(GPXdoc));
+  newGpx = buildGPXdoc(newGpx, DEFAULT_NAMESPACE, version, creator, NULL);
 
-  if(validateGPXDoc(newGpx, gpxSchemaFile) == true){
+  if(newGpx == NULL){
+    return false;
+  }
+
+  if(validateGPXDocWithSchema(newGpx, schema) == true){
     if(writeGPXdoc(newGpx, filename) == true){
       deleteGPXdoc(newGpx);
       return true; 
@@ -2798,6 +2833,17 @@ bool isValidGPXFile(char * filename, char * gpxSchemaFile){
   GPXdoc * fileGPX = createGPXdoc(filename);
   bool isValid = validateGPXDoc(fileGPX, gpxSchemaFile);
 
+  deleteGPXdoc(fileGPX);
+
+  return isValid;
+}
+
+bool isValidGPXFileWithSchema(char * filename, GPXSchema * schema){
+  GPXdoc * fileGPX = createGPXdoc(filename);
+  bool isValid = validateGPXDocWithSchema(fileGPX, schema);
+
+  deleteGPXdoc(fileGPX);
+
   return isValid;
 }
 
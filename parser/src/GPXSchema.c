@@ -0,0 +1,129 @@
+/* Filename: GPXSchema.c
+ * Description: Compiled XSD schemas. Parsing gpx.xsd costs more than validating a typical file against it, so a GPXSchema
+ *              is parsed once and then used for as many validations as needed. The compiled xmlSchema is never modified by a
+ *              validation - all of the per-document state lives in a validation context that each call creates for itself -
+ *              so one GPXSchema can be shared by any number of threads at once.
+ */
+
+#include "GPXHelpers.h"
+
+GPXSchema * loadGPXSchema(GPXParseContext * ctx, char * gpxSchemaFile){
+  if(gpxSchemaFile == NULL || strcmp(gpxSchemaFile, "\0") == EQUAL_STRINGS){
+    setGPXParseError(ctx, GPX_ERROR_ARGUMENT, NULL);
+    return NULL;
+  }
+
+  // The first schema may well be loaded before anything has been parsed, so libxml2 may still need setting up.
+  LIBXML_TEST_VERSION
+
+  xmlSchemaParserCtxtPtr context = xmlSchemaNewParserCtxt(gpxSchemaFile);
+
+  if(context == NULL){
+    setGPXParseError(ctx, GPX_ERROR_MEMORY, NULL);
+    return NULL;
+  }
+
+  // With a context, the messages go to the handler beginGPXParse installed instead.
+  if(ctx == NULL){
+    xmlSchemaSetParserErrors(context, (xmlSchemaValidityErrorFunc) fprintf, (xmlSchemaValidityWarningFunc) fprintf, stderr);
+  }
+
+  xmlSchema * compiled = xmlSchemaParse(context);
+
+  xmlSchemaFreeParserCtxt(context);
+
+  if(compiled == NULL){ // libxml2 has already said why.
+    setGPXParseError(ctx, GPX_ERROR_SCHEMA, NULL);
+    return NULL;
+  }
+
+  GPXSchema * schema = (GPXSchema *) malloc(sizeof(GPXSchema));
+
+  if(schema == NULL){
+    xmlSchemaFree(compiled);
+    setGPXParseError(ctx, GPX_ERROR_MEMORY, NULL);
+    return NULL;
+  }
+
+  schema->schema = compiled;
+
+  return schema;
+}
+
+bool validateXmlDocWithSchema(GPXParseContext * ctx, xmlDoc * doc, const GPXSchema * schema){
+  bool isValidXml = false;
+
+  xmlSchemaValidCtxtPtr valContext;
+
+  valContext = xmlSchemaNewValidCtxt(schema->schema);
+
+  if(valContext == NULL){
+    setGPXParseError(ctx, GPX_ERROR_MEMORY, NULL);
+    return false;
+  }
+
+  if(ctx == NULL){
+    xmlSchemaSetValidErrors(valContext, (xmlSchemaValidityErrorFunc) fprintf, (xmlSchemaValidityWarningFunc) fprintf, stderr);
+  }
+
+  int retVal = -1;
+
+  retVal = xmlSchemaValidateDoc(valContext, doc);
+
+  if(retVal > 0){
+    isValidXml = false;
+    setGPXParseError(ctx, GPX_ERROR_INVALID, NULL);
+  }
+  else if (retVal == 0){
+    isValidXml = true;
+  }
+  else if(ctx == NULL){
+    printf("Something else went wrong....\n");
+  }
+  else if(getGPXParseError(ctx) == GPX_OK){
+    setGPXParseError(ctx, GPX_ERROR_SCHEMA, NULL);
+  }
+
+  xmlSchemaFreeValidCtxt(valContext);
+
+  return isValidXml; // Will return false in the else case since it doesn't change the boolean's value.
+}
+
+bool validateXmlDoc(GPXParseContext * ctx, xmlDoc * doc, char * gpxSchemaFile){
+  GPXSchema * schema = loadGPXSchema(ctx, gpxSchemaFile);
+
+  if(schema == NULL){ // Nothing to validate against.
+    return false;
+  }
+
+  bool isValidXml = validateXmlDocWithSchema(ctx, doc, schema);
+
+  gpxSchemaFree(schema);
+
+  return isValidXml;
+}
+
+/* *****************************************************************************PUBLIC API****************************************************************************** */
+
+GPXSchema * gpxSchemaLoadCtx(GPXParseContext * ctx, char * gpxSchemaFile){
+  beginGPXParse(ctx);
+
+  GPXSchema * schema = loadGPXSchema(ctx, gpxSchemaFile);
+
+  finishGPXCall(ctx, schema != NULL, GPX_ERROR_SCHEMA);
+
+  return schema;
+}
+
+GPXSchema * gpxSchemaLoad(char * gpxSchemaFile){
+  return gpxSchemaLoadCtx(NULL, gpxSchemaFile);
+}
+
+void gpxSchemaFree(GPXSchema * schema){
+  if(schema == NULL){
+    return;
+  }
+
+  xmlSchemaFree(schema->schema);
+  free(schema);
+}
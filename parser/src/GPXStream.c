@@ -0,0 +1,674 @@
+/* Filename: GPXStream.c
+ * Description: Streaming parse paths for GPX files. Instead of asking libxml2 for the whole DOM and then walking it (createGPXdoc),
+ *              these drive an xmlTextReader over the input. buildObjectsFromReader fills the GPXdoc structs as the elements go past,
+ *              so only the output model is kept in memory. The builder itself only sees start tags, end tags and text, so the
+ *              hand-written tokenizer in GPXTokenizer.c drives it too. streamEventsFromReader doesn't build anything at all - it hands each
+ *              track, segment, point, route and waypoint to a set of callbacks and forgets it, so its memory use is constant.
+ *
+ * Citations: The reader loop follows the xmlTextReader example at http://xmlsoft.org/examples/reader1.c
+ */
+
+#include "GPXHelpers.h"
+
+#define INITIAL_TEXT_SIZE 64
+
+void initStreamText(StreamText * buffer, const GPXAllocator * allocator){
+  buffer->text = NULL;
+  buffer->len = 0;
+  buffer->size = 0;
+  buffer->allocator = allocator;
+}
+
+void freeStreamText(StreamText * buffer){
+  releaseScratch(buffer->allocator, buffer->text);
+  buffer->text = NULL;
+  buffer->len = 0;
+  buffer->size = 0;
+}
+
+bool appendStreamTextLength(StreamText * buffer, const char * text, size_t len){
+  if(buffer->len + len + 1 > buffer->size){
+    size_t newSize = (buffer->size == 0) ? INITIAL_TEXT_SIZE : buffer->size;
+
+    while(buffer->len + len + 1 > newSize){
+      newSize *= 2;
+    }
+
+    char * newText = (char *) reallocateScratch(buffer->allocator, buffer->text, newSize);
+
+    if(newText == NULL){
+      return false;
+    }
+
+    buffer->text = newText;
+    buffer->size = newSize;
+  }
+
+  memcpy(buffer->text + buffer->len, text, len);
+  buffer->len += len;
+  buffer->text[buffer->len] = '\0';
+
+  return true;
+}
+
+bool appendStreamText(StreamText * buffer, const char * text){
+  return appendStreamTextLength(buffer, text, strlen(text));
+}
+
+// Returns the buffered text, or an empty string if nothing has been buffered since the last reset.
+const char * streamTextValue(StreamText * buffer){
+  return (buffer->len == 0) ? "\0" : buffer->text;
+}
+
+// Returns true for the node types whose value is part of an element's text content.
+bool isStreamTextNode(int nodeType){
+  return nodeType == XML_READER_TYPE_TEXT || nodeType == XML_READER_TYPE_CDATA ||
+         nodeType == XML_READER_TYPE_WHITESPACE || nodeType == XML_READER_TYPE_SIGNIFICANT_WHITESPACE;
+}
+
+// Entities declared in a DTD aren't substituted by the reader. Their text is part of the element's content all the same,
+// which is what xmlNodeGetContent gives the DOM path.
+bool appendEntityText(StreamText * buffer, xmlTextReaderPtr reader){
+  xmlChar * content = xmlNodeGetContent(xmlTextReaderCurrentNode(reader));
+  bool appended = (content == NULL) || appendStreamText(buffer, (const char *) content);
+
+  xmlFree(content);
+
+  return appended;
+}
+
+StreamOwner * currentOwner(StreamState * state){
+  if(state->numOwners == 0){
+    return NULL;
+  }
+
+  return &state->owners[state->numOwners - 1];
+}
+
+bool pushOwner(StreamState * state, GPXElement element, int depth, char ** nameField, Waypoint * waypoint, List * otherData){
+  if(state->numOwners == MAX_OWNER_DEPTH){
+    return false;
+  }
+
+  StreamOwner * owner = &state->owners[state->numOwners];
+
+  owner->element = element;
+  owner->depth = depth;
+  owner->nameField = nameField;
+  owner->waypoint = waypoint;
+  owner->otherData = otherData;
+  state->numOwners++;
+
+  return true;
+}
+
+bool finishStreamChild(StreamState * state){
+  StreamOwner * owner = currentOwner(state);
+  bool added = addChildData(owner->nameField, owner->waypoint, owner->otherData, streamTextValue(&state->childName),
+                            streamTextValue(&state->text));
+
+  state->childDepth = NO_CHILD;
+  state->text.len = 0;
+
+  return added;
+}
+
+// Substitutes an empty string for a missing attribute, the same way findAttribute does on the DOM path.
+char * streamAttributeValue(const char * value){
+  return (value == NULL) ? "\0" : (char *) value;
+}
+
+bool startStreamRoot(StreamState * state, GPXElement element, const StreamAttributes * attributes){
+  if(element != GPX_ELEMENT_GPX){
+    return false;
+  }
+
+  state->gpx = newGPXdoc(state->ctx, streamAttributeValue(attributes->namespace), streamAttributeValue(attributes->version),
+                         streamAttributeValue(attributes->creator));
+
+  return state->gpx != NULL;
+}
+
+bool startStreamWaypoint(StreamState * state, GPXElement element, int depth, bool isEmpty, const StreamAttributes * attributes){
+  Waypoint * waypoint = openWaypoint(state->gpx, element, streamAttributeValue(attributes->longitude),
+                                     streamAttributeValue(attributes->latitude));
+
+  if(waypoint == NULL){
+    return false;
+  }
+
+  return isEmpty || pushOwner(state, element, depth, &waypoint->name, waypoint, waypoint->otherData);
+}
+
+void initStreamState(StreamState * state, GPXParseContext * ctx){
+  state->gpx = NULL;
+  state->numOwners = 0;
+  state->childDepth = NO_CHILD;
+  initStreamText(&state->childName, contextAllocator(ctx));
+  initStreamText(&state->text, contextAllocator(ctx));
+  state->failed = false;
+  state->ctx = ctx;
+}
+
+bool streamElementNeedsAttributes(StreamState * state, int depth, GPXElement element){
+  if(state->childDepth != NO_CHILD){
+    return false;
+  }
+
+  return depth == 0 || element == GPX_ELEMENT_WPT || element == GPX_ELEMENT_TRKPT || element == GPX_ELEMENT_RTEPT;
+}
+
+bool startStreamElement(StreamState * state, int depth, const char * name, GPXElement element, bool isEmpty,
+                        const StreamAttributes * attributes){
+  if(state->childDepth != NO_CHILD){ // Nested inside a simple child - only its text matters.
+    return true;
+  }
+
+  if(depth == 0){
+    return startStreamRoot(state, element, attributes);
+  }
+
+  StreamOwner * owner = currentOwner(state);
+
+  if(owner != NULL && owner->depth == depth - 1 && isStructuralChild(owner->element, element) == false){
+    state->childName.len = 0;
+
+    if(appendStreamText(&state->childName, name) == false){
+      return false;
+    }
+
+    state->childDepth = depth;
+    state->text.len = 0;
+
+    return isEmpty == false || finishStreamChild(state);
+  }
+
+  if(element == GPX_ELEMENT_TRK){
+    Track * track = openTrack(state->gpx);
+    return track != NULL && (isEmpty || pushOwner(state, element, depth, &track->name, NULL, track->otherData));
+  }
+  else if(element == GPX_ELEMENT_TRKSEG){
+    return openTrackSegment(state->gpx) != NULL;
+  }
+  else if(element == GPX_ELEMENT_RTE){
+    Route * route = openRoute(state->gpx);
+    return route != NULL && (isEmpty || pushOwner(state, element, depth, &route->name, NULL, route->otherData));
+  }
+  else if(element == GPX_ELEMENT_WPT || element == GPX_ELEMENT_TRKPT || element == GPX_ELEMENT_RTEPT){
+    return startStreamWaypoint(state, element, depth, isEmpty, attributes);
+  }
+
+  return true;
+}
+
+bool endStreamElement(StreamState * state, int depth){
+  StreamOwner * owner = currentOwner(state);
+
+  if(state->childDepth == depth){
+    return finishStreamChild(state);
+  }
+  else if(state->childDepth == NO_CHILD && owner != NULL && owner->depth == depth){
+    state->numOwners--;
+  }
+
+  return true;
+}
+
+bool appendStreamElementText(StreamState * state, const char * text, size_t len){
+  if(state->childDepth == NO_CHILD){
+    return true;
+  }
+
+  return appendStreamTextLength(&state->text, text, len);
+}
+
+GPXdoc * finishStreamState(StreamState * state, bool succeeded){
+  freeStreamText(&state->childName);
+  freeStreamText(&state->text);
+
+  if(succeeded == false || state->failed == true){
+    deleteGPXdoc(state->gpx);
+    return NULL;
+  }
+
+  return state->gpx;
+}
+
+// Hands the current reader element to the builder, fetching only the attributes the builder is going to look at.
+bool startReaderElement(StreamState * state, xmlTextReaderPtr reader){
+  int depth = xmlTextReaderDepth(reader);
+  bool isEmpty = xmlTextReaderIsEmptyElement(reader) == 1;
+  const char * name = (const char *) xmlTextReaderConstLocalName(reader);
+  GPXElement element = classifyGPXElement(name);
+  StreamAttributes attributes = { NULL, NULL, NULL, NULL, NULL };
+  xmlChar * owned[4] = { NULL, NULL, NULL, NULL };
+
+  if(streamElementNeedsAttributes(state, depth, element) == true){
+    if(depth == 0){
+      attributes.namespace = (const char *) xmlTextReaderConstNamespaceUri(reader);
+      attributes.version = (const char *) (owned[0] = xmlTextReaderGetAttribute(reader, BAD_CAST VERSION));
+      attributes.creator = (const char *) (owned[1] = xmlTextReaderGetAttribute(reader, BAD_CAST CREATOR));
+    }
+    else{
+      attributes.latitude = (const char *) (owned[2] = xmlTextReaderGetAttribute(reader, BAD_CAST LAT));
+      attributes.longitude = (const char *) (owned[3] = xmlTextReaderGetAttribute(reader, BAD_CAST LON));
+    }
+  }
+
+  bool started = startStreamElement(state, depth, name, element, isEmpty, &attributes);
+
+  for(int i = 0; i < 4; i++){
+    xmlFree(owned[i]);
+  }
+
+  return started;
+}
+
+GPXdoc * buildObjectsFromReader(GPXParseContext * ctx, xmlTextReaderPtr reader){
+  StreamState state;
+  int retVal = -1;
+
+  initStreamState(&state, ctx);
+
+  while(state.failed == false && (retVal = xmlTextReaderRead(reader)) == 1){
+    int nodeType = xmlTextReaderNodeType(reader);
+
+    if(nodeType == XML_READER_TYPE_ELEMENT){
+      state.failed = (startReaderElement(&state, reader) == false);
+    }
+    else if(nodeType == XML_READER_TYPE_END_ELEMENT){
+      state.failed = (endStreamElement(&state, xmlTextReaderDepth(reader)) == false);
+    }
+    else if(state.childDepth != NO_CHILD && isStreamTextNode(nodeType)){
+      state.failed = (appendStreamText(&state.text, (const char *) xmlTextReaderConstValue(reader)) == false);
+    }
+    else if(state.childDepth != NO_CHILD && nodeType == XML_READER_TYPE_ENTITY_REFERENCE){
+      state.failed = (appendEntityText(&state.text, reader) == false);
+    }
+  }
+
+  return finishStreamState(&state, retVal == 0);
+}
+
+GPXdoc * createGPXdocStreamingCtx(GPXParseContext * ctx, char * fileName){
+  beginGPXParse(ctx);
+
+  if(fileName == NULL){
+    setGPXParseError(ctx, GPX_ERROR_ARGUMENT, NULL);
+    return finishGPXParse(ctx, NULL);
+  }
+
+  LIBXML_TEST_VERSION
+
+  xmlTextReaderPtr reader = xmlReaderForFile(fileName, NULL, contextXmlOptions(ctx));
+
+  if(reader == NULL){ // xmlReaderForFile opens the file straight away, so this is the file that couldn't be read.
+    setGPXParseError(ctx, GPX_ERROR_IO, NULL);
+    return finishGPXParse(ctx, NULL);
+  }
+
+  GPXdoc * gpx = buildObjectsFromReader(ctx, reader);
+
+  xmlFreeTextReader(reader);
+
+  return finishGPXParse(ctx, gpx);
+}
+
+GPXdoc * createGPXdocStreaming(char * fileName){
+  return createGPXdocStreamingCtx(NULL, fileName);
+}
+
+/* ***************************************************************************EVENT STREAM************************************************************************************ */
+
+// The simple children the event stream reports. Everything else is skipped.
+typedef enum {
+  EVENT_CHILD_OTHER = 0,
+  EVENT_CHILD_NAME,
+  EVENT_CHILD_ELE,
+  EVENT_CHILD_TIME
+} EventChild;
+
+// A track, route or point that is open in the event stream. The slots are reused for every element that
+// occupies the same level, so nothing here grows with the size of the file.
+typedef struct {
+  GPXElement element;
+  int depth;
+  bool begun;
+  StreamText name;
+  double latitude;
+  double longitude;
+  double elevation;
+  StreamText time;
+  bool hasTime;
+  bool timeIsReadable;
+} EventOwner;
+
+typedef struct {
+  const GPXStreamCallbacks * callbacks;
+  void * userData;
+
+  EventOwner owners[MAX_OWNER_DEPTH];
+  int numOwners;
+
+  EventChild childKind;
+  int childDepth;
+  StreamText text;
+} EventState;
+
+EventChild classifyEventChild(const char * name){
+  if(strcmp(name, NAME) == EQUAL_STRINGS){
+    return EVENT_CHILD_NAME;
+  }
+  else if(strcmp(name, ELE) == EQUAL_STRINGS){
+    return EVENT_CHILD_ELE;
+  }
+  else if(strcmp(name, TIME) == EQUAL_STRINGS){
+    return EVENT_CHILD_TIME;
+  }
+
+  return EVENT_CHILD_OTHER;
+}
+
+// Converts a coordinate, reporting NAN rather than 0 when there's no number to convert.
+double parseEventNumber(const char * str){
+  char * endPtr;
+  double value = parseGPXNumber(str, &endPtr);
+
+  return (endPtr == str) ? NAN : value;
+}
+
+EventOwner * currentEventOwner(EventState * state){
+  if(state->numOwners == 0){
+    return NULL;
+  }
+
+  return &state->owners[state->numOwners - 1];
+}
+
+EventOwner * pushEventOwner(EventState * state, GPXElement element, int depth){
+  if(state->numOwners == MAX_OWNER_DEPTH){
+    return NULL;
+  }
+
+  EventOwner * owner = &state->owners[state->numOwners];
+
+  owner->element = element;
+  owner->depth = depth;
+  owner->begun = false;
+  owner->name.len = 0;
+  owner->latitude = NAN;
+  owner->longitude = NAN;
+  owner->elevation = NAN;
+  owner->time.len = 0;
+  owner->hasTime = false;
+  owner->timeIsReadable = false;
+  state->numOwners++;
+
+  return owner;
+}
+
+// Fires the begin event of the enclosing track or route the first time one of its segments/points shows up.
+void beginEventContainer(EventState * state, GPXElement container){
+  EventOwner * owner = currentEventOwner(state);
+  const GPXStreamCallbacks * callbacks = state->callbacks;
+
+  if(owner == NULL || owner->element != container || owner->begun == true){
+    return;
+  }
+
+  owner->begun = true;
+
+  if(container == GPX_ELEMENT_TRK && callbacks->onTrackBegin != NULL){
+    callbacks->onTrackBegin(streamTextValue(&owner->name), state->userData);
+  }
+  else if(container == GPX_ELEMENT_RTE && callbacks->onRouteBegin != NULL){
+    callbacks->onRouteBegin(streamTextValue(&owner->name), state->userData);
+  }
+}
+
+void closeEventOwner(EventState * state){
+  EventOwner * owner = currentEventOwner(state);
+  const GPXStreamCallbacks * callbacks = state->callbacks;
+  const char * name = streamTextValue(&owner->name);
+  const char * time = (owner->hasTime == true) ? streamTextValue(&owner->time) : NULL;
+
+  beginEventContainer(state, owner->element);
+
+  switch(owner->element){
+    case GPX_ELEMENT_TRK:
+      if(callbacks->onTrackEnd != NULL){
+        callbacks->onTrackEnd(state->userData);
+      }
+      break;
+    case GPX_ELEMENT_RTE:
+      if(callbacks->onRouteEnd != NULL){
+        callbacks->onRouteEnd(state->userData);
+      }
+      break;
+    case GPX_ELEMENT_TRKPT:
+      if(callbacks->onPoint != NULL){
+        callbacks->onPoint(owner->latitude, owner->longitude, owner->elevation, time, state->userData);
+      }
+      break;
+    case GPX_ELEMENT_RTEPT:
+      if(callbacks->onRoutePoint != NULL){
+        callbacks->onRoutePoint(name, owner->latitude, owner->longitude, owner->elevation, time, state->userData);
+      }
+      break;
+    case GPX_ELEMENT_WPT:
+      if(callbacks->onWaypoint != NULL){
+        callbacks->onWaypoint(name, owner->latitude, owner->longitude, owner->elevation, time, state->userData);
+      }
+      break;
+    default:
+      break;
+  }
+
+  state->numOwners--;
+}
+
+bool finishEventChild(EventState * state){
+  EventOwner * owner = currentEventOwner(state);
+  bool stored = true;
+
+  if(state->childKind == EVENT_CHILD_NAME){
+    owner->name.len = 0;
+    stored = appendStreamText(&owner->name, streamTextValue(&state->text));
+  }
+  else if(state->childKind == EVENT_CHILD_ELE && isnan(owner->elevation)){ // The first readable one, as addChildData keeps.
+    parseGPXDecimal(streamTextValue(&state->text), &owner->elevation);
+  }
+  else if(state->childKind == EVENT_CHILD_TIME && owner->timeIsReadable == false){
+    int64_t time;
+
+    // Until a readable time turns up, the first one is reported as it is.
+    owner->timeIsReadable = parseGPXTime(streamTextValue(&state->text), &time);
+
+    if(owner->hasTime == false || owner->timeIsReadable == true){
+      owner->time.len = 0;
+      owner->hasTime = true;
+      stored = appendStreamText(&owner->time, streamTextValue(&state->text));
+    }
+  }
+
+  state->childDepth = NO_CHILD;
+  state->text.len = 0;
+
+  return stored;
+}
+
+// Reads lat and lon the way findAttribute does, skipping attributes in a namespace (x:lat).
+void readEventCoordinates(xmlTextReaderPtr reader, EventOwner * owner){
+  while(xmlTextReaderMoveToNextAttribute(reader) == 1){
+    const char * attrName = (const char *) xmlTextReaderConstLocalName(reader);
+
+    if(xmlTextReaderConstNamespaceUri(reader) != NULL){
+      continue;
+    }
+    else if(strcmp(attrName, LAT) == EQUAL_STRINGS){
+      owner->latitude = parseEventNumber((const char *) xmlTextReaderConstValue(reader));
+    }
+    else if(strcmp(attrName, LON) == EQUAL_STRINGS){
+      owner->longitude = parseEventNumber((const char *) xmlTextReaderConstValue(reader));
+    }
+  }
+
+  xmlTextReaderMoveToElement(reader);
+}
+
+bool startEventElement(EventState * state, xmlTextReaderPtr reader){
+  int depth = xmlTextReaderDepth(reader);
+  bool isEmpty = xmlTextReaderIsEmptyElement(reader) == 1;
+  const char * name = (const char *) xmlTextReaderConstLocalName(reader);
+  const GPXStreamCallbacks * callbacks = state->callbacks;
+
+  if(state->childDepth != NO_CHILD){
+    return true;
+  }
+
+  GPXElement element = classifyGPXElement(name);
+
+  if(depth == 0){
+    return element == GPX_ELEMENT_GPX;
+  }
+
+  EventOwner * owner = currentEventOwner(state);
+
+  if(owner != NULL && owner->depth == depth - 1 && isStructuralChild(owner->element, element) == false){
+    state->childKind = classifyEventChild(name);
+    state->childDepth = depth;
+    state->text.len = 0;
+
+    return isEmpty == false || finishEventChild(state);
+  }
+
+  if(element == GPX_ELEMENT_TRKSEG){
+    beginEventContainer(state, GPX_ELEMENT_TRK);
+
+    if(callbacks->onSegmentBegin != NULL){
+      callbacks->onSegmentBegin(state->userData);
+    }
+
+    if(isEmpty == true && callbacks->onSegmentEnd != NULL){
+      callbacks->onSegmentEnd(state->userData);
+    }
+  }
+  else if(element == GPX_ELEMENT_TRK || element == GPX_ELEMENT_RTE || element == GPX_ELEMENT_WPT ||
+          element == GPX_ELEMENT_TRKPT || element == GPX_ELEMENT_RTEPT){
+    if(element == GPX_ELEMENT_TRKPT){
+      beginEventContainer(state, GPX_ELEMENT_TRK);
+    }
+    else if(element == GPX_ELEMENT_RTEPT){
+      beginEventContainer(state, GPX_ELEMENT_RTE);
+    }
+
+    owner = pushEventOwner(state, element, depth);
+
+    if(owner == NULL){
+      return false;
+    }
+
+    if(element != GPX_ELEMENT_TRK && element != GPX_ELEMENT_RTE){
+      readEventCoordinates(reader, owner);
+    }
+
+    if(isEmpty == true){
+      closeEventOwner(state);
+    }
+  }
+
+  return true;
+}
+
+bool endEventElement(EventState * state, xmlTextReaderPtr reader){
+  int depth = xmlTextReaderDepth(reader);
+  EventOwner * owner = currentEventOwner(state);
+
+  if(state->childDepth == depth){
+    return finishEventChild(state);
+  }
+  else if(state->childDepth != NO_CHILD){
+    return true;
+  }
+
+  if(owner != NULL && owner->depth == depth){
+    closeEventOwner(state);
+  }
+  else if(classifyGPXElement((const char *) xmlTextReaderConstLocalName(reader)) == GPX_ELEMENT_TRKSEG &&
+          state->callbacks->onSegmentEnd != NULL){
+    state->callbacks->onSegmentEnd(state->userData);
+  }
+
+  return true;
+}
+
+bool streamEventsFromReader(GPXParseContext * ctx, xmlTextReaderPtr reader, const GPXStreamCallbacks * callbacks, void * userData){
+  const GPXAllocator * allocator = contextAllocator(ctx);
+  EventState state;
+  bool failed = false;
+  int retVal = -1;
+
+  state.callbacks = callbacks;
+  state.userData = userData;
+  state.numOwners = 0;
+  state.childKind = EVENT_CHILD_OTHER;
+  state.childDepth = NO_CHILD;
+  initStreamText(&state.text, allocator);
+
+  for(int i = 0; i < MAX_OWNER_DEPTH; i++){
+    initStreamText(&state.owners[i].name, allocator);
+    initStreamText(&state.owners[i].time, allocator);
+  }
+
+  while(failed == false && (retVal = xmlTextReaderRead(reader)) == 1){
+    int nodeType = xmlTextReaderNodeType(reader);
+
+    if(nodeType == XML_READER_TYPE_ELEMENT){
+      failed = (startEventElement(&state, reader) == false);
+    }
+    else if(nodeType == XML_READER_TYPE_END_ELEMENT){
+      failed = (endEventElement(&state, reader) == false);
+    }
+    else if(state.childDepth != NO_CHILD && isStreamTextNode(nodeType)){
+      failed = (appendStreamText(&state.text, (const char *) xmlTextReaderConstValue(reader)) == false);
+    }    else if(state.childDepth != NO_CHILD && nodeType == XML_READER_TYPE_ENTITY_REFERENCE){
+      failed = (appendEntityText(&state.text, reader) == false);
+    }
+  }
+
+  freeStreamText(&state.text);
+
+  for(int i = 0; i < MAX_OWNER_DEPTH; i++){
+    freeStreamText(&state.owners[i].name);
+    freeStreamText(&state.owners[i].time);
+  }
+
+  return failed == false && retVal == 0;
+}
+
+bool gpxStreamFileCtx(GPXParseContext * ctx, char * fileName, const GPXStreamCallbacks * callbacks, void * userData){
+  beginGPXParse(ctx);
+
+  if(fileName == NULL || callbacks == NULL){
+    return finishGPXCall(ctx, false, GPX_ERROR_ARGUMENT);
+  }
+
+  LIBXML_TEST_VERSION
+
+  xmlTextReaderPtr reader = xmlReaderForFile(fileName, NULL, contextXmlOptions(ctx));
+
+  if(reader == NULL){
+    setGPXParseError(ctx, GPX_ERROR_IO, NULL);
+    return finishGPXCall(ctx, false, GPX_ERROR_IO);
+  }
+
+  bool streamed = streamEventsFromReader(ctx, reader, callbacks, userData);
+
+  xmlFreeTextReader(reader);
+
+  return finishGPXCall(ctx, streamed, GPX_ERROR_GPX);
+}
+
+bool gpxStreamFile(char * fileName, const GPXStreamCallbacks * callbacks, void * userData){
+  return gpxStreamFileCtx(NULL, fileName, callbacks, userData);
+}
@@ -0,0 +1,168 @@
+/* Filename: GPXSummary.c
+ * Description: Route and track summaries - the number of points, length, bounding box and endpoints behind getRouteLen,
+ *              getTrackLen, isLoopRoute and isLoopTrack. A summary is worked out in one walk over the points the first time
+ *              something asks for it, and kept in the Route or Track with the change counts of the lists it came from, so
+ *              that numRoutesWithLength asked about several lengths in a row walks each route once rather than once per
+ *              call, and a route that gains a point is the only one worked out again. updateGPXdocCounts marks summaries
+ *              stale for points changed in place. Each summary has its own count of the threads reading it, so that
+ *              threads reading the same document never wait on each other - one that finds a summary being written, or
+ *              can't write one because it is being read, just works it out for itself.
+ */
+
+#include "GPXHelpers.h"
+
+typedef struct {
+  PathLength path;
+  GPXPathSummary summary;
+} PathSummarizer;
+
+void initPathSummarizer(PathSummarizer * summarizer){
+  initPathLength(&summarizer->path, GPX_DISTANCE_HAVERSINE);
+  memset(&summarizer->summary, 0, sizeof(GPXPathSummary));
+}
+
+void summarizeWaypoints(PathSummarizer * summarizer, List * waypoints){
+  GPXPathSummary * summary = &summarizer->summary;
+  ListIterator iterator = createIterator(waypoints);
+  Waypoint * waypoint;
+
+  while((waypoint = (Waypoint *) nextElement(&iterator)) != NULL){
+    double latitude = waypoint->latitude;
+    double longitude = waypoint->longitude;
+
+    addPathPoint(&summarizer->path, latitude, longitude);
+
+    if(summary->numPoints == 0){
+      summary->bounds = (GPXBounds) { latitude, longitude, latitude, longitude };
+      summary->firstLatitude = latitude;
+      summary->firstLongitude = longitude;
+    }
+    else{
+      summary->bounds.minLatitude = (latitude < summary->bounds.minLatitude) ? latitude : summary->bounds.minLatitude;
+      summary->bounds.maxLatitude = (latitude > summary->bounds.maxLatitude) ? latitude : summary->bounds.maxLatitude;
+      summary->bounds.minLongitude = (longitude < summary->bounds.minLongitude) ? longitude : summary->bounds.minLongitude;
+      summary->bounds.maxLongitude = (longitude > summary->bounds.maxLongitude) ? longitude : summary->bounds.maxLongitude;
+    }
+
+    summary->lastLatitude = latitude;
+    summary->lastLongitude = longitude;
+    summary->numPoints++;
+  }
+}
+
+GPXPathSummary finishPathSummary(PathSummarizer * summarizer){
+  summarizer->summary.length = finishPathLength(&summarizer->path);
+
+  return summarizer->summary;
+}
+
+/* ***************************************************************************SUMMARY API************************************************************************************* */
+
+// The summary isn't part of what a route or track holds, so keeping it doesn't count as modifying them.
+bool readSummaryCache(const GPXSummaryCache * cache, unsigned long segmentChanges, unsigned long pointChanges,
+                      GPXPathSummary * summary){
+  GPXSummaryCache * shared = (GPXSummaryCache *) cache;
+  int users = __atomic_load_n(&shared->users, __ATOMIC_RELAXED);
+  bool found = false;
+
+  // Read it as one more reader, unless it is being written.
+  while(users >= 0){
+    if(__atomic_compare_exchange_n(&shared->users, &users, users + 1, true, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED) == true){
+      found = (cache->isCurrent == true && cache->segmentChanges == segmentChanges && cache->pointChanges == pointChanges);
+
+      if(found == true){
+        *summary = cache->summary;
+      }
+
+      __atomic_sub_fetch(&shared->users, 1, __ATOMIC_RELEASE);
+      break;
+    }
+  }
+
+  return found;
+}
+
+void writeSummaryCache(const GPXSummaryCache * cache, unsigned long segmentChanges, unsigned long pointChanges,
+                       const GPXPathSummary * summary){
+  GPXSummaryCache * shared = (GPXSummaryCache *) cache;
+  int users = 0;
+
+  // Only written while no other thread is using it.  Otherwise it is left for a later call.
+  if(__atomic_compare_exchange_n(&shared->users, &users, -1, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED) == true){
+    shared->summary = *summary;
+    shared->segmentChanges = segmentChanges;
+    shared->pointChanges = pointChanges;
+    shared->isCurrent = true;
+
+    __atomic_store_n(&shared->users, 0, __ATOMIC_RELEASE);
+  }
+}
+
+GPXPathSummary routeSummary(const Route * route){
+  GPXPathSummary summary;
+  unsigned long pointChanges = route->waypoints->changes;
+
+  if(readSummaryCache(&route->summary, 0, pointChanges, &summary) == false){
+    PathSummarizer summarizer;
+
+    initPathSummarizer(&summarizer);
+    summarizeWaypoints(&summarizer, route->waypoints);
+    summary = finishPathSummary(&summarizer);
+    writeSummaryCache(&route->summary, 0, pointChanges, &summary);
+  }
+
+  return summary;
+}
+
+GPXPathSummary trackSummary(const Track * track){
+  GPXPathSummary summary;
+  unsigned long segmentChanges = track->segments->changes;
+  unsigned long pointChanges = 0;
+  ListIterator iterator = createIterator(track->segments);
+  TrackSegment * segment;
+
+  // While the segments list hasn't changed, the segments are the same ones and their counts only go up, so the sum moves
+  // whenever any of them does.
+  while((segment = (TrackSegment *) nextElement(&iterator)) != NULL){
+    pointChanges += segment->waypoints->changes;
+  }
+
+  if(readSummaryCache(&track->summary, segmentChanges, pointChanges, &summary) == false){
+    PathSummarizer summarizer;
+
+    initPathSummarizer(&summarizer);
+    iterator = createIterator(track->segments);
+
+    // The segments are one path, including the hops from the end of each to the start of the next.
+    while((segment = (TrackSegment *) nextElement(&iterator)) != NULL){
+      summarizeWaypoints(&summarizer, segment->waypoints);
+    }
+
+    summary = finishPathSummary(&summarizer);
+    writeSummaryCache(&track->summary, segmentChanges, pointChanges, &summary);
+  }
+
+  return summary;
+}
+
+/* ***************************************************************************PUBLIC API************************************************************************************* */
+
+bool getRouteSummary(const Route * rt, GPXPathSummary * summary){
+  if(rt == NULL || summary == NULL){
+    return false;
+  }
+
+  *summary = routeSummary(rt);
+
+  return true;
+}
+
+bool getTrackSummary(const Track * tr, GPXPathSummary * summary){
+  if(tr == NULL || summary == NULL){
+    return false;
+  }
+
+  *summary = trackSummary(tr);
+
+  return true;
+}
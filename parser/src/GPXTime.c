@@ -0,0 +1,155 @@
+/* Filename: GPXTime.c
+ * Description: Conversion between the xsd:dateTime text of <time> elements and nanoseconds since 1970-01-01T00:00:00Z, for
+ *              code that does arithmetic on times. Only times that name an instant are converted - ones that end in Z or
+ *              an offset. A time without a zone is local to somewhere unknown, so it stays text. The nanoseconds fit in an
+ *              int64_t from late 1677 to early 2262, and times outside that stay text as well.
+ *
+ * Citations: daysFromCivil and civilFromDays are Howard Hinnant's days_from_civil and civil_from_days, from
+ *            "chrono-Compatible Low-Level Date Algorithms".
+ */
+
+#include "GPXHelpers.h"
+
+#define SECONDS_PER_DAY 86400
+#define NANOSECONDS_PER_SECOND 1000000000LL
+#define NANOSECOND_DIGITS 9
+#define DAYS_PER_ERA 146097
+#define YEARS_PER_ERA 400
+
+// Days from 1970-01-01 to a date in the proleptic Gregorian calendar.
+int64_t daysFromCivil(long year, long month, long day){
+  year -= (month <= 2) ? 1 : 0;
+
+  const long era = (year >= 0 ? year : year - (YEARS_PER_ERA - 1)) / YEARS_PER_ERA;
+  const long yearOfEra = year - era * YEARS_PER_ERA;
+  const long dayOfYear = (153 * (month > 2 ? month - 3 : month + 9) + 2) / 5 + day - 1;
+  const long dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+
+  return (int64_t) era * DAYS_PER_ERA + dayOfEra - 719468;
+}
+
+// The inverse of daysFromCivil.
+void civilFromDays(int64_t days, long * year, long * month, long * day){
+  days += 719468;
+
+  const int64_t era = (days >= 0 ? days : days - (DAYS_PER_ERA - 1)) / DAYS_PER_ERA;
+  const long dayOfEra = (long) (days - era * DAYS_PER_ERA);
+  const long yearOfEra = (dayOfEra - dayOfEra / 1460 + dayOfEra / 36524 - dayOfEra / (DAYS_PER_ERA - 1)) / 365;
+  const long dayOfYear = dayOfEra - (365 * yearOfEra + yearOfEra / 4 - yearOfEra / 100);
+  const long monthIndex = (5 * dayOfYear + 2) / 153;
+
+  *day = dayOfYear - (153 * monthIndex + 2) / 5 + 1;
+  *month = (monthIndex < 10) ? monthIndex + 3 : monthIndex - 9;
+  *year = (long) (yearOfEra + era * YEARS_PER_ERA) + ((*month <= 2) ? 1 : 0);
+}
+
+bool parseGPXTime(const char * text, int64_t * time){
+  // isSchemaDateTime has the format rules; what's left to do here is to pick the fields out and check the zone and range.
+  if(text == NULL || isSchemaDateTime(text) == false){
+    return false;
+  }
+
+  const char * p = text;
+  const char * end = text + strlen(text);
+  long year, month, day, hour, minute, second;
+
+  // Years before 1000 or after 9999 are far outside the range anyway.
+  if(readSchemaDigits(&p, end, 4, &year) == false || p == end || *p != '-'){
+    return false;
+  }
+
+  p++;
+  readSchemaDigits(&p, end, 2, &month);
+  p++;
+  readSchemaDigits(&p, end, 2, &day);
+  p++;
+  readSchemaDigits(&p, end, 2, &hour);
+  p++;
+  readSchemaDigits(&p, end, 2, &minute);
+  p++;
+  readSchemaDigits(&p, end, 2, &second);
+
+  int64_t nanoseconds = 0;
+
+  if(*p == '.'){
+    int digits = 0;
+
+    for(p++; p < end && *p >= '0' && *p <= '9'; p++, digits++){
+      if(digits < NANOSECOND_DIGITS){
+        nanoseconds = nanoseconds * 10 + (*p - '0');
+      }
+      else if(*p != '0'){ // Finer than a nanosecond, so it can't be held exactly.
+        return false;
+      }
+    }
+
+    for(; digits < NANOSECOND_DIGITS; digits++){
+      nanoseconds *= 10;
+    }
+  }
+
+  long zoneMinutes = 0;
+
+  if(p == end){
+    return false;
+  }
+  else if(*p == '+' || *p == '-'){
+    long zoneHour, zoneMinute;
+    const char * zone = p + 1;
+
+    readSchemaDigits(&zone, end, 2, &zoneHour);
+    zone++;
+    readSchemaDigits(&zone, end, 2, &zoneMinute);
+    zoneMinutes = (zoneHour * 60 + zoneMinute) * ((*p == '-') ? -1 : 1);
+  }
+
+  int64_t seconds = daysFromCivil(year, month, day) * SECONDS_PER_DAY + hour * 3600 + minute * 60 + second - zoneMinutes * 60;
+
+  // GPX_NO_TIME (INT64_MIN) is never a valid result.
+  if(seconds <= INT64_MIN / NANOSECONDS_PER_SECOND || seconds >= INT64_MAX / NANOSECONDS_PER_SECOND){
+    return false;
+  }
+
+  *time = seconds * NANOSECONDS_PER_SECOND + nanoseconds;
+
+  return true;
+}
+
+void formatGPXTime(int64_t time, char * buffer){
+  int64_t seconds = time / NANOSECONDS_PER_SECOND;
+  int64_t nanoseconds = time % NANOSECONDS_PER_SECOND;
+
+  if(nanoseconds < 0){
+    nanoseconds += NANOSECONDS_PER_SECOND;
+    seconds--;
+  }
+
+  int64_t days = seconds / SECONDS_PER_DAY;
+  long secondOfDay = (long) (seconds % SECONDS_PER_DAY);
+
+  if(secondOfDay < 0){
+    secondOfDay += SECONDS_PER_DAY;
+    days--;
+  }
+
+  long year, month, day;
+
+  civilFromDays(days, &year, &month, &day);
+
+  int len = sprintf(buffer, "%04ld-%02ld-%02ldT%02ld:%02ld:%02ld", year, month, day, secondOfDay / 3600, (secondOfDay / 60) % 60,
+                    secondOfDay % 60);
+
+  // As many fraction digits as it takes, and none for a whole second.
+  if(nanoseconds != 0){
+    int digits = NANOSECOND_DIGITS;
+
+    while(nanoseconds % 10 == 0){
+      nanoseconds /= 10;
+      digits--;
+    }
+
+    len += sprintf(buffer + len, ".%0*lld", digits, (long long) nanoseconds);
+  }
+
+  strcpy(buffer + len, "Z");
+}
@@ -0,0 +1,1151 @@
+/* Filename: GPXTokenizer.c
+ * Description: A hand-written tokenizer for the plain, well-formed GPX that devices and apps write. It walks the raw bytes once
+ *              and drives the same StreamState builder as the xmlTextReader path (see GPXStream.c), so it never pays for
+ *              libxml2's node allocation, name dictionary or encoding conversion.
+ *
+ *              It only handles the subset of XML that GPX files actually use: elements, attributes, comments, processing
+ *              instructions, character references and the five predefined entities, in UTF-8 (or ASCII-only content under
+ *              another single-byte encoding). Anything else - a DOCTYPE, CDATA, other entities, other encodings, or markup
+ *              that isn't well-formed - makes it give up, and the public entry points re-parse the input with libxml2.
+ *              Either way the GPXdoc is the same one createGPXdoc would build.
+ *
+ *              The same tokenizer also reads the chunks of a track that GPXParallel.c hands out to threads, and the serial
+ *              pass that stitches them back together.
+ */
+
+#include "GPXHelpers.h"
+#include <stdint.h>
+
+#define MAX_TOKEN_DEPTH 256
+#define MAX_TOKEN_ATTRIBUTES 32
+#define MAX_TOKEN_PREFIXES 64
+#define MAX_REFERENCE_CHARS 12
+#define MAX_CODE_POINT 0x10FFFF
+
+// The attributes the builder can ask for, as indexes into the slots of a start tag.
+#define SLOT_NAMESPACE 0
+#define SLOT_VERSION 1
+#define SLOT_CREATOR 2
+#define SLOT_LATITUDE 3
+#define SLOT_LONGITUDE 4
+#define NUM_SLOTS 5
+#define NO_SLOT -1
+
+// How deep the points of a chunk are: <gpx><trk><trkseg><trkpt>
+#define CHUNK_DEPTH 3
+
+// A name inside the input buffer. It is not NUL-terminated.
+typedef struct {
+  const char * text;
+  size_t len;
+} TokenName;
+
+typedef struct {
+  const char * cur;
+  const char * end;
+
+  StreamState builder;
+
+  // Start tags that haven't been closed yet, so each end tag can be matched against its start tag.
+  TokenName open[MAX_TOKEN_DEPTH];
+  int depth;
+  bool seenRoot;
+
+  // Namespace prefixes in scope, and the depth of the element that declared each one. A chunk tokenizer only sees the ones
+  // declared inside its chunk.
+  TokenName prefixes[MAX_TOKEN_PREFIXES];
+  int prefixDepths[MAX_TOKEN_PREFIXES];
+  int numPrefixes;
+  bool partialScope;
+
+  // Decoded attribute values of the current start tag, and its local name.
+  StreamText values;
+  StreamText localName;
+} Tokenizer;
+
+// An attribute of the start tag being read. The value runs from value up to (not including) valueEnd and is still encoded.
+typedef struct {
+  TokenName name;
+  const char * value;
+  const char * valueEnd;
+} TokenAttribute;
+
+// Character classes, looked up by byte value.
+#define TOKEN_SPACE 0x01
+#define TOKEN_NAME_START 0x02
+#define TOKEN_NAME_CHAR 0x04
+#define TOKEN_TEXT_SPECIAL 0x08      // What decodeTokenText rewrites in character data: '&' and '\r'
+#define TOKEN_ATTRIBUTE_SPECIAL 0x10 // ...and in attribute values, where '\n' and '\t' become spaces too
+
+const unsigned char tokenClasses[256] = {
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x11, 0x11, 0x00, 0x00, 0x19, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x18, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x04, 0x04, 0x00,
+  0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x06, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06,
+  0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x00, 0x00, 0x00, 0x00, 0x06,
+  0x00, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06,
+  0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06,
+  0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06,
+  0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06,
+  0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06,
+  0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06,
+  0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06,
+  0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06,
+  0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06
+};
+
+#define TOKEN_CLASS(c, class) ((tokenClasses[(unsigned char) (c)] & (class)) != 0)
+
+bool equalTokenName(TokenName name, const char * text){
+  return strlen(text) == name.len && memcmp(name.text, text, name.len) == EQUAL_STRINGS;
+}
+
+bool sameTokenName(TokenName first, TokenName second){
+  return first.len == second.len && memcmp(first.text, second.text, first.len) == EQUAL_STRINGS;
+}
+
+void skipTokenSpace(Tokenizer * tok){
+  while(tok->cur < tok->end && TOKEN_CLASS(*tok->cur, TOKEN_SPACE)){
+    tok->cur++;
+  }
+}
+
+// Reads the name at the cursor, returning false if there isn't one.
+bool readTokenName(Tokenizer * tok, TokenName * name){
+  const char * p = tok->cur;
+
+  if(p == tok->end || TOKEN_CLASS(*p, TOKEN_NAME_START) == false){
+    return false;
+  }
+
+  while(p < tok->end && TOKEN_CLASS(*p, TOKEN_NAME_CHAR)){
+    p++;
+  }
+
+  name->text = tok->cur;
+  name->len = (size_t) (p - tok->cur);
+  tok->cur = p;
+
+  return true;
+}
+
+// Moves the cursor past text if the input continues with it.
+bool skipTokenText(Tokenizer * tok, const char * text){
+  size_t len = strlen(text);
+
+  if((size_t) (tok->end - tok->cur) < len || memcmp(tok->cur, text, len) != EQUAL_STRINGS){
+    return false;
+  }
+
+  tok->cur += len;
+
+  return true;
+}
+
+// Moves the cursor past the next occurrence of terminator, returning false if there isn't one.
+bool skipPastTokenText(Tokenizer * tok, const char * terminator){
+  size_t len = strlen(terminator);
+
+  while(tok->cur < tok->end){
+    const char * p = memchr(tok->cur, terminator[0], (size_t) (tok->end - tok->cur));
+
+    if(p == NULL || (size_t) (tok->end - p) < len){
+      return false;
+    }
+
+    tok->cur = p + 1;
+
+    if(memcmp(p, terminator, len) == EQUAL_STRINGS){
+      tok->cur = p + len;
+      return true;
+    }
+  }
+
+  return false;
+}
+
+/* ******************************************************************************INPUT CHECKS*********************************************************************************** */
+
+// Returns the length of the UTF-8 sequence at p if it encodes a character XML allows, or 0 if it doesn't.
+size_t validTokenSequence(const unsigned char * p, const unsigned char * end){
+  unsigned int codePoint;
+  size_t len;
+
+  if(p[0] < 0xC2){
+    return 0;
+  }
+  else if(p[0] < 0xE0){
+    codePoint = p[0] & 0x1F;
+    len = 2;
+  }
+  else if(p[0] < 0xF0){
+    codePoint = p[0] & 0x0F;
+    len = 3;
+  }
+  else if(p[0] < 0xF5){
+    codePoint = p[0] & 0x07;
+    len = 4;
+  }
+  else{
+    return 0;
+  }
+
+  if((size_t) (end - p) < len){
+    return 0;
+  }
+
+  for(size_t i = 1; i < len; i++){
+    if((p[i] & 0xC0) != 0x80){
+      return 0;
+    }
+
+    codePoint = (codePoint << 6) | (p[i] & 0x3F);
+  }
+
+  // Overlong forms, surrogates, the two non-characters XML excludes and anything past Unicode.
+  if((len == 3 && codePoint < 0x800) || (len == 4 && codePoint < 0x10000) || (codePoint >= 0xD800 && codePoint <= 0xDFFF) ||
+     codePoint == 0xFFFE || codePoint == 0xFFFF || codePoint > MAX_CODE_POINT){
+    return 0;
+  }
+
+  return len;
+}
+
+// Checks that every byte is one XML allows and that the input is valid UTF-8. isAscii reports whether it is plain 7-bit ASCII.
+bool isTokenizableInput(const char * data, size_t length, bool * isAscii){
+  const unsigned char * p = (const unsigned char *) data;
+  const unsigned char * end = p + length;
+
+  *isAscii = true;
+
+  while(p < end){
+    unsigned char c = *p;
+
+    // Most of a GPX file is printable ASCII, which can be let through eight bytes at a time. Subtracting 0x20 from each byte
+    // sets its top bit if it was a control character, and the top bit is already set on anything that isn't ASCII.
+    if((size_t) (end - p) >= sizeof(uint64_t)){
+      uint64_t word;
+
+      memcpy(&word, p, sizeof(word));
+
+      if((((word - 0x2020202020202020ULL) | word) & 0x8080808080808080ULL) == 0){
+        p += sizeof(word);
+        continue;
+      }
+    }
+
+    if(c >= 0x20 && c < 0x80){
+      p++;
+    }
+    else if(c == '\n' || c == '\t' || c == '\r'){
+      p++;
+    }
+    else if(c >= 0x80){
+      size_t len = validTokenSequence(p, end);
+
+      if(len == 0){
+        return false;
+      }
+
+      *isAscii = false;
+      p += len;
+    }
+    else{
+      return false;
+    }
+  }
+
+  return true;
+}
+
+bool equalTokenIgnoreCase(const char * text, size_t len, const char * name){
+  if(strlen(name) != len){
+    return false;
+  }
+
+  for(size_t i = 0; i < len; i++){
+    char c = text[i];
+
+    if(c >= 'a' && c <= 'z'){
+      c = (char) (c - 'a' + 'A');
+    }
+
+    if(c != name[i]){
+      return false;
+    }
+  }
+
+  return true;
+}
+
+// Encodings whose first 128 characters are ASCII, so ASCII-only content reads the same under any of them.
+bool isAsciiCompatibleEncoding(const char * text, size_t len){
+  const char * names[] = { "US-ASCII", "ASCII", "ISO-8859-1", "ISO-8859-15", "LATIN1", "WINDOWS-1252" };
+
+  for(size_t i = 0; i < sizeof(names) / sizeof(names[0]); i++){
+    if(equalTokenIgnoreCase(text, len, names[i]) == true){
+      return true;
+    }
+  }
+
+  return false;
+}
+
+// Reads one name="value" pair of the XML declaration, with the whitespace that has to come before it. value points into the input.
+bool readTokenPseudoAttribute(Tokenizer * tok, const char * name, TokenName * value){
+  const char * start = tok->cur;
+
+  skipTokenSpace(tok);
+
+  if(tok->cur == start || skipTokenText(tok, name) == false){
+    tok->cur = start;
+    return false;
+  }
+
+  skipTokenSpace(tok);
+
+  if(skipTokenText(tok, "=") == false){
+    tok->cur = start;
+    return false;
+  }
+
+  skipTokenSpace(tok);
+
+  const char * quote = tok->cur;
+  const char * valueEnd = NULL;
+
+  if(quote < tok->end && (*quote == '"' || *quote == '\'')){
+    valueEnd = memchr(quote + 1, *quote, (size_t) (tok->end - quote - 1));
+  }
+
+  if(valueEnd == NULL){
+    tok->cur = start;
+    return false;
+  }
+
+  value->text = quote + 1;
+  value->len = (size_t) (valueEnd - value->text);
+  tok->cur = valueEnd + 1;
+
+  return true;
+}
+
+// Skips the byte order mark and the XML declaration, checking that the declared encoding is one the tokenizer can read.
+bool readTokenProlog(Tokenizer * tok, bool isAscii){
+  const char * declaration;
+  TokenName version;
+  TokenName encoding;
+  TokenName standalone;
+
+  skipTokenText(tok, "\xEF\xBB\xBF");
+  declaration = tok->cur;
+
+  if(skipTokenText(tok, "<?xml") == false || tok->cur == tok->end || TOKEN_CLASS(*tok->cur, TOKEN_SPACE) == false){
+    tok->cur = declaration;
+    return true;
+  }
+
+  // Only the exact form the XML spec allows: version, then optionally encoding and standalone, in that order.
+  if(readTokenPseudoAttribute(tok, "version", &version) == false || version.len < 3 || memcmp(version.text, "1.", 2) != EQUAL_STRINGS){
+    return false;
+  }
+
+  for(size_t i = 2; i < version.len; i++){
+    if(version.text[i] < '0' || version.text[i] > '9'){
+      return false;
+    }
+  }
+
+  bool hasEncoding = readTokenPseudoAttribute(tok, "encoding", &encoding);
+
+  if(readTokenPseudoAttribute(tok, "standalone", &standalone) == true && equalTokenName(standalone, "yes") == false &&
+     equalTokenName(standalone, "no") == false){
+    return false;
+  }
+
+  skipTokenSpace(tok);
+
+  if(skipTokenText(tok, "?>") == false){
+    return false;
+  }
+
+  if(hasEncoding == false){
+    return true;
+  }
+  else if(equalTokenIgnoreCase(encoding.text, encoding.len, "UTF-8") == true || equalTokenIgnoreCase(encoding.text, encoding.len, "UTF8") == true){
+    return true;
+  }
+
+  return isAscii == true && isAsciiCompatibleEncoding(encoding.text, encoding.len) == true;
+}
+
+/* ******************************************************************************TEXT DECODING********************************************************************************** */
+
+bool appendTokenCodePoint(StreamText * out, unsigned int codePoint){
+  char bytes[4];
+  size_t len;
+
+  if(codePoint < 0x80){
+    bytes[0] = (char) codePoint;
+    len = 1;
+  }
+  else if(codePoint < 0x800){
+    bytes[0] = (char) (0xC0 | (codePoint >> 6));
+    bytes[1] = (char) (0x80 | (codePoint & 0x3F));
+    len = 2;
+  }
+  else if(codePoint < 0x10000){
+    bytes[0] = (char) (0xE0 | (codePoint >> 12));
+    bytes[1] = (char) (0x80 | ((codePoint >> 6) & 0x3F));
+    bytes[2] = (char) (0x80 | (codePoint & 0x3F));
+    len = 3;
+  }
+  else{
+    bytes[0] = (char) (0xF0 | (codePoint >> 18));
+    bytes[1] = (char) (0x80 | ((codePoint >> 12) & 0x3F));
+    bytes[2] = (char) (0x80 | ((codePoint >> 6) & 0x3F));
+    bytes[3] = (char) (0x80 | (codePoint & 0x3F));
+    len = 4;
+  }
+
+  return appendStreamTextLength(out, bytes, len);
+}
+
+// Returns true for the code points a character reference may produce.
+bool isTokenChar(unsigned int codePoint){
+  return codePoint == 0x9 || codePoint == 0xA || codePoint == 0xD || (codePoint >= 0x20 && codePoint <= 0xD7FF) ||
+         (codePoint >= 0xE000 && codePoint <= 0xFFFD) || (codePoint >= 0x10000 && codePoint <= MAX_CODE_POINT);
+}
+
+bool decodeTokenCharReference(const char * text, size_t len, StreamText * out){
+  unsigned int codePoint = 0;
+  unsigned int base = 10;
+  size_t i = 1;
+
+  if(len > 1 && text[1] == 'x'){
+    base = 16;
+    i = 2;
+  }
+
+  if(i == len){
+    return false;
+  }
+
+  for(; i < len; i++){
+    char c = text[i];
+    unsigned int digit;
+
+    if(c >= '0' && c <= '9'){
+      digit = (unsigned int) (c - '0');
+    }
+    else if(base == 16 && c >= 'a' && c <= 'f'){
+      digit = (unsigned int) (c - 'a' + 10);
+    }
+    else if(base == 16 && c >= 'A' && c <= 'F'){
+      digit = (unsigned int) (c - 'A' + 10);
+    }
+    else{
+      return false;
+    }
+
+    codePoint = codePoint * base + digit;
+
+    if(codePoint > MAX_CODE_POINT){
+      return false;
+    }
+  }
+
+  return isTokenChar(codePoint) && appendTokenCodePoint(out, codePoint);
+}
+
+// Decodes the reference whose '&' is at *pos, leaving *pos on its ';'. Only character references and the predefined entities are known.
+bool decodeTokenReference(const char ** pos, const char * end, StreamText * out){
+  const char * text = *pos + 1;
+  size_t limit = (size_t) (end - text) < MAX_REFERENCE_CHARS ? (size_t) (end - text) : MAX_REFERENCE_CHARS;
+  const char * semicolon = memchr(text, ';', limit);
+
+  if(semicolon == NULL){
+    return false;
+  }
+
+  size_t len = (size_t) (semicolon - text);
+  const char * value = NULL;
+
+  if(len == 2 && memcmp(text, "lt", 2) == EQUAL_STRINGS){
+    value = "<";
+  }
+  else if(len == 2 && memcmp(text, "gt", 2) == EQUAL_STRINGS){
+    value = ">";
+  }
+  else if(len == 3 && memcmp(text, "amp", 3) == EQUAL_STRINGS){
+    value = "&";
+  }
+  else if(len == 4 && memcmp(text, "apos", 4) == EQUAL_STRINGS){
+    value = "'";
+  }
+  else if(len == 4 && memcmp(text, "quot", 4) == EQUAL_STRINGS){
+    value = "\"";
+  }
+  else if(len > 0 && text[0] == '#'){
+    *pos = semicolon;
+    return decodeTokenCharReference(text, len, out);
+  }
+  else{
+    return false;
+  }
+
+  *pos = semicolon;
+
+  return appendStreamTextLength(out, value, 1);
+}
+
+// Returns the first character at or after start that decodeTokenText has to rewrite, or end if there isn't one.
+const char * findTokenSpecial(const char * start, const char * end, bool isAttribute){
+  unsigned char special = (isAttribute == true) ? TOKEN_ATTRIBUTE_SPECIAL : TOKEN_TEXT_SPECIAL;
+  const char * p = start;
+
+  while(p < end && TOKEN_CLASS(*p, special) == false){
+    p++;
+  }
+
+  return p;
+}
+
+// Appends the character data between start and end to out, expanding references and normalising line ends the way an XML
+// parser must. Attribute values also have their whitespace characters turned into spaces.
+bool decodeTokenText(const char * start, const char * end, bool isAttribute, StreamText * out){
+  const char * p = start;
+
+  while(p < end){
+    const char * special = findTokenSpecial(p, end, isAttribute);
+
+    if(appendStreamTextLength(out, p, (size_t) (special - p)) == false){
+      return false;
+    }
+
+    if(special == end){
+      return true;
+    }
+
+    bool stored;
+
+    p = special;
+
+    if(*p == '&'){
+      stored = decodeTokenReference(&p, end, out);
+    }
+    else{
+      if(*p == '\r' && p + 1 < end && p[1] == '\n'){
+        p++;
+      }
+
+      stored = appendStreamTextLength(out, (isAttribute == true) ? " " : "\n", 1);
+    }
+
+    if(stored == false){
+      return false;
+    }
+
+    p++;
+  }
+
+  return true;
+}
+
+/* ******************************************************************************MARKUP********************************************************************************** */
+
+// Returns true if the character data contains "]]>", which XML only allows as the end of a CDATA section.
+bool containsCDataEnd(const char * start, const char * end){
+  const char * p = (const char *) memchr(start, '>', (size_t) (end - start));
+
+  while(p != NULL){
+    if(p - start >= 2 && p[-1] == ']' && p[-2] == ']'){
+      return true;
+    }
+
+    p = (const char *) memchr(p + 1, '>', (size_t) (end - p - 1));
+  }
+
+  return false;
+}
+
+// Character data between two tags. Only the text of simple children goes anywhere; the rest just has to be well-formed.
+bool readTokenText(Tokenizer * tok, const char * start, const char * end){
+  if(start == end){
+    return true;
+  }
+
+  if(containsCDataEnd(start, end) == true){
+    return false;
+  }
+
+  if(tok->depth == 0){ // Outside the root element only whitespace is allowed.
+    for(const char * p = start; p < end; p++){
+      if(TOKEN_CLASS(*p, TOKEN_SPACE) == false){
+        return false;
+      }
+    }
+
+    return true;
+  }
+
+  if(tok->builder.childDepth != NO_CHILD){
+    return decodeTokenText(start, end, false, &tok->builder.text);
+  }
+
+  if(memchr(start, '&', (size_t) (end - start)) != NULL){
+    size_t mark = tok->values.len;
+    bool decoded = decodeTokenText(start, end, false, &tok->values);
+
+    tok->values.len = mark;
+
+    return decoded;
+  }
+
+  return true;
+}
+
+// Returns true if name is a valid qualified name: either a plain name or prefix:local, with a single colon.
+bool isTokenQName(TokenName name){
+  const char * colon = memchr(name.text, ':', name.len);
+
+  if(colon == NULL){
+    return true;
+  }
+
+  size_t prefixLen = (size_t) (colon - name.text);
+
+  return prefixLen > 0 && prefixLen < name.len - 1 && memchr(colon + 1, ':', name.len - prefixLen - 1) == NULL &&
+         TOKEN_CLASS(colon[1], TOKEN_NAME_START);
+}
+
+// Splits off the prefix of a qualified name. The prefix is empty if there isn't one.
+TokenName tokenPrefix(TokenName name){
+  const char * colon = memchr(name.text, ':', name.len);
+  TokenName prefix = { name.text, (colon == NULL) ? 0 : (size_t) (colon - name.text) };
+
+  return prefix;
+}
+
+bool isTokenPrefixDeclared(Tokenizer * tok, TokenName prefix){
+  if(equalTokenName(prefix, "xml") == true){
+    return true;
+  }
+
+  for(int i = tok->numPrefixes - 1; i >= 0; i--){
+    if(sameTokenName(tok->prefixes[i], prefix) == true){
+      return true;
+    }
+  }
+
+  return false;
+}
+
+// Drops the prefixes declared by an element that is being closed.
+void closeTokenScope(Tokenizer * tok, int depth){
+  while(tok->numPrefixes > 0 && tok->prefixDepths[tok->numPrefixes - 1] >= depth){
+    tok->numPrefixes--;
+  }
+}
+
+// Reads the attributes of a start tag up to and including its '>' or '/>'. The values are left undecoded for now.
+bool readTokenAttributes(Tokenizer * tok, TokenAttribute attributes[MAX_TOKEN_ATTRIBUTES], int * numAttributes, bool * isEmpty){
+  *numAttributes = 0;
+
+  while(true){
+    const char * before = tok->cur;
+
+    skipTokenSpace(tok);
+
+    if(tok->cur == tok->end){
+      return false;
+    }
+    else if(*tok->cur == '>'){
+      tok->cur++;
+      *isEmpty = false;
+      return true;
+    }
+    else if(*tok->cur == '/'){
+      tok->cur++;
+      *isEmpty = true;
+      return skipTokenText(tok, ">");
+    }
+
+    TokenAttribute * attribute = &attributes[*numAttributes];
+
+    if(tok->cur == before || *numAttributes == MAX_TOKEN_ATTRIBUTES || readTokenName(tok, &attribute->name) == false ||
+       isTokenQName(attribute->name) == false){
+      return false;
+    }
+
+    for(int i = 0; i < *numAttributes; i++){
+      if(sameTokenName(attributes[i].name, attribute->name) == true){
+        return false;
+      }
+    }
+
+    skipTokenSpace(tok);
+
+    if(skipTokenText(tok, "=") == false){
+      return false;
+    }
+
+    skipTokenSpace(tok);
+
+    if(tok->cur == tok->end || (*tok->cur != '"' && *tok->cur != '\'')){
+      return false;
+    }
+
+    attribute->value = tok->cur + 1;
+    attribute->valueEnd = memchr(attribute->value, *tok->cur, (size_t) (tok->end - attribute->value));
+
+    if(attribute->valueEnd == NULL || memchr(attribute->value, '<', (size_t) (attribute->valueEnd - attribute->value)) != NULL){
+      return false;
+    }
+
+    tok->cur = attribute->valueEnd + 1;
+    (*numAttributes)++;
+  }
+}
+
+// Records the xmlns:prefix declarations of a start tag. They stay in scope until the element is closed.
+bool declareTokenPrefixes(Tokenizer * tok, int depth, TokenAttribute attributes[MAX_TOKEN_ATTRIBUTES], int numAttributes){
+  for(int i = 0; i < numAttributes; i++){
+    TokenName prefix = tokenPrefix(attributes[i].name);
+
+    if(equalTokenName(prefix, "xmlns") == false){
+      continue;
+    }
+
+    // Undeclaring a prefix, or redeclaring one of the reserved ones, is beyond what the tokenizer handles.
+    if(tok->numPrefixes == MAX_TOKEN_PREFIXES || attributes[i].valueEnd == attributes[i].value){
+      return false;
+    }
+
+    TokenName declared = { prefix.text + 6, attributes[i].name.len - 6 };
+
+    if(equalTokenName(declared, "xml") == true || equalTokenName(declared, "xmlns") == true){
+      return false;
+    }
+
+    tok->prefixes[tok->numPrefixes] = declared;
+    tok->prefixDepths[tok->numPrefixes] = depth;
+    tok->numPrefixes++;
+  }
+
+  return true;
+}
+
+// Works out which builder slot (if any) an attribute fills. The namespace comes from the root's xmlns declaration for its own prefix.
+int tokenAttributeSlot(int depth, TokenName elementPrefix, TokenName name){
+  if(depth == 0){
+    if(elementPrefix.len == 0 && equalTokenName(name, "xmlns") == true){
+      return SLOT_NAMESPACE;
+    }
+    else if(elementPrefix.len > 0 && name.len == elementPrefix.len + 6 && memcmp(name.text, "xmlns:", 6) == EQUAL_STRINGS &&
+            memcmp(name.text + 6, elementPrefix.text, elementPrefix.len) == EQUAL_STRINGS){
+      return SLOT_NAMESPACE;
+    }
+    else if(equalTokenName(name, VERSION) == true){
+      return SLOT_VERSION;
+    }
+    else if(equalTokenName(name, CREATOR) == true){
+      return SLOT_CREATOR;
+    }
+  }
+  else if(equalTokenName(name, LAT) == true){
+    return SLOT_LATITUDE;
+  }
+  else if(equalTokenName(name, LON) == true){
+    return SLOT_LONGITUDE;
+  }
+
+  return NO_SLOT;
+}
+
+// Decodes the attribute values the builder wants into tok->values, storing their offsets in slots. The others only have
+// their references checked.
+bool decodeTokenAttributes(Tokenizer * tok, int depth, TokenName elementPrefix, bool wantAttributes,
+                           TokenAttribute attributes[MAX_TOKEN_ATTRIBUTES], int numAttributes, long slots[NUM_SLOTS]){
+  tok->values.len = 0;
+
+  for(int i = 0; i < numAttributes; i++){
+    TokenAttribute * attribute = &attributes[i];
+    int slot = (wantAttributes == true) ? tokenAttributeSlot(depth, elementPrefix, attribute->name) : NO_SLOT;
+    size_t mark = tok->values.len;
+
+    if(slot != NO_SLOT){
+      slots[slot] = (long) mark;
+
+      if(decodeTokenText(attribute->value, attribute->valueEnd, true, &tok->values) == false ||
+         appendStreamTextLength(&tok->values, "\0", 1) == false){
+        return false;
+      }
+    }
+    else if(memchr(attribute->value, '&', (size_t) (attribute->valueEnd - attribute->value)) != NULL){
+      bool decoded = decodeTokenText(attribute->value, attribute->valueEnd, true, &tok->values);
+
+      tok->values.len = mark;
+
+      if(decoded == false){
+        return false;
+      }
+    }
+  }
+
+  return true;
+}
+
+const char * tokenSlotValue(Tokenizer * tok, long offset){
+  return (offset == NO_SLOT) ? NULL : tok->values.text + offset;
+}
+
+bool readTokenStartTag(Tokenizer * tok){
+  TokenName name;
+  TokenAttribute attributes[MAX_TOKEN_ATTRIBUTES];
+  int numAttributes = 0;
+  bool isEmpty = false;
+  int depth = tok->depth;
+
+  if(readTokenName(tok, &name) == false || isTokenQName(name) == false || depth == MAX_TOKEN_DEPTH ||
+     (depth == 0 && tok->seenRoot == true)){
+    return false;
+  }
+
+  if(readTokenAttributes(tok, attributes, &numAttributes, &isEmpty) == false ||
+     declareTokenPrefixes(tok, depth, attributes, numAttributes) == false){
+    return false;
+  }
+
+  // The builder works with local names, like the libxml2 paths. libxml2 keeps the whole name if its prefix isn't declared.
+  TokenName prefix = tokenPrefix(name);
+  TokenName local = name;
+
+  if(prefix.len > 0 && isTokenPrefixDeclared(tok, prefix) == true){
+    local.text = name.text + prefix.len + 1;
+    local.len = name.len - prefix.len - 1;
+  }
+  else if(prefix.len > 0 && tok->partialScope == true && tok->builder.childDepth == NO_CHILD){
+    return false; // The prefix may have been declared outside the chunk, and the builder is about to use the name.
+  }
+
+  tok->localName.len = 0;
+
+  if(appendStreamTextLength(&tok->localName, local.text, local.len) == false){
+    return false;
+  }
+
+  const char * localName = streamTextValue(&tok->localName);
+
+  if(depth == 0){
+    tok->seenRoot = true;
+  }
+
+  GPXElement element = classifyGPXElement(localName);
+  bool wantAttributes = streamElementNeedsAttributes(&tok->builder, depth, element);
+  long slots[NUM_SLOTS] = { NO_SLOT, NO_SLOT, NO_SLOT, NO_SLOT, NO_SLOT };
+
+  if(decodeTokenAttributes(tok, depth, prefix, wantAttributes, attributes, numAttributes, slots) == false){
+    return false;
+  }
+
+  StreamAttributes builderAttributes = { tokenSlotValue(tok, slots[SLOT_NAMESPACE]), tokenSlotValue(tok, slots[SLOT_VERSION]),
+                                         tokenSlotValue(tok, slots[SLOT_CREATOR]), tokenSlotValue(tok, slots[SLOT_LATITUDE]),
+                                         tokenSlotValue(tok, slots[SLOT_LONGITUDE]) };
+
+  if(startStreamElement(&tok->builder, depth, localName, element, isEmpty, &builderAttributes) == false){
+    return false;
+  }
+
+  if(isEmpty == false){
+    tok->open[tok->depth++] = name;
+  }
+  else{
+    closeTokenScope(tok, depth);
+  }
+
+  return true;
+}
+
+bool readTokenEndTag(Tokenizer * tok){
+  TokenName name;
+
+  if(readTokenName(tok, &name) == false || tok->depth == 0 || sameTokenName(name, tok->open[tok->depth - 1]) == false){
+    return false;
+  }
+
+  skipTokenSpace(tok);
+
+  if(skipTokenText(tok, ">") == false){
+    return false;
+  }
+
+  tok->depth--;
+  closeTokenScope(tok, tok->depth);
+
+  return endStreamElement(&tok->builder, tok->depth);
+}
+
+// Comments are skipped. DOCTYPE and CDATA sections are left to libxml2.
+bool readTokenDeclaration(Tokenizer * tok){
+  if(skipTokenText(tok, "!--") == false || skipPastTokenText(tok, "--") == false){
+    return false;
+  }
+
+  return skipTokenText(tok, ">"); // "--" isn't allowed inside a comment
+}
+
+// Processing instructions are skipped. The XML declaration was handled by readTokenProlog, so another one here is an error.
+bool readTokenInstruction(Tokenizer * tok){
+  TokenName target;
+
+  tok->cur++;
+
+  if(readTokenName(tok, &target) == false || equalTokenIgnoreCase(target.text, target.len, "XML") == true){
+    return false;
+  }
+
+  // The target is either followed straight away by "?>" or separated from the rest by whitespace.
+  if(skipTokenText(tok, "?>") == true){
+    return true;
+  }
+
+  return tok->cur < tok->end && TOKEN_CLASS(*tok->cur, TOKEN_SPACE) && skipPastTokenText(tok, "?>");
+}
+
+bool readTokenMarkup(Tokenizer * tok){
+  char c = *tok->cur;
+
+  if(c == '/'){
+    tok->cur++;
+    return readTokenEndTag(tok);
+  }
+  else if(c == '!'){
+    return readTokenDeclaration(tok);
+  }
+  else if(c == '?'){
+    return readTokenInstruction(tok);
+  }
+
+  return readTokenStartTag(tok);
+}
+
+void initTokenizer(Tokenizer * tok, GPXParseContext * ctx, const char * start, const char * end){
+  tok->cur = start;
+  tok->end = end;
+  tok->depth = 0;
+  tok->seenRoot = false;
+  tok->numPrefixes = 0;
+  tok->partialScope = false;
+  initStreamText(&tok->values, contextAllocator(ctx));
+  initStreamText(&tok->localName, contextAllocator(ctx));
+  initStreamState(&tok->builder, ctx);
+}
+
+// A chunk can take the place of the markup at its start if the serial pass is between the points of a <trkseg> at the depth and
+// with the owners the chunk's tokenizer assumed. Its points then go exactly where the serial pass would have put them.
+bool canSpliceTokenChunk(Tokenizer * tok, const GPXChunk * chunk){
+  StreamState * builder = &tok->builder;
+
+  return chunk->points != NULL && tok->depth == CHUNK_DEPTH && equalTokenName(tok->open[1], TRK) == true &&
+         equalTokenName(tok->open[2], TRKSEG) == true && builder->childDepth == NO_CHILD && builder->numOwners == 1 &&
+         builder->owners[0].element == GPX_ELEMENT_TRK && builder->owners[0].depth == 1;
+}
+
+void spliceTokenChunk(Tokenizer * tok, GPXChunk * chunk){
+  Track * track = (Track *) getFromBack(tok->builder.gpx->tracks);
+  TrackSegment * segment = (TrackSegment *) getFromBack(track->segments);
+  Track * chunkTrack = (Track *) getFromBack(chunk->points->tracks);
+  TrackSegment * chunkSegment = (TrackSegment *) getFromBack(chunkTrack->segments);
+
+  // The points (or at least their Nodes) were allocated from the scratch document's arena or Node pool, so its blocks go where
+  // the points go. Deleting the scratch document afterwards only frees what is left of it.
+  mergeGPXArena(listArena(segment->waypoints), listArena(chunkSegment->waypoints));
+  mergeNodePools(listNodePool(segment->waypoints), listNodePool(chunkSegment->waypoints));
+  appendList(segment->waypoints, chunkSegment->waypoints);
+  deleteGPXdoc(chunk->points);
+  chunk->points = NULL;
+  tok->cur = chunk->stop;
+}
+
+GPXdoc * tokenizeCheckedGPXdoc(GPXParseContext * ctx, const char * data, size_t length, bool isAscii, GPXChunk * chunks, int numChunks){
+  Tokenizer tok;
+  bool succeeded = false;
+  int nextChunk = 0;
+
+  initTokenizer(&tok, ctx, data, data + length);
+
+  if(readTokenProlog(&tok, isAscii) == true){
+    succeeded = true;
+
+    while(succeeded == true && tok.cur < tok.end){
+      const char * tag = memchr(tok.cur, '<', (size_t) (tok.end - tok.cur));
+      const char * textEnd = (tag == NULL) ? tok.end : tag;
+
+      succeeded = readTokenText(&tok, tok.cur, textEnd);
+      tok.cur = textEnd;
+
+      if(succeeded == false || tag == NULL){
+        continue;
+      }
+
+      // Chunks that start inside something the serial pass has already read (a comment, another chunk) are dropped.
+      while(nextChunk < numChunks && chunks[nextChunk].start < tag){
+        nextChunk++;
+      }
+
+      if(nextChunk < numChunks && chunks[nextChunk].start == tag && canSpliceTokenChunk(&tok, &chunks[nextChunk]) == true){
+        spliceTokenChunk(&tok, &chunks[nextChunk]);
+        continue;
+      }
+
+      tok.cur++;
+      succeeded = tok.cur < tok.end && readTokenMarkup(&tok);
+    }
+
+    succeeded = succeeded && tok.seenRoot == true && tok.depth == 0;
+  }
+
+  freeStreamText(&tok.values);
+  freeStreamText(&tok.localName);
+
+  return finishStreamState(&tok.builder, succeeded);
+}
+
+GPXdoc * tokenizeGPXdoc(GPXParseContext * ctx, const char * data, size_t length){
+  bool isAscii = true;
+
+  if(data == NULL || length == 0 || isTokenizableInput(data, length, &isAscii) == false){
+    return NULL;
+  }
+
+  return tokenizeCheckedGPXdoc(ctx, data, length, isAscii, NULL, 0);
+}
+
+// Returns true if the markup at tag (just past its '<') can be part of a run of points: a <trkpt> start tag, a comment or a
+// processing instruction.
+bool isTokenChunkMarkup(const char * tag, const char * end){
+  size_t len = strlen(TRKPT);
+
+  if(tag < end && (*tag == '!' || *tag == '?')){
+    return true;
+  }
+
+  return (size_t) (end - tag) > len && memcmp(tag, TRKPT, len) == EQUAL_STRINGS &&
+         (TOKEN_CLASS(tag[len], TOKEN_SPACE) || tag[len] == '>' || tag[len] == '/');
+}
+
+void tokenizeGPXChunk(GPXParseContext * ctx, const char * end, GPXChunk * chunks, int numChunks, int index){
+  GPXChunk * chunk = &chunks[index];
+  Tokenizer tok;
+  bool succeeded = true;
+  int nextChunk = index + 1;
+
+  chunk->stop = NULL;
+  chunk->points = NULL;
+
+  initTokenizer(&tok, ctx, chunk->start, end);
+  tok.partialScope = true;
+
+  // The points go into a track and segment of their own. The builder stands where it would be between two points of a
+  // <trkseg> inside a <trk>, except that the <trk> isn't open as an owner - it has nothing to do with the points themselves.
+  tok.builder.gpx = newGPXdoc(ctx, "\0", "\0", "\0");
+  succeeded = (tok.builder.gpx != NULL && openTrackSegment(tok.builder.gpx) != NULL);
+
+  tok.seenRoot = true;
+  tok.depth = CHUNK_DEPTH;
+
+  for(int i = 0; i < CHUNK_DEPTH; i++){
+    tok.open[i].text = NULL;
+    tok.open[i].len = 0;
+  }
+
+  while(succeeded == true){
+    const char * tag = memchr(tok.cur, '<', (size_t) (tok.end - tok.cur));
+
+    if(tag == NULL){ // The segment never ends.
+      succeeded = false;
+      break;
+    }
+
+    succeeded = readTokenText(&tok, tok.cur, tag);
+    tok.cur = tag;
+
+    if(succeeded == false){
+      break;
+    }
+
+    if(tok.depth == CHUNK_DEPTH){
+      while(nextChunk < numChunks && chunks[nextChunk].start < tag){
+        nextChunk++;
+      }
+
+      // The next chunk carries on from here, or the points have run out.
+      if((nextChunk < numChunks && chunks[nextChunk].start == tag) || isTokenChunkMarkup(tag + 1, tok.end) == false){
+        chunk->stop = tag;
+        break;
+      }
+    }
+
+    tok.cur++;
+    succeeded = readTokenMarkup(&tok);
+  }
+
+  freeStreamText(&tok.values);
+  freeStreamText(&tok.localName);
+  chunk->points = finishStreamState(&tok.builder, succeeded);
+}
+
+// Falls back to libxml2 for anything the tokenizer doesn't take, so the answer - and the error, if there is one - comes from libxml2.
+GPXdoc * buildGPXdocWithFallback(GPXParseContext * ctx, const char * data, size_t length, const char * url){
+  GPXdoc * gpx = tokenizeGPXdoc(ctx, data, length);
+
+  if(gpx == NULL){ // Not something the tokenizer handles (or not valid at all) - let libxml2 decide.
+    if(ctx != NULL){
+      ctx->stats.numFallbacks++;
+    }
+
+    gpx = buildGPXdocFromBuffer(ctx, data, length, url);
+  }
+
+  return gpx;
+}
+
+GPXdoc * createGPXdocFastFromMemoryCtx(GPXParseContext * ctx, const char * buffer, size_t length){
+  beginGPXParse(ctx);
+
+  if(buffer == NULL || length == 0){
+    setGPXParseError(ctx, GPX_ERROR_ARGUMENT, NULL);
+    return finishGPXParse(ctx, NULL);
+  }
+
+  return finishGPXParse(ctx, buildGPXdocWithFallback(ctx, buffer, length, NULL));
+}
+
+GPXdoc * createGPXdocFastFromMemory(const char * buffer, size_t length){
+  return createGPXdocFastFromMemoryCtx(NULL, buffer, length);
+}
+
+GPXdoc * createGPXdocFastCtx(GPXParseContext * ctx, char * fileName){
+  size_t length = 0;
+
+  beginGPXParse(ctx);
+
+  char * data = mapGPXFile(ctx, fileName, &length);
+
+  if(data == NULL){
+    return finishGPXParse(ctx, NULL);
+  }
+
+  GPXdoc * gpx = buildGPXdocWithFallback(ctx, data, length, fileName);
+
+  unmapGPXFile(data, length);
+
+  return finishGPXParse(ctx, gpx);
+}
+
+GPXdoc * createGPXdocFast(char * fileName){
+  return createGPXdocFastCtx(NULL, fileName);
+}
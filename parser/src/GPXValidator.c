@@ -0,0 +1,645 @@
+/* Filename: GPXValidator.c
+ * Description: Checks a GPXdoc against the GPX 1.1 rules directly on the structs, without building an XML tree or loading
+ *              the schema. It answers the same question validateGPXDoc does - would the document writeGPXdoc produces for this
+ *              GPXdoc be valid against gpx.xsd, and does the GPXdoc meet the model's own requirements - in a single walk over
+ *              the lists, so it is cheap enough to run after every edit. The checks follow what writeGPXdoc writes: the version
+ *              with one decimal place, coordinates with six, a waypoint's name as its first child and then the GPXData in list
+ *              order.
+ */
+
+#include "GPXHelpers.h"
+#include <stdarg.h>
+#include <limits.h>
+
+// What the text of a GPXData child has to look like.
+typedef enum {
+  GPX_VALUE_STRING = 0,
+  GPX_VALUE_DECIMAL,
+  GPX_VALUE_DATE_TIME,
+  GPX_VALUE_DEGREES,
+  GPX_VALUE_FIX,
+  GPX_VALUE_COUNT,
+  GPX_VALUE_STATION,
+  GPX_VALUE_LINK,
+  GPX_VALUE_EXTENSIONS
+} GPXValueType;
+
+// One child in the schema's sequence for an element. Only <link> may repeat.
+typedef struct {
+  const char * name;
+  GPXValueType type;
+  bool repeats;
+} GPXChildRule;
+
+// The children of wptType (used for <wpt>, <rtept> and <trkpt>), in the order the schema requires.
+const GPXChildRule waypointChildRules[] = {
+  { "ele", GPX_VALUE_DECIMAL, false },
+  { "time", GPX_VALUE_DATE_TIME, false },
+  { "magvar", GPX_VALUE_DEGREES, false },
+  { "geoidheight", GPX_VALUE_DECIMAL, false },
+  { "name", GPX_VALUE_STRING, false },
+  { "cmt", GPX_VALUE_STRING, false },
+  { "desc", GPX_VALUE_STRING, false },
+  { "src", GPX_VALUE_STRING, false },
+  { "link", GPX_VALUE_LINK, true },
+  { "sym", GPX_VALUE_STRING, false },
+  { "type", GPX_VALUE_STRING, false },
+  { "fix", GPX_VALUE_FIX, false },
+  { "sat", GPX_VALUE_COUNT, false },
+  { "hdop", GPX_VALUE_DECIMAL, false },
+  { "vdop", GPX_VALUE_DECIMAL, false },
+  { "pdop", GPX_VALUE_DECIMAL, false },
+  { "ageofdgpsdata", GPX_VALUE_DECIMAL, false },
+  { "dgpsid", GPX_VALUE_STATION, false },
+  { "extensions", GPX_VALUE_EXTENSIONS, false }
+};
+
+// The simple children of rteType and trkType. Their points and segments come after all of these.
+const GPXChildRule ownerChildRules[] = {
+  { "name", GPX_VALUE_STRING, false },
+  { "cmt", GPX_VALUE_STRING, false },
+  { "desc", GPX_VALUE_STRING, false },
+  { "src", GPX_VALUE_STRING, false },
+  { "link", GPX_VALUE_LINK, true },
+  { "number", GPX_VALUE_COUNT, false },
+  { "type", GPX_VALUE_STRING, false },
+  { "extensions", GPX_VALUE_EXTENSIONS, false }
+};
+
+#define NUM_WAYPOINT_CHILD_RULES (int) (sizeof(waypointChildRules) / sizeof(waypointChildRules[0]))
+#define NUM_OWNER_CHILD_RULES (int) (sizeof(ownerChildRules) / sizeof(ownerChildRules[0]))
+
+#define NO_RULE -1
+#define GPX_VERSION "1.1"
+#define MAX_STATION_ID 1023
+#define MAX_DEGREES 360
+#define MAX_ZONE_MINUTES (14 * 60)
+#define MAX_SCHEMA_DIGITS 24
+
+// Coordinates this far inside their range can't be pushed out of it by rounding to six places, so they don't need printing.
+#define SAFE_LATITUDE 89.0
+#define SAFE_LONGITUDE 179.0
+
+// Where the walk is, so a failure can say which element it was about. Indexes count from 1; 0 means "not inside one".
+typedef struct {
+  GPXParseContext * ctx;
+  const char * owner;
+  int ownerIndex;
+  int segmentIndex;
+  int pointIndex;
+} StructureCheck;
+
+// Records why the document is invalid (when there is a context to record it in) and returns false.
+bool reportStructureError(StructureCheck * check, const char * format, ...){
+  if(check->ctx == NULL){
+    return false;
+  }
+
+  char location[MAX_READ_CHARS] = "document";
+  char message[MAX_ERROR_MESSAGE];
+  va_list args;
+
+  if(check->owner != NULL && check->segmentIndex > 0){
+    snprintf(location, sizeof(location), "%s %d, segment %d, point %d", check->owner, check->ownerIndex, check->segmentIndex,
+             check->pointIndex);
+  }
+  else if(check->owner != NULL && check->pointIndex > 0){
+    snprintf(location, sizeof(location), "%s %d, point %d", check->owner, check->ownerIndex, check->pointIndex);
+  }
+  else if(check->owner != NULL){
+    snprintf(location, sizeof(location), "%s %d", check->owner, check->ownerIndex);
+  }
+
+  size_t used = (size_t) snprintf(message, sizeof(message), "%s: ", location);
+
+  va_start(args, format);
+  vsnprintf(message + used, sizeof(message) - used, format, args);
+  va_end(args);
+
+  setGPXParseError(check->ctx, GPX_ERROR_INVALID, message);
+
+  return false;
+}
+
+/* Simple types */
+
+bool isSchemaSpace(char c){
+  return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+// Trims the whitespace the schema's "collapse" rule ignores around the value of every non-string type.
+const char * trimSchemaValue(const char * text, size_t * len){
+  size_t end = strlen(text);
+
+  while(isSchemaSpace(*text) == true){
+    text++;
+    end--;
+  }
+
+  while(end > 0 && isSchemaSpace(text[end - 1]) == true){
+    end--;
+  }
+
+  *len = end;
+
+  return text;
+}
+
+// An xsd:decimal split into the parts the range checks need. The integer part saturates at LONG_MAX.
+typedef struct {
+  bool negative;
+  long integer;
+  bool fraction; // true if there are non-zero digits after the point
+} SchemaDecimal;
+
+// Reads an xsd:decimal: an optional sign and digits with an optional point, but no exponent. With allowFraction false it
+// reads an xsd:integer instead. Like libxml2, it rejects numbers with more than MAX_SCHEMA_DIGITS digits, not counting
+// leading zeros before the point.
+bool parseSchemaDecimal(const char * text, bool allowFraction, SchemaDecimal * value){
+  size_t len;
+  const char * p = trimSchemaValue(text, &len);
+  const char * end = p + len;
+  int numDigits = 0;
+  int numCounted = 0;
+
+  value->negative = false;
+  value->integer = 0;
+  value->fraction = false;
+
+  if(p < end && (*p == '+' || *p == '-')){
+    value->negative = (*p == '-');
+    p++;
+  }
+
+  for(; p < end && *p >= '0' && *p <= '9'; p++, numDigits++){
+    int digit = *p - '0';
+
+    value->integer = (value->integer > (LONG_MAX - digit) / 10) ? LONG_MAX : value->integer * 10 + digit;
+    numCounted += (numCounted > 0 || digit != 0) ? 1 : 0;
+  }
+
+  if(p < end && *p == '.' && allowFraction == true){
+    for(p++; p < end && *p >= '0' && *p <= '9'; p++, numDigits++, numCounted++){
+      value->fraction = value->fraction || *p != '0';
+    }
+  }
+
+  return p == end && numDigits > 0 && numCounted <= MAX_SCHEMA_DIGITS;
+}
+
+bool isSchemaZero(const SchemaDecimal * value){
+  return value->integer == 0 && value->fraction == false;
+}
+
+// value <= limit, for a non-negative whole limit
+bool isAtMost(const SchemaDecimal * value, long limit){
+  return value->negative == true || isSchemaZero(value) == true || value->integer < limit ||
+         (value->integer == limit && value->fraction == false);
+}
+
+// value >= -limit, for a non-negative whole limit
+bool isAtLeastNegative(const SchemaDecimal * value, long limit){
+  return value->negative == false || value->integer < limit || (value->integer == limit && value->fraction == false);
+}
+
+// value < limit, for a positive whole limit
+bool isBelow(const SchemaDecimal * value, long limit){
+  return value->negative == true || value->integer < limit;
+}
+
+bool isLeapYear(long year){
+  return (year % 4 == 0 && year % 100 != 0) || year % 400 == 0;
+}
+
+// Reads exactly count digits into value.
+bool readSchemaDigits(const char ** p, const char * end, int count, long * value){
+  *value = 0;
+
+  for(int i = 0; i < count; i++, (*p)++){
+    if(*p == end || **p < '0' || **p > '9'){
+      return false;
+    }
+
+    *value = *value * 10 + (**p - '0');
+  }
+
+  return true;
+}
+
+// Reads an xsd:dateTime: [-]CCYY-MM-DDThh:mm:ss[.s+][Z|(+|-)hh:mm], with the same limits libxml2 applies. libxml2 doesn't
+// allow whitespace before a date, and only allows it after one that ends in a time zone.
+bool isSchemaDateTime(const char * text){
+  const char * p = text;
+  const char * end = text + strlen(text);
+  long year = 0;
+  long month, day, hour, minute, second;
+
+  if(p < end && *p == '-'){
+    p++;
+  }
+
+  const char * yearStart = p;
+
+  while(p < end && *p >= '0' && *p <= '9'){
+    year = (year > 99999999) ? year : year * 10 + (*p - '0');
+    p++;
+  }
+
+  // At least four digits, and no leading zero unless there are exactly four. Year 0 doesn't exist.
+  if(p - yearStart < 4 || (p - yearStart > 4 && *yearStart == '0') || year == 0){
+    return false;
+  }
+
+  if(p == end || *p++ != '-' || readSchemaDigits(&p, end, 2, &month) == false || p == end || *p++ != '-' ||
+     readSchemaDigits(&p, end, 2, &day) == false || p == end || *p++ != 'T' || readSchemaDigits(&p, end, 2, &hour) == false ||
+     p == end || *p++ != ':' || readSchemaDigits(&p, end, 2, &minute) == false || p == end || *p++ != ':' ||
+     readSchemaDigits(&p, end, 2, &second) == false){
+    return false;
+  }
+
+  const int daysInMonth[] = { 31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31 };
+
+  if(month < 1 || month > 12 || day < 1 || hour > 24 || minute > 59 || second > 59){
+    return false;
+  }
+
+  if(day > daysInMonth[month - 1] && (month != 2 || day != 29 || isLeapYear(year) == false)){
+    return false;
+  }
+
+  bool fraction = false;
+
+  if(p < end && *p == '.'){
+    const char * fractionStart = ++p;
+
+    while(p < end && *p >= '0' && *p <= '9'){
+      fraction = fraction || *p != '0';
+      p++;
+    }
+
+    if(p == fractionStart){
+      return false;
+    }
+  }
+
+  // 24:00:00 is midnight at the end of the day; any other time in hour 24 doesn't exist.
+  if(hour == 24 && (minute != 0 || second != 0 || fraction == true)){
+    return false;
+  }
+
+  if(p < end && *p == 'Z'){
+    p++;
+  }
+  else if(p < end && (*p == '+' || *p == '-')){
+    long zoneHours, zoneMinutes;
+
+    p++;
+
+    if(readSchemaDigits(&p, end, 2, &zoneHours) == false || p == end || *p++ != ':' ||
+       readSchemaDigits(&p, end, 2, &zoneMinutes) == false || zoneHours > 23 || zoneMinutes > 59 ||
+       zoneHours * 60 + zoneMinutes > MAX_ZONE_MINUTES){
+      return false;
+    }
+  }
+  else{
+    return p == end;
+  }
+
+  while(p < end && isSchemaSpace(*p) == true){
+    p++;
+  }
+
+  return p == end;
+}
+
+bool isSchemaValue(GPXValueType type, const char * value){
+  SchemaDecimal number;
+  size_t len;
+
+  switch(type){
+    case GPX_VALUE_STRING:
+      return true;
+    case GPX_VALUE_DECIMAL:
+      return parseSchemaDecimal(value, true, &number);
+    case GPX_VALUE_DATE_TIME:
+      return isSchemaDateTime(value);
+    case GPX_VALUE_DEGREES:
+      return parseSchemaDecimal(value, true, &number) == true && (number.negative == false || isSchemaZero(&number) == true) &&
+             isBelow(&number, MAX_DEGREES) == true;
+    case GPX_VALUE_FIX: // An enumeration on xsd:string, so the whitespace counts.
+      return strcmp(value, "none") == EQUAL_STRINGS || strcmp(value, "2d") == EQUAL_STRINGS || strcmp(value, "3d") == EQUAL_STRINGS ||
+             strcmp(value, "dgps") == EQUAL_STRINGS || strcmp(value, "pps") == EQUAL_STRINGS;
+    case GPX_VALUE_COUNT:
+      return parseSchemaDecimal(value, false, &number) == true && (number.negative == false || isSchemaZero(&number) == true);
+    case GPX_VALUE_STATION:
+      return parseSchemaDecimal(value, false, &number) == true && (number.negative == false || isSchemaZero(&number) == true) &&
+             isAtMost(&number, MAX_STATION_ID) == true;
+    case GPX_VALUE_LINK: // linkType needs an href attribute, and GPXData has nowhere to keep one.
+      return false;
+    case GPX_VALUE_EXTENSIONS: // Element-only content - written out as text, only whitespace is allowed.
+      trimSchemaValue(value, &len);
+      return len == 0;
+    default:
+      return false;
+  }
+}
+
+const char * describeSchemaValue(GPXValueType type){
+  switch(type){
+    case GPX_VALUE_DECIMAL:
+      return "a decimal number";
+    case GPX_VALUE_DATE_TIME:
+      return "a date and time";
+    case GPX_VALUE_DEGREES:
+      return "an angle from 0 up to 360";
+    case GPX_VALUE_FIX:
+      return "one of none, 2d, 3d, dgps or pps";
+    case GPX_VALUE_COUNT:
+      return "a non-negative whole number";
+    case GPX_VALUE_STATION:
+      return "a whole number from 0 to 1023";
+    case GPX_VALUE_LINK:
+      return "representable (a link needs an href attribute)";
+    case GPX_VALUE_EXTENSIONS:
+      return "empty (extensions can only hold elements)";
+    default:
+      return "text";
+  }
+}
+
+/* Elements */
+
+int findChildRule(const GPXChildRule * rules, int numRules, const char * name){
+  for(int i = 0; i < numRules; i++){
+    if(strcmp(rules[i].name, name) == EQUAL_STRINGS){
+      return i;
+    }
+  }
+
+  return NO_RULE;
+}
+
+// Checks one simple child: it must be allowed, its value must have the right format, and it must come later in the schema's
+// sequence than the child before it (at *position), unless it is one that may repeat. Moves *position on to it.
+bool checkChild(StructureCheck * check, const GPXChildRule * rules, int numRules, int * position, const char * name, const char * value){
+  int rule = findChildRule(rules, numRules, name);
+
+  if(rule == NO_RULE){
+    return reportStructureError(check, "<%s> is not allowed here", name);
+  }
+
+  if(rule < *position || (rule == *position && rules[rule].repeats == false)){
+    return reportStructureError(check, "<%s> is repeated or out of order", name);
+  }
+
+  if(isSchemaValue(rules[rule].type, value) == false){
+    return reportStructureError(check, "<%s> is not %s", name, describeSchemaValue(rules[rule].type));
+  }
+
+  *position = rule;
+
+  return true;
+}
+
+// Checks the simple children of an element in the order writeGPXdoc writes them: a waypoint's typed elevation and time (waypoint
+// is NULL for routes and tracks), then otherData, with the name (if there is one) before the first of otherData that the schema
+// puts after it.
+bool checkChildStructure(StructureCheck * check, const GPXChildRule * rules, int numRules, const char * name, const Waypoint * waypoint,
+                         List * otherData){
+  int position = NO_RULE;
+  char typed[DOUBLE_CHARS];
+
+  if(name == NULL){
+    return reportStructureError(check, "the name is NULL");
+  }
+
+  if(otherData == NULL){
+    return reportStructureError(check, "the otherData list is NULL");
+  }
+
+  if(waypoint != NULL && isnan(waypoint->elevation) == false){
+    formatGPXNumber(waypoint->elevation, typed);
+
+    if(checkChild(check, rules, numRules, &position, ELE, typed) == false){
+      return false;
+    }
+  }
+
+  if(waypoint != NULL && waypoint->time != GPX_NO_TIME){
+    formatGPXTime(waypoint->time, typed);
+
+    if(checkChild(check, rules, numRules, &position, TIME, typed) == false){
+      return false;
+    }
+  }
+
+  int nameRule = findChildRule(rules, numRules, NAME);
+  bool namePending = (strcmp(name, "\0") != EQUAL_STRINGS);
+  ListIterator iterator = createIterator(otherData);
+  void * element;
+
+  while((element = nextElement(&iterator)) != NULL){
+    GPXData * gpxData = (GPXData *) element;
+
+    if(gpxData->name == NULL || strcmp(gpxData->name, "\0") == EQUAL_STRINGS){
+      return reportStructureError(check, "a GPXData has an empty name");
+    }
+
+    if(strcmp(gpxData->value, "\0") == EQUAL_STRINGS){
+      return reportStructureError(check, "<%s> has an empty value", gpxData->name);
+    }
+
+    int rule = findChildRule(rules, numRules, gpxData->name);
+
+    if(namePending == true && (rule == NO_RULE || rule >= nameRule)){
+      if(checkChild(check, rules, numRules, &position, NAME, name) == false){
+        return false;
+      }
+
+      namePending = false;
+    }
+
+    if(checkChild(check, rules, numRules, &position, gpxData->name, gpxData->value) == false){
+      return false;
+    }
+  }
+
+  if(namePending == true){
+    return checkChild(check, rules, numRules, &position, NAME, name);
+  }
+
+  return true;
+}
+
+// Checks a coordinate against -limit <= value <= limit, and then checks it again as writeGPXdoc writes it (six decimal
+// places) against the schema's range, which excludes the upper limit when maxIncluded is false.
+bool isCoordinateInRange(double value, double safe, long limit, bool maxIncluded){
+  if(value > -safe && value < safe){
+    return true;
+  }
+
+  if((value >= -limit && value <= limit) == false){ // Also catches nan.
+    return false;
+  }
+
+  char buffer[DOUBLE_CHARS];
+  SchemaDecimal number;
+
+  snprintf(buffer, sizeof(buffer), "%f", value);
+
+  if(parseSchemaDecimal(buffer, true, &number) == false || isAtLeastNegative(&number, limit) == false){
+    return false;
+  }
+
+  return (maxIncluded == true) ? isAtMost(&number, limit) : isBelow(&number, limit);
+}
+
+bool checkWaypointStructure(StructureCheck * check, Waypoint * waypoint){
+  if(isCoordinateInRange(waypoint->latitude, SAFE_LATITUDE, (long) MAX_LATITUDE, true) == false){
+    return reportStructureError(check, "latitude %f is out of range", waypoint->latitude);
+  }
+
+  if(isCoordinateInRange(waypoint->longitude, SAFE_LONGITUDE, (long) MAX_LONGITUDE, false) == false){
+    return reportStructureError(check, "longitude %f is out of range", waypoint->longitude);
+  }
+
+  return checkChildStructure(check, waypointChildRules, NUM_WAYPOINT_CHILD_RULES, waypoint->name, waypoint, waypoint->otherData);
+}
+
+bool checkPointListStructure(StructureCheck * check, List * waypoints){
+  if(waypoints == NULL){
+    return reportStructureError(check, "the waypoints list is NULL");
+  }
+
+  ListIterator iterator = createIterator(waypoints);
+  void * element;
+
+  check->pointIndex = 0;
+
+  while((element = nextElement(&iterator)) != NULL){
+    check->pointIndex++;
+
+    if(checkWaypointStructure(check, (Waypoint *) element) == false){
+      return false;
+    }
+  }
+
+  check->pointIndex = 0;
+
+  return true;
+}
+
+bool checkRouteStructure(StructureCheck * check, Route * route){
+  if(checkChildStructure(check, ownerChildRules, NUM_OWNER_CHILD_RULES, route->name, NULL, route->otherData) == false){
+    return false;
+  }
+
+  return checkPointListStructure(check, route->waypoints);
+}
+
+bool checkTrackStructure(StructureCheck * check, Track * track){
+  if(checkChildStructure(check, ownerChildRules, NUM_OWNER_CHILD_RULES, track->name, NULL, track->otherData) == false){
+    return false;
+  }
+
+  if(track->segments == NULL){
+    return reportStructureError(check, "the segments list is NULL");
+  }
+
+  ListIterator iterator = createIterator(track->segments);
+  void * element;
+
+  check->segmentIndex = 0;
+
+  while((element = nextElement(&iterator)) != NULL){
+    check->segmentIndex++;
+
+    if(checkPointListStructure(check, ((TrackSegment *) element)->waypoints) == false){
+      return false;
+    }
+  }
+
+  check->segmentIndex = 0;
+
+  return true;
+}
+
+bool checkGPXdocStructure(StructureCheck * check, const GPXdoc * doc){
+  char version[DOUBLE_CHARS];
+
+  if(strcmp(doc->namespace, DEFAULT_NAMESPACE) != EQUAL_STRINGS){
+    return reportStructureError(check, "the namespace is not %s", DEFAULT_NAMESPACE);
+  }
+
+  snprintf(version, sizeof(version), "%.1f", doc->version);
+
+  if(strcmp(version, GPX_VERSION) != EQUAL_STRINGS){
+    return reportStructureError(check, "the version is not %s", GPX_VERSION);
+  }
+
+  if(doc->creator == NULL || strcmp(doc->creator, "\0") == EQUAL_STRINGS){
+    return reportStructureError(check, "the creator is empty");
+  }
+
+  if(doc->waypoints == NULL || doc->routes == NULL || doc->tracks == NULL){
+    return reportStructureError(check, "a list is NULL");
+  }
+
+  ListIterator waypoints = createIterator(doc->waypoints);
+  ListIterator routes = createIterator(doc->routes);
+  ListIterator tracks = createIterator(doc->tracks);
+  void * element;
+
+  check->owner = WPT;
+  check->ownerIndex = 0;
+
+  while((element = nextElement(&waypoints)) != NULL){
+    check->ownerIndex++;
+
+    if(checkWaypointStructure(check, (Waypoint *) element) == false){
+      return false;
+    }
+  }
+
+  check->owner = RTE;
+  check->ownerIndex = 0;
+
+  while((element = nextElement(&routes)) != NULL){
+    check->ownerIndex++;
+
+    if(checkRouteStructure(check, (Route *) element) == false){
+      return false;
+    }
+  }
+
+  check->owner = TRK;
+  check->ownerIndex = 0;
+
+  while((element = nextElement(&tracks)) != NULL){
+    check->ownerIndex++;
+
+    if(checkTrackStructure(check, (Track *) element) == false){
+      return false;
+    }
+  }
+
+  return true;
+}
+
+/* *****************************************************************************PUBLIC API****************************************************************************** */
+
+bool validateGPXDocStructureCtx(GPXParseContext * ctx, const GPXdoc * doc){
+  StructureCheck check = { ctx, NULL, 0, 0, 0 };
+
+  beginGPXParse(ctx);
+
+  if(doc == NULL){
+    return finishGPXCall(ctx, false, GPX_ERROR_ARGUMENT);
+  }
+
+  return finishGPXCall(ctx, checkGPXdocStructure(&check, doc), GPX_ERROR_INVALID);
+}
+
+bool validateGPXDocStructure(const GPXdoc * doc){
+  return validateGPXDocStructureCtx(NULL, doc);
+}
@@ -8,25 +8,74 @@
 *@param compareFunction function pointer to compare two nodes of the list in order to test for equality or order
 **/
 List * initializeList(char* (*printFunction)(void* toBePrinted),void (*deleteFunction)(void* toBeDeleted),int (*compareFunction)(const void* first,const void* second)){
+	return initializeListWithAllocator(printFunction, deleteFunction, compareFunction, NULL);
+}
+
+/** Function to initialize a list whose List struct and Nodes come from an allocator instead of malloc.
+*@return pointer to the list head, or NULL if the allocation fails
+*@param printFunction function pointer to print a single node of the list
+*@param deleteFunction function pointer to delete a single piece of data from the list
+*@param compareFunction function pointer to compare two nodes of the list in order to test for equality or order
+*@param allocator the allocator, or NULL for malloc and free
+**/
+List * initializeListWithAllocator(char* (*printFunction)(void* toBePrinted),void (*deleteFunction)(void* toBeDeleted),int (*compareFunction)(const void* first,const void* second),ListAllocator* allocator){
     //Asserts create a partial function...
     assert(printFunction != NULL);
     assert(deleteFunction != NULL);
     assert(compareFunction != NULL);
 
-    List * tmpList = malloc(sizeof(List));
+    List * tmpList;
+
+	if (allocator == NULL){
+		tmpList = malloc(sizeof(List));
+	}else{
+		tmpList = allocator->allocateList(allocator);
+	}
+
+	if (tmpList == NULL){
+		return NULL;
+	}
 	
 	tmpList->head = NULL;
 	tmpList->tail = NULL;
 
 	tmpList->length = 0;
+	tmpList->changes = 0;
 
 	tmpList->deleteData = deleteFunction;
 	tmpList->compare = compareFunction;
 	tmpList->printData = printFunction;
+	tmpList->allocator = allocator;
 	
 	return tmpList;
 }
 
+//Creates a node with the list's allocator.  initializeNode is the malloc version.
+Node* allocateNode(List* list, void* data){
+	if (list->allocator == NULL){
+		return initializeNode(data);
+	}
+
+	Node* tmpNode = list->allocator->allocateNode(list->allocator);
+	
+	if (tmpNode == NULL){
+		return NULL;
+	}
+	
+	tmpNode->data = data;
+	tmpNode->previous = NULL;
+	tmpNode->next = NULL;
+	
+	return tmpNode;
+}
+
+void releaseNode(List* list, Node* node){
+	if (list->allocator == NULL){
+		free(node);
+	}else{
+		list->allocator->releaseNode(list->allocator, node);
+	}
+}
 
 /** Deletes the entire linked list, freeing all memory.
 * uses the supplied function pointer to release allocated memory for the data
@@ -36,8 +85,17 @@ List * initializeList(char* (*printFunction)(void* toBePrinted),void (*deleteFun
 **/
 void freeList(List* list){	
 
+	if (list == NULL){
+		return;
+	}
+
     clearList(list);
-	free(list);
+
+	if (list->allocator == NULL){
+		free(list);
+	}else{
+		list->allocator->releaseList(list->allocator, list);
+	}
 }
 
 /** Clears the list: frees the contents of the list - Node structs and data stored in them - 
@@ -63,12 +121,13 @@ void clearList(List* list){
 		list->deleteData(list->head->data);
 		tmp = list->head;
 		list->head = list->head->next;
-		free(tmp);
+		releaseNode(list, tmp);
 	}
 	
 	list->head = NULL;
 	list->tail = NULL;
 	list->length = 0;
+	(list->changes)++;
 }
 
 /**Function for creating a node for the linked list. 
@@ -99,15 +158,21 @@ Node* initializeNode(void* data){
 *@pre 'List' type must exist and be used in order to keep track of the linked list.
 *@param list pointer to the dummy head of the list
 *@param toBeAdded a pointer to data that is to be added to the linked list
+*@return true if the data was added, false if it is still the caller's
 **/
-void insertBack(List* list, void* toBeAdded){
+bool insertBack(List* list, void* toBeAdded){
 	if (list == NULL || toBeAdded == NULL){
-		return;
+		return false;
 	}
 	
-	(list->length)++;
+	Node* newNode = allocateNode(list, toBeAdded);
 
-	Node* newNode = initializeNode(toBeAdded);
+	if (newNode == NULL){
+		return false;
+	}
+
+	(list->length)++;
+	(list->changes)++;
 	
     if (list->head == NULL && list->tail == NULL){
         list->head = newNode;
@@ -117,6 +182,8 @@ void insertBack(List* list, void* toBeAdded){
         list->tail->next = newNode;
     	list->tail = newNode;
     }
+
+	return true;
 }
 
 /**Inserts a Node at the front of a linked list.  List metadata is updated
@@ -124,15 +191,21 @@ void insertBack(List* list, void* toBeAdded){
 *@pre 'List' type must exist and be used in order to keep track of the linked list.
 *@param list pointer to the dummy head of the list
 *@param toBeAdded a pointer to data that is to be added to the linked list
+*@return true if the data was added, false if it is still the caller's
 **/
-void insertFront(List* list, void* toBeAdded){
+bool insertFront(List* list, void* toBeAdded){
 	if (list == NULL || toBeAdded == NULL){
-		return;
+		return false;
 	}
 	
-	(list->length)++;
+	Node* newNode = allocateNode(list, toBeAdded);
 
-	Node* newNode = initializeNode(toBeAdded);
+	if (newNode == NULL){
+		return false;
+	}
+
+	(list->length)++;
+	(list->changes)++;
 	
     if (list->head == NULL && list->tail == NULL){
         list->head = newNode;
@@ -142,6 +215,8 @@ void insertFront(List* list, void* toBeAdded){
         list->head->previous = newNode;
     	list->head = newNode;
     }
+
+	return true;
 }
 
 /**Returns a pointer to the data at the front of the list. Does not alter list structure.
@@ -195,9 +270,10 @@ void* deleteDataFromList(List* list, void* toBeDeleted){
 			}
 			
 			void* data = delNode->data;
-			free(delNode);
+			releaseNode(list, delNode);
 			
 			(list->length)--;
+			(list->changes)++;
 
 			return data;
 			
@@ -218,25 +294,23 @@ void* deleteDataFromList(List* list, void* toBeDeleted){
 *@param list a pointer to the dummy head of the list containing function pointers for delete and compare, as well 
 as a pointer to the first and last element of the list.
 *@param toBeAdded a pointer to data that is to be added to the linked list
+*@return true if the data was added, false if it is still the caller's
 **/
-void insertSorted(List *list, void *toBeAdded){
+bool insertSorted(List *list, void *toBeAdded){
 	if (list == NULL || toBeAdded == NULL){
-		return;
+		return false;
 	}
 
 	if (list->head == NULL){
-		insertBack(list, toBeAdded);
-		return;
+		return insertBack(list, toBeAdded);
 	}
 	
 	if (list->compare(toBeAdded, list->head->data) <= 0){
-		insertFront(list, toBeAdded);
-		return;
+		return insertFront(list, toBeAdded);
 	}
 	
 	if (list->compare(toBeAdded, list->tail->data) > 0){
-		insertBack(list, toBeAdded);
-		return;
+		return insertBack(list, toBeAdded);
 	}
 	
 	Node* currNode = list->head;
@@ -252,20 +326,26 @@ void insertSorted(List *list, void *toBeAdded){
 			free(currDescr);
 			free(newDescr);
 		
-			Node* newNode = initializeNode(toBeAdded);
+			Node* newNode = allocateNode(list, toBeAdded);
+
+			if (newNode == NULL){
+				return false;
+			}
+
 			newNode->next = currNode;
 			newNode->previous = currNode->previous;
 			currNode->previous->next = newNode;
 			currNode->previous = newNode;
 			(list->length)++;
+			(list->changes)++;
 
-			return;
+			return true;
 		}
 	
 		currNode = currNode->next;
 	}
 	
-	return;
+	return false;
 }
 
 /**Returns a string that contains a string representation of the list traversed from  head to tail. 
@@ -336,3 +416,319 @@ void* findElement(List * list, bool (*customCompare)(const void* first,const voi
 
 	return NULL;
 }
+
+void appendList(List* dest, List* src){
+	if (dest == NULL || src == NULL || dest == src || src->head == NULL){
+		return;
+	}
+
+	if (dest->tail == NULL){
+		dest->head = src->head;
+	}else{
+		dest->tail->next = src->head;
+		src->head->previous = dest->tail;
+	}
+
+	dest->tail = src->tail;
+	dest->length += src->length;
+	(dest->changes)++;
+
+	src->head = NULL;
+	src->tail = NULL;
+	src->length = 0;
+	(src->changes)++;
+}
+
+/* Node pools */
+
+#define MIN_NODES_PER_SLAB 64
+#define MAX_NODES_PER_SLAB 4096
+
+typedef struct nodeSlab{
+	struct nodeSlab* next;
+	Node nodes[];
+} NodeSlab;
+
+struct listNodePool{
+	ListAllocator allocator; //Must come first - the allocator is how a list finds its pool
+
+	NodeSlab* slabs;
+	size_t slabUsed; //How many Nodes of the newest slab have been handed out, and how many it has
+	size_t slabSize;
+	size_t nextSlabSize;
+
+	Node* freeNodes;
+
+	//The creator's reference plus one for each list that uses the pool
+	int references;
+};
+
+void freeNodePool(ListNodePool* pool){
+	NodeSlab* slab = pool->slabs;
+
+	while (slab != NULL){
+		NodeSlab* next = slab->next;
+		free(slab);
+		slab = next;
+	}
+
+	free(pool);
+}
+
+//The List structs of the pool's lists are malloc'd, and each one holds a reference to the pool.
+List* allocateListFromNodePool(ListAllocator* allocator){
+	ListNodePool* pool = (ListNodePool*)allocator;
+	List* list = malloc(sizeof(List));
+
+	if (list != NULL){
+		(pool->references)++;
+	}
+
+	return list;
+}
+
+void releaseListToNodePool(ListAllocator* allocator, List* list){
+	free(list);
+	releaseNodePool((ListNodePool*)allocator);
+}
+
+//Nodes come from the slabs.
+Node* allocateFromNodePool(ListAllocator* allocator){
+	ListNodePool* pool = (ListNodePool*)allocator;
+
+	if (pool->freeNodes != NULL){
+		Node* node = pool->freeNodes;
+		pool->freeNodes = node->next;
+
+		return node;
+	}
+
+	if (pool->slabs == NULL || pool->slabUsed == pool->slabSize){
+		NodeSlab* slab = malloc(sizeof(NodeSlab) + sizeof(Node) * pool->nextSlabSize);
+
+		if (slab == NULL){
+			return NULL;
+		}
+
+		slab->next = pool->slabs;
+		pool->slabs = slab;
+		pool->slabUsed = 0;
+		pool->slabSize = pool->nextSlabSize;
+
+		if (pool->nextSlabSize < MAX_NODES_PER_SLAB){
+			pool->nextSlabSize *= 2;
+		}
+	}
+
+	return &pool->slabs->nodes[(pool->slabUsed)++];
+}
+
+void releaseToNodePool(ListAllocator* allocator, Node* node){
+	ListNodePool* pool = (ListNodePool*)allocator;
+
+	node->next = pool->freeNodes;
+	pool->freeNodes = node;
+}
+
+ListNodePool* createNodePool(void){
+	ListNodePool* pool = malloc(sizeof(ListNodePool));
+
+	if (pool == NULL){
+		return NULL;
+	}
+
+	pool->allocator.allocateList = allocateListFromNodePool;
+	pool->allocator.releaseList = releaseListToNodePool;
+	pool->allocator.allocateNode = allocateFromNodePool;
+	pool->allocator.releaseNode = releaseToNodePool;
+	pool->slabs = NULL;
+	pool->slabUsed = 0;
+	pool->slabSize = 0;
+	pool->nextSlabSize = MIN_NODES_PER_SLAB;
+	pool->freeNodes = NULL;
+	pool->references = 1;
+
+	return pool;
+}
+
+ListAllocator* nodePoolAllocator(ListNodePool* pool){
+	return (pool == NULL) ? NULL : &pool->allocator;
+}
+
+void releaseNodePool(ListNodePool* pool){
+	if (pool == NULL){
+		return;
+	}
+
+	(pool->references)--;
+
+	if (pool->references == 0){
+		freeNodePool(pool);
+	}
+}
+
+ListNodePool* listNodePool(List* list){
+	if (list == NULL || list->allocator == NULL || list->allocator->allocateNode != allocateFromNodePool){
+		return NULL;
+	}
+
+	return (ListNodePool*)list->allocator;
+}
+
+void mergeNodePools(ListNodePool* dest, ListNodePool* src){
+	if (dest == NULL || src == NULL || dest == src || src->slabs == NULL){
+		return;
+	}
+
+	if (dest->slabs == NULL){
+		//dest takes over src's newest slab where src left off
+		dest->slabs = src->slabs;
+		dest->slabUsed = src->slabUsed;
+		dest->slabSize = src->slabSize;
+	}else{
+		//The slabs go in behind dest's newest slab, which dest carries on allocating from.  The rest of src's newest slab
+		//is given up, along with src's free Nodes - they are still in the slabs, so nothing leaks.
+		NodeSlab* last = src->slabs;
+
+		while (last->next != NULL){
+			last = last->next;
+		}
+
+		last->next = dest->slabs->next;
+		dest->slabs->next = src->slabs;
+	}
+
+	src->slabs = NULL;
+	src->slabUsed = 0;
+	src->slabSize = 0;
+	src->freeNodes = NULL;
+}
+
+/* Vectors */
+
+#define MIN_VECTOR_CAPACITY 16
+
+Vector* initializeVector(char* (*printFunction)(void* toBePrinted),void (*deleteFunction)(void* toBeDeleted),int (*compareFunction)(const void* first,const void* second)){
+	assert(printFunction != NULL);
+	assert(deleteFunction != NULL);
+	assert(compareFunction != NULL);
+
+	Vector* vector = malloc(sizeof(Vector));
+
+	if (vector == NULL){
+		return NULL;
+	}
+
+	vector->cells = NULL;
+	vector->length = 0;
+	vector->capacity = 0;
+	vector->deleteData = deleteFunction;
+	vector->compare = compareFunction;
+	vector->printData = printFunction;
+
+	return vector;
+}
+
+bool pushBack(Vector* vector, void* toBeAdded){
+	if (vector == NULL || toBeAdded == NULL){
+		return false;
+	}
+
+	if (vector->length == vector->capacity){
+		int capacity = (vector->capacity == 0) ? MIN_VECTOR_CAPACITY : vector->capacity * 2;
+		Node* cells = realloc(vector->cells, sizeof(Node) * capacity);
+
+		if (cells == NULL){
+			return false;
+		}
+
+		//The cells have moved, so the links between them have to be redone
+		for (int i = 1; i < vector->length; i++){
+			cells[i].previous = &cells[i - 1];
+			cells[i - 1].next = &cells[i];
+		}
+
+		vector->cells = cells;
+		vector->capacity = capacity;
+	}
+
+	Node* cell = &vector->cells[vector->length];
+
+	cell->data = toBeAdded;
+	cell->next = NULL;
+	cell->previous = NULL;
+
+	if (vector->length > 0){
+		cell->previous = cell - 1;
+		cell->previous->next = cell;
+	}
+
+	(vector->length)++;
+
+	return true;
+}
+
+void* getVectorElement(Vector* vector, int index){
+	if (vector == NULL || index < 0 || index >= vector->length){
+		return NULL;
+	}
+
+	return vector->cells[index].data;
+}
+
+int getVectorLength(Vector* vector){
+	if (vector == NULL){
+		return -1;
+	}
+
+	return vector->length;
+}
+
+void clearVector(Vector* vector){
+	if (vector == NULL){
+		return;
+	}
+
+	for (int i = 0; i < vector->length; i++){
+		vector->deleteData(vector->cells[i].data);
+	}
+
+	vector->length = 0;
+}
+
+void freeVector(Vector* vector){
+	if (vector == NULL){
+		return;
+	}
+
+	clearVector(vector);
+	free(vector->cells);
+	free(vector);
+}
+
+VectorIterator createVectorIterator(Vector* vector){
+	VectorIterator iter;
+
+	iter.vector = vector;
+	iter.index = 0;
+
+	return iter;
+}
+
+void* nextVectorElement(VectorIterator* iter){
+	void* data = getVectorElement(iter->vector, iter->index);
+
+	if (data != NULL){
+		(iter->index)++;
+	}
+
+	return data;
+}
+
+ListIterator createVectorListIterator(Vector* vector){
+	ListIterator iter;
+
+	iter.current = (vector == NULL || vector->length == 0) ? NULL : &vector->cells[0];
+
+	return iter;
+}
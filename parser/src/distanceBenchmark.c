@@ -0,0 +1,145 @@
+/* Filename: distanceBenchmark.c
+ * Description: Measures the speed and accuracy of the distance models. For a range of hop lengths it makes a random walk, measures
+ *              its length with getPathLen under each model, and prints the time per hop and how far each length is from the
+ *              Vincenty (ellipsoid) and haversine (sphere) ones. The last column is the length the old float code would have
+ *              got - float hops added up in a float - against the haversine one.
+ *              Build it with "make distanceBenchmark" and run it with bin/distanceBenchmark [points], with libgpxparser.so
+ *              on the library path.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "GPXParser.h"
+#include <time.h>
+
+#define DEFAULT_POINTS 100000
+#define REPEATS 5
+#define EARTH_MEAN_RADIUS 6371e3
+#define MAX_START_LATITUDE 60.0
+#define DEGREES_PER_RADIAN (180.0 / M_PI)
+
+const double hopLengths[] = { 10, 100, 1e3, 1e4, 1e5, 1e6 };
+const GPXDistanceModel models[] = { GPX_DISTANCE_HAVERSINE, GPX_DISTANCE_EQUIRECTANGULAR, GPX_DISTANCE_VINCENTY };
+const char * const modelNames[] = { "haversine", "equirectangular", "vincenty" };
+
+#define NUM_HOP_LENGTHS (sizeof(hopLengths) / sizeof(hopLengths[0]))
+#define NUM_MODELS (sizeof(models) / sizeof(models[0]))
+
+// A fixed generator, so that every run measures the same walks.
+unsigned long long randomState = 88172645463325252ULL;
+
+double randomUnit(void){
+  randomState ^= randomState << 13;
+  randomState ^= randomState >> 7;
+  randomState ^= randomState << 17;
+
+  return (double) (randomState >> 11) / (double) (1ULL << 53);
+}
+
+// A walk of hops between half and one and a half times hopLength, in random directions, kept off the poles.
+void makeWalk(double * latitude, double * longitude, int length, double hopLength){
+  latitude[0] = (2 * randomUnit() - 1) * MAX_START_LATITUDE;
+  longitude[0] = (2 * randomUnit() - 1) * 180;
+
+  for(int i = 1; i < length; i++){
+    double distance = hopLength * (0.5 + randomUnit());
+    double bearing = 2 * M_PI * randomUnit();
+    double nextLatitude = latitude[i - 1] + distance * cos(bearing) / EARTH_MEAN_RADIUS * DEGREES_PER_RADIAN;
+    double nextLongitude = longitude[i - 1] + distance * sin(bearing) / (EARTH_MEAN_RADIUS * cos(latitude[i - 1] / DEGREES_PER_RADIAN)) *
+                           DEGREES_PER_RADIAN;
+
+    if(fabs(nextLatitude) > 80){
+      nextLatitude = latitude[i - 1] - (nextLatitude - latitude[i - 1]);
+    }
+
+    latitude[i] = nextLatitude;
+    longitude[i] = remainder(nextLongitude, 360);
+  }
+}
+
+double secondsNow(void){
+  struct timespec now;
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+
+  return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+// The fastest of a few runs, in nanoseconds per hop. length is where the result goes.
+double timePathLen(const double * latitude, const double * longitude, int numPoints, GPXDistanceModel model, double * length){
+  double best = INFINITY;
+
+  for(int run = 0; run < REPEATS; run++){
+    double start = secondsNow();
+
+    *length = getPathLen(latitude, longitude, numPoints, model);
+
+    double elapsed = secondsNow() - start;
+
+    best = (elapsed < best) ? elapsed : best;
+  }
+
+  return best * 1e9 / (numPoints - 1);
+}
+
+// What getTrackLen used to do: each hop rounded to a float and added up in a float.
+double floatPathLen(const double * latitude, const double * longitude, int numPoints){
+  float length = 0;
+
+  for(int i = 1; i < numPoints; i++){
+    length += (float) getGPXDistance(latitude[i - 1], longitude[i - 1], latitude[i], longitude[i], GPX_DISTANCE_HAVERSINE);
+  }
+
+  return length;
+}
+
+int main(int argc, char ** argv){
+  int numPoints = (argc > 1) ? atoi(argv[1]) : DEFAULT_POINTS;
+
+  if(numPoints < 2){
+    fprintf(stderr, "usage: %s [points, at least 2]\n", argv[0]);
+    return 1;
+  }
+
+  double * latitude = malloc(sizeof(double) * numPoints);
+  double * longitude = malloc(sizeof(double) * numPoints);
+
+  if(latitude == NULL || longitude == NULL){
+    fprintf(stderr, "out of memory\n");
+    return 1;
+  }
+
+  printf("%d points per walk; errors are relative, and the float column is float hops summed in a float vs haversine\n\n", numPoints);
+  printf("%10s  %-16s %10s %14s %14s %14s\n", "hops of", "model", "ns/hop", "vs vincenty", "vs haversine", "float sum");
+
+  for(size_t h = 0; h < NUM_HOP_LENGTHS; h++){
+    double lengths[NUM_MODELS];
+    double times[NUM_MODELS];
+
+    makeWalk(latitude, longitude, numPoints, hopLengths[h]);
+
+    for(size_t m = 0; m < NUM_MODELS; m++){
+      times[m] = timePathLen(latitude, longitude, numPoints, models[m], &lengths[m]);
+    }
+
+    double haversine = lengths[0];
+    double vincenty = lengths[NUM_MODELS - 1];
+    double floatError = (floatPathLen(latitude, longitude, numPoints) - haversine) / haversine;
+
+    for(size_t m = 0; m < NUM_MODELS; m++){
+      printf("%9gm  %-16s %10.1f %14.2e %14.2e", hopLengths[h], modelNames[m], times[m], (lengths[m] - vincenty) / vincenty,
+             (lengths[m] - haversine) / haversine);
+
+      if(m == 0){
+        printf(" %14.2e", floatError);
+      }
+
+      printf("\n");
+    }
+  }
+
+  free(latitude);
+  free(longitude);
+
+  return 0;
+}
@@ -0,0 +1,222 @@
+/* Filename: parserTests.c
+ * Description: Checks of behaviour that the sample files in bin/ don't cover - each one builds a document from a string,
+ *              changes or writes it, and compares the result with what a freshly parsed document gives.
+ *              Build and run it with "make test", which prints each failed check and exits with 1 if there were any.
+ */
+
+#include "GPXParser.h"
+
+// A route of three points and a track of two segments, the second starting where the first ends.
+const char * const pathsDocument =
+  "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+  "<gpx xmlns=\"http://www.topografix.com/GPX/1/1\" version=\"1.1\" creator=\"parserTests\">\n"
+  "  <rte><name>route</name>\n"
+  "    <rtept lat=\"49.0\" lon=\"-123.0\"/><rtept lat=\"49.01\" lon=\"-123.0\"/><rtept lat=\"49.01\" lon=\"-123.01\"/>\n"
+  "  </rte>\n"
+  "  <trk><name>track</name>\n"
+  "    <trkseg><trkpt lat=\"49.0\" lon=\"-123.0\"/><trkpt lat=\"49.02\" lon=\"-123.0\"/></trkseg>\n"
+  "    <trkseg><trkpt lat=\"49.02\" lon=\"-123.0\"/><trkpt lat=\"49.02\" lon=\"-123.02\"/></trkseg>\n"
+  "  </trk>\n"
+  "</gpx>\n";
+
+int failures = 0;
+
+void check(bool passed, const char * what){
+  if(passed == false){
+    printf("FAILED: %s\n", what);
+    failures++;
+  }
+}
+
+GPXdoc * parseString(const char * content){
+  return createGPXdocFromMemory(content, strlen(content));
+}
+
+// A waypoint at the given point, made the way a client would make one.
+Waypoint * newWaypoint(double latitude, double longitude){
+  char json[64];
+
+  snprintf(json, sizeof(json), "{\"lat\":%.6f,\"lon\":%.6f}", latitude, longitude);
+
+  return JSONtoWaypoint(json);
+}
+
+/* ***************************************************************************SUMMARIES************************************************************************************* */
+
+// Lengths and loops asked for, then asked again after the points change, must match a document parsed with the change.
+void testSummariesFollowChanges(void){
+  GPXdoc * doc = parseString(pathsDocument);
+  Route * route = getFromFront(doc->routes);
+  Track * track = getFromFront(doc->tracks);
+  GPXPathSummary summary;
+
+  float routeLen = getRouteLen(route);
+  float trackLen = getTrackLen(track);
+
+  check(numRoutesWithLength(doc, routeLen, 1) == 1 && numTracksWithLength(doc, trackLen, 1) == 1, "lengths are found");
+  check(isLoopRoute(route, 10) == false, "open route isn't a loop");
+
+  // Closing the route with addWaypoint.
+  addWaypoint(route, newWaypoint(49.0, -123.0));
+
+  float closedLen = getRouteLen(route);
+
+  check(closedLen > routeLen, "addWaypoint lengthens the route");
+  check(numRoutesWithLength(doc, routeLen, 1) == 0 && numRoutesWithLength(doc, closedLen, 1) == 1,
+        "numRoutesWithLength sees addWaypoint");
+  check(isLoopRoute(route, 10) == true, "isLoopRoute sees addWaypoint");
+
+  // Growing the track straight through its segment's list, with nothing else called.
+  TrackSegment * segment = getFromBack(track->segments);
+
+  insertBack(segment->waypoints, newWaypoint(49.0, -123.02));
+
+  check(getTrackLen(track) > trackLen, "a point inserted into a segment lengthens the track");
+  check(numTracksWithLength(doc, trackLen, 1) == 0, "numTracksWithLength sees a point inserted into a segment");
+  check(getTrackSummary(track, &summary) == true && summary.numPoints == 5 && summary.lastLatitude == 49.0,
+        "getTrackSummary sees a point inserted into a segment");
+
+  // Emptying the first segment.
+  clearList(((TrackSegment *) getFromFront(track->segments))->waypoints);
+
+  check(getTrackSummary(track, &summary) == true && summary.numPoints == 3, "getTrackSummary sees an emptied segment");
+
+  // Moving a point in place, which only updateGPXdocCounts makes known.
+  Waypoint * last = getFromBack(route->waypoints);
+
+  last->latitude = 49.03;
+  updateGPXdocCounts(doc);
+
+  check(isLoopRoute(route, 10) == false, "isLoopRoute sees a point moved before updateGPXdocCounts");
+
+  // The same document written out by hand gives the same lengths.
+  GPXdoc * expected = parseString(
+    "<gpx xmlns=\"http://www.topografix.com/GPX/1/1\" version=\"1.1\" creator=\"parserTests\">"
+    "<rte><rtept lat=\"49.0\" lon=\"-123.0\"/><rtept lat=\"49.01\" lon=\"-123.0\"/><rtept lat=\"49.01\" lon=\"-123.01\"/>"
+    "<rtept lat=\"49.03\" lon=\"-123.0\"/></rte>"
+    "<trk><trkseg/><trkseg><trkpt lat=\"49.02\" lon=\"-123.0\"/><trkpt lat=\"49.02\" lon=\"-123.02\"/>"
+    "<trkpt lat=\"49.0\" lon=\"-123.02\"/></trkseg></trk></gpx>");
+
+  check(getRouteLen(route) == getRouteLen(getFromFront(expected->routes)), "changed route has the parsed route's length");
+  check(getTrackLen(track) == getTrackLen(getFromFront(expected->tracks)), "changed track has the parsed track's length");
+
+  deleteGPXdoc(expected);
+  deleteGPXdoc(doc);
+}
+
+/* ***************************************************************************NAME INDEX************************************************************************************* */
+
+// A waypoint with a name, made the way a client would make one.
+Waypoint * newNamedWaypoint(double latitude, double longitude, const char * name){
+  Waypoint * waypoint = newWaypoint(latitude, longitude);
+
+  free(waypoint->name);
+  waypoint->name = malloc(strlen(name) + 1);
+  strcpy(waypoint->name, name);
+
+  return waypoint;
+}
+
+// Points added to any route keep getWaypoint's first-match order without the index being built again.
+void testIndexFollowsAddedPoints(void){
+  GPXdoc * doc = parseString(
+    "<gpx xmlns=\"http://www.topografix.com/GPX/1/1\" version=\"1.1\" creator=\"parserTests\">"
+    "<rte><name>first</name><rtept lat=\"1\" lon=\"1\"/></rte>"
+    "<rte><name>second</name><rtept lat=\"2\" lon=\"2\"><name>shared</name></rtept></rte>"
+    "<trk><trkseg><trkpt lat=\"3\" lon=\"3\"><name>tracked</name></trkpt></trkseg></trk></gpx>");
+  Route * first = getRoute(doc, "first");
+  Route * second = getRoute(doc, "second");
+  Waypoint * shared = getWaypoint(doc, "shared");
+  GPXNameIndex * index = doc->nameIndex;
+
+  check(index != NULL && shared != NULL, "index is built");
+
+  // The second route's point with this name comes before one added to the second route, and after one added to the first.
+  Waypoint * later = newNamedWaypoint(4, 4, "shared");
+  Waypoint * earlier = newNamedWaypoint(5, 5, "shared");
+
+  addWaypoint(second, later);
+  check(getWaypoint(doc, "shared") == shared, "a point added after the first with its name isn't found");
+  addWaypoint(first, earlier);
+  check(getWaypoint(doc, "shared") == earlier, "a point added to an earlier route is found first");
+
+  // A route point comes before a track point.
+  Waypoint * routed = newNamedWaypoint(6, 6, "tracked");
+
+  addWaypoint(first, routed);
+  check(getWaypoint(doc, "tracked") == routed, "a route point is found before a track point");
+
+  Waypoint * fresh = newNamedWaypoint(7, 7, "fresh");
+
+  addWaypoint(first, fresh);
+  check(getWaypoint(doc, "fresh") == fresh, "a new name is found");
+  check(doc->nameIndex == index, "the index is kept rather than built again");
+
+  deleteGPXdoc(doc);
+}
+
+/* ***************************************************************************WRITING************************************************************************************* */
+
+#define WRITE_TEST_FILE "bin/_tmpOutFile_parserTests.gpx"
+
+// Writes a document out and reads the file back in as text.
+char * writeToString(GPXdoc * doc){
+  if(writeGPXdoc(doc, WRITE_TEST_FILE) == false){
+    return NULL;
+  }
+
+  FILE * file = fopen(WRITE_TEST_FILE, "r");
+  char * text = calloc(1, 4096);
+
+  if(file != NULL){
+    fread(text, 1, 4095, file);
+    fclose(file);
+  }
+
+  remove(WRITE_TEST_FILE);
+
+  return text;
+}
+
+// However an elevation is written, it is read into elevation and written back as the shortest decimal with its value.
+void testElevationRoundTrip(void){
+  const char * const elevations[] = { "336.0", " 336 ", "\n  336.00\n", "+336" };
+
+  for(int i = 0; i < sizeof(elevations) / sizeof(elevations[0]); i++){
+    char content[512];
+
+    snprintf(content, sizeof(content),
+             "<gpx xmlns=\"http://www.topografix.com/GPX/1/1\" version=\"1.1\" creator=\"parserTests\">"
+             "<wpt lat=\"1\" lon=\"1\"><ele>%s</ele><name>peak</name></wpt></gpx>", elevations[i]);
+
+    GPXdoc * doc = parseString(content);
+    Waypoint * waypoint = getFromFront(doc->waypoints);
+
+    char what[64];
+
+    snprintf(what, sizeof(what), "<ele>%s</ele> is read into elevation", elevations[i]);
+    check(waypoint->elevation == 336 && getLength(waypoint->otherData) == 0, what);
+
+    char * written = writeToString(doc);
+
+    check(written != NULL && strstr(written, "<ele>336</ele>") != NULL, "elevation is written as 336");
+
+    GPXdoc * reread = parseString(written);
+
+    check(reread != NULL && ((Waypoint *) getFromFront(reread->waypoints))->elevation == 336, "written elevation reads back");
+
+    deleteGPXdoc(reread);
+    free(written);
+    deleteGPXdoc(doc);
+  }
+}
+
+int main(void){
+  testSummariesFollowChanges();
+  testIndexFollowsAddedPoints();
+  testElevationRoundTrip();
+
+  printf("%d failed\n", failures);
+
+  return (failures == 0) ? 0 : 1;
+}